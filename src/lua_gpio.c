@@ -13,6 +13,17 @@
 #include <stdint.h>
 #include <errno.h>
 
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+
+#include <linux/gpio.h>
+
 #include <c-periphery/src/gpio.h>
 #include "lua_periphery.h"
 #include "lua_compat.h"
@@ -23,7 +34,7 @@ local GPIO = periphery.GPIO
 
 -- Constructor (for character device GPIO)
 gpio = GPIO(path <string>, line <number>, direction <string>)
-gpio = GPIO{path=<string>, line=<number|string>, direction=<string>, edge="none", bias="default", drive="default", inverted=false, label=nil}
+gpio = GPIO{path=<string>, line=<number|string>, direction=<string>, edge="none", bias="default", drive="default", inverted=false, label=nil, debounce_us=0, event_clock=nil}
 -- Constructor (for sysfs GPIO)
 gpio = GPIO(line <number>, direction <string>)
 gpio = GPIO{line=<number>, direction=<string>}
@@ -36,16 +47,37 @@ gpio:close()
 
 -- Methods (for character device GPIO)
 gpio:read_event() --> {edge=<string>, timestamp=<number>}
+gpio:capture_start{mode=<string>, window_ms=0}
+gpio:capture_read() --> <table>
+gpio:capture_stop()
+gpio:buffer_start([capacity <number>])
+gpio:drain([max_events <number>]) --> <table>, <number>
+gpio:buffer_stop()
 
 -- Static methods
 GPIO.poll_multiple(gpios <table>, [timeout_ms <number|nil>]) --> <table>
 
+-- Poll set constructor
+pollset = GPIO.PollSet([gpios <table|nil>])
+
+-- Poll set methods
+pollset:add(gpio <GPIO>)
+pollset:remove(gpio <GPIO>)
+pollset:wait([timeout_ms <number|nil>]) --> <table>
+pollset:close()
+
+-- Poll set properties
+pollset.fd          immutable <number>
+pollset.count       immutable <number>
+
 -- Properties
 gpio.direction      mutable <string>
 gpio.edge           mutable <string>
 gpio.bias           mutable <string>
 gpio.drive          mutable <string>
 gpio.inverted       mutable <boolean>
+gpio.debounce_us    mutable <number>
+gpio.event_clock    mutable <string>
 gpio.line           immutable <number>
 gpio.fd             immutable <number>
 gpio.name           immutable <string>
@@ -67,6 +99,102 @@ static const char *gpio_error_code_strings[] = {
     [-GPIO_ERROR_CLOSE]             = "GPIO_ERROR_CLOSE",
 };
 
+/* Event clock line flags of the gpio-cdev v2 ABI, defined here for kernel
+ * headers that predate them */
+#define GPIO_V2_FLAG_EVENT_CLOCK_REALTIME   (1ULL << 11)
+#define GPIO_V2_FLAG_EVENT_CLOCK_HTE        (1ULL << 12)
+
+typedef enum lua_gpio_event_clock {
+    GPIO_EVENT_CLOCK_DEFAULT,   /* Leave as configured by c-periphery */
+    GPIO_EVENT_CLOCK_MONOTONIC,
+    GPIO_EVENT_CLOCK_REALTIME,
+    GPIO_EVENT_CLOCK_HTE,
+} lua_gpio_event_clock_t;
+
+typedef enum lua_gpio_capture_mode {
+    GPIO_CAPTURE_PERIOD,
+    GPIO_CAPTURE_PULSE,
+    GPIO_CAPTURE_COUNT,
+} lua_gpio_capture_mode_t;
+
+typedef struct lua_gpio_capture_stats {
+    uint64_t count;
+    uint64_t period_count;
+    uint64_t period_min_ns;
+    uint64_t period_max_ns;
+    uint64_t period_sum_ns;
+    uint64_t pulse_count;
+    uint64_t pulse_min_ns;
+    uint64_t pulse_max_ns;
+    uint64_t pulse_sum_ns;
+} lua_gpio_capture_stats_t;
+
+/* Edge event, as buffered by the native reader */
+typedef struct lua_gpio_event {
+    uint64_t timestamp;
+    uint32_t seqno;
+    uint32_t line_seqno;
+    gpio_edge_t edge;
+} lua_gpio_event_t;
+
+/* Native edge event reader, which consumes the line's edge events on a
+ * background thread. The thread reads a duplicate of the line's fd and never
+ * accesses the gpio_t, which remains owned by Lua. */
+typedef struct lua_gpio_reader {
+    int fd;
+    pthread_t thread;
+    int stop_fd;
+    pthread_mutex_t lock;
+
+    /* Thread error, protected by lock */
+    int error;
+    int error_errno;
+
+    /* Capture state, owned by the thread */
+    bool capture_enabled;
+    lua_gpio_capture_mode_t capture_mode;
+    gpio_edge_t capture_edge;
+    uint64_t capture_window_ns;
+    uint64_t capture_window_start_ns;
+    uint64_t capture_last_edge_ns;
+    uint64_t capture_last_rising_ns;
+    bool capture_have_edge;
+    bool capture_have_rising;
+    /* Capture statistics, protected by lock */
+    lua_gpio_capture_stats_t capture_current;
+    lua_gpio_capture_stats_t capture_last;
+
+    /* Event ring buffer, or NULL when not buffering. The thread is the only
+     * producer and advances ring_head, Lua is the only consumer and advances
+     * ring_tail, so the indices are accessed atomically without the lock. */
+    lua_gpio_event_t *ring;
+    uint32_t ring_mask;
+    uint32_t ring_head;
+    uint32_t ring_tail;
+    uint32_t ring_overflows;
+} lua_gpio_reader_t;
+
+/* GPIO userdata. The gpio_t handle must remain the first member, so that the
+ * userdata can be dereferenced as a gpio_t ** by the methods below. */
+typedef struct lua_gpio {
+    gpio_t *gpio;
+
+    /* Line attributes not managed by c-periphery, which are reapplied after
+     * c-periphery reconfigures (and possibly re-requests) the line */
+    uint32_t debounce_us;
+    lua_gpio_event_clock_t event_clock;
+
+    /* Native edge event reader, or NULL when not running */
+    lua_gpio_reader_t *reader;
+} lua_gpio_t;
+
+/* GPIO poll set userdata */
+typedef struct lua_gpio_pollset {
+    lua_periphery_epoll_set_t set;
+    /* Registry reference to table of ready GPIOs, reused across waits */
+    int ready_ref;
+} lua_gpio_pollset_t;
+
 static int lua_gpio_error(lua_State *L, enum gpio_error_code code, int c_errno, const char *fmt, ...) {
     char message[128];
     va_list ap;
@@ -100,7 +228,121 @@ static void lua_gpio_checktype(lua_State *L, int index, int type) {
         lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid argument #%d (%s expected, got %s)", index, lua_typename(L, type), lua_typename(L, lua_type(L, index)));
 }
 
+static int lua_gpio_parse_event_clock(const char *value, lua_gpio_event_clock_t *event_clock) {
+    if (strcmp(value, "monotonic") == 0)
+        *event_clock = GPIO_EVENT_CLOCK_MONOTONIC;
+    else if (strcmp(value, "realtime") == 0)
+        *event_clock = GPIO_EVENT_CLOCK_REALTIME;
+    else if (strcmp(value, "hte") == 0)
+        *event_clock = GPIO_EVENT_CLOCK_HTE;
+    else
+        return -1;
+
+    return 0;
+}
+
+#if PERIPHERY_GPIO_CDEV_V2_SUPPORT
+
+static void lua_gpio_query_line_info(lua_State *L, lua_gpio_t *handle, struct gpio_v2_line_info *line_info) {
+    int chip_fd;
+
+    if ((chip_fd = gpio_chip_fd(handle->gpio)) < 0)
+        lua_gpio_error(L, GPIO_ERROR_UNSUPPORTED, 0, "Error: line debounce and event clock are not supported by sysfs GPIOs");
+
+    memset(line_info, 0, sizeof(*line_info));
+    line_info->offset = gpio_line(handle->gpio);
+
+    if (ioctl(chip_fd, GPIO_V2_GET_LINEINFO_IOCTL, line_info) < 0)
+        lua_gpio_error(L, GPIO_ERROR_QUERY, errno, "Error: querying line info: %s [errno %d]", strerror(errno), errno);
+}
+
+static void lua_gpio_apply_line_config(lua_State *L, lua_gpio_t *handle) {
+    struct gpio_v2_line_info line_info;
+    struct gpio_v2_line_config line_config;
+    unsigned int num_attrs = 0;
+    int ret;
+
+    lua_gpio_query_line_info(L, handle, &line_info);
+
+    memset(&line_config, 0, sizeof(line_config));
+
+    /* Carry over the flags c-periphery requested the line with */
+    line_config.flags = line_info.flags & ~GPIO_V2_LINE_FLAG_USED;
+
+    if (handle->event_clock != GPIO_EVENT_CLOCK_DEFAULT) {
+        line_config.flags &= ~(GPIO_V2_FLAG_EVENT_CLOCK_REALTIME | GPIO_V2_FLAG_EVENT_CLOCK_HTE);
+        if (handle->event_clock == GPIO_EVENT_CLOCK_REALTIME)
+            line_config.flags |= GPIO_V2_FLAG_EVENT_CLOCK_REALTIME;
+        else if (handle->event_clock == GPIO_EVENT_CLOCK_HTE)
+            line_config.flags |= GPIO_V2_FLAG_EVENT_CLOCK_HTE;
+    }
+
+    if (line_config.flags & GPIO_V2_LINE_FLAG_OUTPUT) {
+        /* Preserve the output value, which would otherwise be reset */
+        bool value;
+
+        if ((ret = gpio_read(handle->gpio, &value)) < 0)
+            lua_gpio_error(L, ret, gpio_errno(handle->gpio), "Error: %s", gpio_errmsg(handle->gpio));
+
+        line_config.attrs[num_attrs].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        line_config.attrs[num_attrs].attr.values = value ? 1 : 0;
+        line_config.attrs[num_attrs].mask = 1;
+        num_attrs++;
+    } else if (handle->debounce_us > 0) {
+        line_config.attrs[num_attrs].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+        line_config.attrs[num_attrs].attr.debounce_period_us = handle->debounce_us;
+        line_config.attrs[num_attrs].mask = 1;
+        num_attrs++;
+    }
+
+    line_config.num_attrs = num_attrs;
+
+    if (ioctl(gpio_fd(handle->gpio), GPIO_V2_LINE_SET_CONFIG_IOCTL, &line_config) < 0)
+        lua_gpio_error(L, GPIO_ERROR_CONFIGURE, errno, "Error: setting line config: %s [errno %d]", strerror(errno), errno);
+}
+
+#else
+
+static void lua_gpio_apply_line_config(lua_State *L, lua_gpio_t *handle) {
+    lua_gpio_error(L, GPIO_ERROR_UNSUPPORTED, 0, "Error: line debounce and event clock require gpio-cdev v2 ABI support");
+}
+
+#endif
+
+static void lua_gpio_reapply_line_config(lua_State *L, lua_gpio_t *handle) {
+    if (handle->debounce_us > 0 || handle->event_clock != GPIO_EVENT_CLOCK_DEFAULT)
+        lua_gpio_apply_line_config(L, handle);
+}
+
+static bool lua_gpio_is_sysfs(gpio_t *gpio) {
+    /* Only character device GPIOs have an associated chip */
+    return gpio_chip_fd(gpio) < 0;
+}
+
+int lua_periphery_gpio_events(lua_State *L, int index) {
+    bool isgpio;
+
+    if (!lua_isuserdata(L, index) || !lua_getmetatable(L, index))
+        return 0;
+
+    luaL_getmetatable(L, "periphery.GPIO");
+    isgpio = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);
+
+    if (!isgpio)
+        return 0;
+
+    /* Sysfs GPIO value files signal edges with POLLPRI */
+    return lua_gpio_is_sysfs(((lua_gpio_t *)lua_touserdata(L, index))->gpio) ? (POLLPRI | POLLERR) : POLLIN;
+}
+
+static void lua_gpio_check_no_reader(lua_State *L, lua_gpio_t *handle) {
+    if (handle->reader != NULL)
+        lua_gpio_error(L, GPIO_ERROR_INVALID_OPERATION, 0, "Error: GPIO edge events are being consumed by a native reader");
+}
+
 static int lua_gpio_open(lua_State *L) {
+    lua_gpio_t *handle;
     gpio_t *gpio;
     const char *path = NULL;
     unsigned int line;
@@ -114,8 +356,11 @@ static int lua_gpio_open(lua_State *L) {
     gpio_drive_t drive = GPIO_DRIVE_DEFAULT;
     bool inverted = false;
     const char *label = NULL;
+    uint32_t debounce_us = 0;
+    lua_gpio_event_clock_t event_clock = GPIO_EVENT_CLOCK_DEFAULT;
 
-    gpio = *((gpio_t **)luaL_checkudata(L, 1, "periphery.GPIO"));
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+    gpio = handle->gpio;
 
     if (lua_istable(L, 2)) {
         /* Arguments passed in table form */
@@ -203,6 +448,21 @@ static int lua_gpio_open(lua_State *L) {
             label = lua_tostring(L, -1);
         } else if (!lua_isnil(L, -1))
             return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid type on table argument 'label', should be string");
+
+        /* Optional debounce_us */
+        lua_getfield(L, 2, "debounce_us");
+        if (lua_isnumber(L, -1)) {
+            debounce_us = lua_tounsigned(L, -1);
+        } else if (!lua_isnil(L, -1))
+            return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid type on table argument 'debounce_us', should be number");
+
+        /* Optional event_clock */
+        lua_getfield(L, 2, "event_clock");
+        if (lua_isstring(L, -1)) {
+            if (lua_gpio_parse_event_clock(lua_tostring(L, -1), &event_clock) < 0)
+                return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid table argument 'event_clock', should be 'monotonic', 'realtime', or 'hte'");
+        } else if (!lua_isnil(L, -1))
+            return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid type on table argument 'event_clock', should be string");
     } else if (lua_gettop(L) > 3) {
         /* Arguments passed on stack: path (string), line (number|string), direction (string) */
 
@@ -269,6 +529,10 @@ static int lua_gpio_open(lua_State *L) {
             return lua_gpio_error(L, ret, gpio_errno(gpio), gpio_errmsg(gpio));
     }
 
+    handle->debounce_us = debounce_us;
+    handle->event_clock = event_clock;
+    lua_gpio_reapply_line_config(L, handle);
+
     return 0;
 }
 
@@ -277,8 +541,11 @@ static int lua_gpio_new(lua_State *L) {
     lua_remove(L, 1);
 
     /* Create handle userdata */
-    gpio_t **gpio = lua_newuserdata(L, sizeof(gpio_t *));
-    *gpio = gpio_new();
+    lua_gpio_t *handle = lua_newuserdata(L, sizeof(lua_gpio_t));
+    handle->gpio = gpio_new();
+    handle->debounce_us = 0;
+    handle->event_clock = GPIO_EVENT_CLOCK_DEFAULT;
+    handle->reader = NULL;
     /* Set GPIO metatable on it */
     luaL_getmetatable(L, "periphery.GPIO");
     lua_setmetatable(L, -2);
@@ -328,12 +595,66 @@ static int lua_gpio_write(lua_State *L) {
     return 0;
 }
 
+static int lua_gpio_poll_k(lua_State *L);
+
+/* Yield to the periphery.loop scheduler until the GPIO signals an edge event,
+ * with the deadline at index 2 */
+static int lua_gpio_poll_yield(lua_State *L, gpio_t *gpio, int timeout_ms) {
+    /* Sysfs GPIO value files are always readable, and signal edges with
+     * POLLPRI */
+    return lua_periphery_loop_wait(L, gpio_fd(gpio), lua_gpio_is_sysfs(gpio) ? (POLLPRI | POLLERR) : POLLIN, timeout_ms, lua_gpio_poll_k);
+}
+
+/* Continuation of poll() in a periphery.loop task, with the deadline at
+ * index 2 */
+static int lua_gpio_poll_k(lua_State *L) {
+    lua_gpio_t *handle;
+    gpio_t *gpio;
+    int remaining_ms;
+    int ret;
+
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+    gpio = handle->gpio;
+
+    if (lua_gpio_is_sysfs(gpio)) {
+        /* c-periphery's sysfs poll re-arms edge detection with a dummy read
+         * of the value file, which would discard the edge that woke the
+         * task, so check it with a plain poll() instead, and rewind the
+         * value file on an edge as c-periphery does */
+        struct pollfd fds[1];
+
+        fds[0].fd = gpio_fd(gpio);
+        fds[0].events = POLLPRI | POLLERR;
+
+        if ((ret = poll(fds, 1, 0)) < 0)
+            return lua_gpio_error(L, GPIO_ERROR_IO, errno, "Error: polling GPIO \"value\": %s [errno %d]", strerror(errno), errno);
+
+        if (ret > 0 && lseek(gpio_fd(gpio), 0, SEEK_SET) < 0)
+            return lua_gpio_error(L, GPIO_ERROR_IO, errno, "Error: rewinding GPIO \"value\": %s [errno %d]", strerror(errno), errno);
+    } else if ((ret = gpio_poll(gpio, 0)) < 0) {
+        return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
+    }
+
+    remaining_ms = lua_periphery_loop_remaining(lua_tonumber(L, 2));
+
+    if (ret > 0 || remaining_ms == 0) {
+        lua_pushboolean(L, ret > 0);
+        return 1;
+    }
+
+    return lua_gpio_poll_yield(L, gpio, remaining_ms);
+}
+
 static int lua_gpio_poll(lua_State *L) {
+    lua_gpio_t *handle;
     gpio_t *gpio;
     int timeout_ms;
     int ret;
 
-    gpio = *((gpio_t **)luaL_checkudata(L, 1, "periphery.GPIO"));
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+    gpio = handle->gpio;
+
+    lua_gpio_check_no_reader(L, handle);
 
     /* Optional timeout argument */
     if (lua_isnone(L, 2) || lua_isnil(L, 2))
@@ -343,6 +664,21 @@ static int lua_gpio_poll(lua_State *L) {
     else
         return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
 
+    /* Yield to the scheduler instead of blocking, in a periphery.loop task,
+     * after a non-blocking poll that also arms sysfs edge detection */
+    if (timeout_ms != 0 && lua_periphery_loop_can_yield(L)) {
+        if ((ret = gpio_poll(gpio, 0)) < 0)
+            return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
+        else if (ret > 0) {
+            lua_pushboolean(L, true);
+            return 1;
+        }
+
+        lua_settop(L, 1);
+        lua_pushnumber(L, lua_periphery_loop_deadline(timeout_ms));
+        return lua_gpio_poll_yield(L, gpio, timeout_ms);
+    }
+
     if ((ret = gpio_poll(gpio, timeout_ms)) < 0)
         return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
 
@@ -352,12 +688,16 @@ static int lua_gpio_poll(lua_State *L) {
 }
 
 static int lua_gpio_read_event(lua_State *L) {
+    lua_gpio_t *handle;
     gpio_t *gpio;
     gpio_edge_t edge;
     uint64_t timestamp;
     int ret;
 
-    gpio = *((gpio_t **)luaL_checkudata(L, 1, "periphery.GPIO"));
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+    gpio = handle->gpio;
+
+    lua_gpio_check_no_reader(L, handle);
 
     if ((ret = gpio_read_event(gpio, &edge, &timestamp)) < 0)
         return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
@@ -432,11 +772,520 @@ static int lua_gpio_poll_multiple(lua_State *L) {
     return 1;
 }
 
+static uint64_t lua_gpio_monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void lua_gpio_capture_accumulate(uint64_t *count, uint64_t *min, uint64_t *max, uint64_t *sum, uint64_t value) {
+    if (*count == 0 || value < *min)
+        *min = value;
+    if (*count == 0 || value > *max)
+        *max = value;
+    *sum += value;
+    (*count)++;
+}
+
+static void lua_gpio_capture_update(lua_gpio_reader_t *reader, gpio_edge_t edge, uint64_t timestamp) {
+    lua_gpio_capture_stats_t *stats = &reader->capture_current;
+
+    pthread_mutex_lock(&reader->lock);
+
+    if (reader->capture_mode == GPIO_CAPTURE_COUNT) {
+        stats->count++;
+    } else {
+        /* Pulse width from the preceding rising edge */
+        if (reader->capture_mode == GPIO_CAPTURE_PULSE && edge == GPIO_EDGE_FALLING && reader->capture_have_rising && timestamp >= reader->capture_last_rising_ns)
+            lua_gpio_capture_accumulate(&stats->pulse_count, &stats->pulse_min_ns, &stats->pulse_max_ns, &stats->pulse_sum_ns, timestamp - reader->capture_last_rising_ns);
+
+        /* Period from the preceding reference edge */
+        if (edge == reader->capture_edge) {
+            stats->count++;
+
+            if (reader->capture_have_edge && timestamp >= reader->capture_last_edge_ns)
+                lua_gpio_capture_accumulate(&stats->period_count, &stats->period_min_ns, &stats->period_max_ns, &stats->period_sum_ns, timestamp - reader->capture_last_edge_ns);
+
+            reader->capture_last_edge_ns = timestamp;
+            reader->capture_have_edge = true;
+        }
+
+        if (edge == GPIO_EDGE_RISING) {
+            reader->capture_last_rising_ns = timestamp;
+            reader->capture_have_rising = true;
+        }
+    }
+
+    pthread_mutex_unlock(&reader->lock);
+}
+
+/* Start the next capture window once the current one has elapsed. Windows are
+ * tumbling, i.e. consecutive and non-overlapping, and the statistics of the
+ * last completed window are kept for capture_read(). */
+static void lua_gpio_capture_next_window(lua_gpio_reader_t *reader, uint64_t now_ns) {
+    uint64_t elapsed_ns = now_ns - reader->capture_window_start_ns;
+
+    if (reader->capture_window_ns == 0 || elapsed_ns < reader->capture_window_ns)
+        return;
+
+    pthread_mutex_lock(&reader->lock);
+
+    /* An empty window completed last if more than one window elapsed */
+    if (elapsed_ns < 2*reader->capture_window_ns)
+        reader->capture_last = reader->capture_current;
+    else
+        memset(&reader->capture_last, 0, sizeof(reader->capture_last));
+    memset(&reader->capture_current, 0, sizeof(reader->capture_current));
+
+    pthread_mutex_unlock(&reader->lock);
+
+    reader->capture_window_start_ns += (elapsed_ns / reader->capture_window_ns) * reader->capture_window_ns;
+}
+
+static void lua_gpio_reader_set_error(lua_gpio_reader_t *reader, int error, int error_errno) {
+    pthread_mutex_lock(&reader->lock);
+    reader->error = error;
+    reader->error_errno = error_errno;
+    pthread_mutex_unlock(&reader->lock);
+}
+
+static void lua_gpio_reader_push(lua_gpio_reader_t *reader, const lua_gpio_event_t *event) {
+    uint32_t head = reader->ring_head;
+    uint32_t tail = __atomic_load_n(&reader->ring_tail, __ATOMIC_ACQUIRE);
+
+    /* Drop the event if the ring is full */
+    if (head - tail > reader->ring_mask) {
+        __atomic_fetch_add(&reader->ring_overflows, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    reader->ring[head & reader->ring_mask] = *event;
+
+    __atomic_store_n(&reader->ring_head, head + 1, __ATOMIC_RELEASE);
+}
+
+#define GPIO_READER_BATCH_SIZE  16
+
+static int lua_gpio_reader_read_events(lua_gpio_reader_t *reader, lua_gpio_event_t *events) {
+#if PERIPHERY_GPIO_CDEV_V2_SUPPORT
+    /* Read all pending events in one syscall, which also provides the
+     * kernel sequence numbers */
+    struct gpio_v2_line_event line_events[GPIO_READER_BATCH_SIZE];
+    ssize_t ret;
+    unsigned int i, count;
+
+    if ((ret = read(reader->fd, line_events, sizeof(line_events))) < 0) {
+        if (errno == EINTR || errno == EAGAIN)
+            return 0;
+
+        lua_gpio_reader_set_error(reader, GPIO_ERROR_IO, errno);
+        return -1;
+    }
+
+    count = (size_t)ret / sizeof(struct gpio_v2_line_event);
+
+    for (i = 0; i < count; i++) {
+        events[i].timestamp = line_events[i].timestamp_ns;
+        events[i].seqno = line_events[i].seqno;
+        events[i].line_seqno = line_events[i].line_seqno;
+        events[i].edge = (line_events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING;
+    }
+
+    return count;
+#else
+    struct gpioevent_data event_data;
+    ssize_t ret;
+
+    if ((ret = read(reader->fd, &event_data, sizeof(event_data))) < 0) {
+        if (errno == EINTR || errno == EAGAIN)
+            return 0;
+
+        lua_gpio_reader_set_error(reader, GPIO_ERROR_IO, errno);
+        return -1;
+    } else if (ret != sizeof(event_data)) {
+        lua_gpio_reader_set_error(reader, GPIO_ERROR_IO, EIO);
+        return -1;
+    }
+
+    events[0].timestamp = event_data.timestamp;
+    events[0].seqno = 0;
+    events[0].line_seqno = 0;
+    events[0].edge = (event_data.id == GPIOEVENT_EVENT_RISING_EDGE) ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING;
+
+    return 1;
+#endif
+}
+
+static void *lua_gpio_reader_thread(void *arg) {
+    lua_gpio_reader_t *reader = arg;
+    lua_gpio_event_t events[GPIO_READER_BATCH_SIZE];
+    struct pollfd fds[2];
+    int ret;
+
+    fds[0].fd = reader->fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = reader->stop_fd;
+    fds[1].events = POLLIN;
+
+    while (true) {
+        int timeout_ms = -1;
+
+        if (reader->capture_enabled && reader->capture_window_ns > 0) {
+            uint64_t now_ns = lua_gpio_monotonic_ns();
+
+            lua_gpio_capture_next_window(reader, now_ns);
+
+            /* Wake up at the end of the current window */
+            timeout_ms = (reader->capture_window_start_ns + reader->capture_window_ns - now_ns + 999999) / 1000000;
+        }
+
+        if ((ret = poll(fds, 2, timeout_ms)) < 0) {
+            if (errno == EINTR)
+                continue;
+
+            lua_gpio_reader_set_error(reader, GPIO_ERROR_IO, errno);
+            break;
+        }
+
+        if (fds[1].revents)
+            break;
+
+        if (fds[0].revents) {
+            int i, count;
+
+            if ((count = lua_gpio_reader_read_events(reader, events)) < 0)
+                break;
+
+            for (i = 0; i < count; i++) {
+                if (reader->capture_enabled)
+                    lua_gpio_capture_update(reader, events[i].edge, events[i].timestamp);
+                if (reader->ring != NULL)
+                    lua_gpio_reader_push(reader, &events[i]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void lua_gpio_reader_stop(lua_gpio_t *handle) {
+    lua_gpio_reader_t *reader = handle->reader;
+
+    if (reader == NULL)
+        return;
+
+    eventfd_write(reader->stop_fd, 1);
+    pthread_join(reader->thread, NULL);
+
+    close(reader->stop_fd);
+    close(reader->fd);
+    pthread_mutex_destroy(&reader->lock);
+    free(reader->ring);
+    free(reader);
+
+    handle->reader = NULL;
+}
+
+static void lua_gpio_reader_check_edge(lua_State *L, lua_gpio_t *handle, gpio_edge_t *edge) {
+    int ret;
+
+    lua_gpio_check_no_reader(L, handle);
+
+    if (lua_gpio_is_sysfs(handle->gpio))
+        lua_gpio_error(L, GPIO_ERROR_UNSUPPORTED, 0, "Error: native reader is not supported by sysfs GPIOs");
+
+    if ((ret = gpio_get_edge(handle->gpio, edge)) < 0)
+        lua_gpio_error(L, ret, gpio_errno(handle->gpio), "Error: %s", gpio_errmsg(handle->gpio));
+
+    if (*edge == GPIO_EDGE_NONE)
+        lua_gpio_error(L, GPIO_ERROR_INVALID_OPERATION, 0, "Error: native reader requires an interrupt edge");
+}
+
+static void lua_gpio_reader_start(lua_State *L, lua_gpio_t *handle, lua_gpio_reader_t *reader) {
+    int ret;
+
+    if ((reader->fd = fcntl(gpio_fd(handle->gpio), F_DUPFD_CLOEXEC, 0)) < 0) {
+        int errsv = errno;
+        free(reader->ring);
+        free(reader);
+        lua_gpio_error(L, GPIO_ERROR_IO, errsv, "Error: duplicating line fd: %s [errno %d]", strerror(errsv), errsv);
+    }
+
+    if ((reader->stop_fd = eventfd(0, EFD_CLOEXEC)) < 0) {
+        int errsv = errno;
+        close(reader->fd);
+        free(reader->ring);
+        free(reader);
+        lua_gpio_error(L, GPIO_ERROR_IO, errsv, "Error: creating eventfd: %s [errno %d]", strerror(errsv), errsv);
+    }
+
+    pthread_mutex_init(&reader->lock, NULL);
+
+    if ((ret = pthread_create(&reader->thread, NULL, lua_gpio_reader_thread, reader)) != 0) {
+        close(reader->stop_fd);
+        close(reader->fd);
+        pthread_mutex_destroy(&reader->lock);
+        free(reader->ring);
+        free(reader);
+        lua_gpio_error(L, GPIO_ERROR_IO, ret, "Error: creating reader thread: %s [errno %d]", strerror(ret), ret);
+    }
+
+    handle->reader = reader;
+}
+
+static int lua_gpio_capture_start(lua_State *L) {
+    lua_gpio_t *handle;
+    lua_gpio_reader_t *reader;
+    lua_gpio_capture_mode_t mode;
+    uint64_t window_ms = 0;
+    gpio_edge_t edge;
+
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+    lua_gpio_checktype(L, 2, LUA_TTABLE);
+
+    lua_getfield(L, 2, "mode");
+    if (lua_type(L, -1) != LUA_TSTRING)
+        return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid type of table argument 'mode', should be string");
+    else if (strcmp(lua_tostring(L, -1), "period") == 0)
+        mode = GPIO_CAPTURE_PERIOD;
+    else if (strcmp(lua_tostring(L, -1), "pulse") == 0)
+        mode = GPIO_CAPTURE_PULSE;
+    else if (strcmp(lua_tostring(L, -1), "count") == 0)
+        mode = GPIO_CAPTURE_COUNT;
+    else
+        return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid table argument 'mode', should be 'period', 'pulse', or 'count'");
+
+    /* Optional window_ms */
+    lua_getfield(L, 2, "window_ms");
+    if (lua_isnumber(L, -1))
+        window_ms = lua_tounsigned(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid type on table argument 'window_ms', should be number");
+
+    lua_gpio_reader_check_edge(L, handle, &edge);
+
+    if (mode == GPIO_CAPTURE_PULSE && edge != GPIO_EDGE_BOTH)
+        return lua_gpio_error(L, GPIO_ERROR_INVALID_OPERATION, 0, "Error: pulse capture requires interrupt edge 'both'");
+
+    if ((reader = calloc(1, sizeof(lua_gpio_reader_t))) == NULL)
+        return lua_gpio_error(L, GPIO_ERROR_IO, errno, "Error: allocating memory");
+
+    reader->capture_enabled = true;
+    reader->capture_mode = mode;
+    /* Periods are measured between rising edges, unless only falling edges
+     * are configured */
+    reader->capture_edge = (edge == GPIO_EDGE_FALLING) ? GPIO_EDGE_FALLING : GPIO_EDGE_RISING;
+    reader->capture_window_ns = window_ms * 1000000;
+    reader->capture_window_start_ns = lua_gpio_monotonic_ns();
+
+    lua_gpio_reader_start(L, handle, reader);
+
+    return 0;
+}
+
+static int lua_gpio_capture_read(lua_State *L) {
+    lua_gpio_t *handle;
+    lua_gpio_reader_t *reader;
+    lua_gpio_capture_stats_t stats;
+    int error, error_errno;
+
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+
+    if ((reader = handle->reader) == NULL || !reader->capture_enabled)
+        return lua_gpio_error(L, GPIO_ERROR_INVALID_OPERATION, 0, "Error: capture is not running");
+
+    pthread_mutex_lock(&reader->lock);
+    stats = (reader->capture_window_ns > 0) ? reader->capture_last : reader->capture_current;
+    error = reader->error;
+    error_errno = reader->error_errno;
+    pthread_mutex_unlock(&reader->lock);
+
+    if (error < 0)
+        return lua_gpio_error(L, error, error_errno, "Error: capture thread: %s [errno %d]", strerror(error_errno), error_errno);
+
+    lua_newtable(L);
+    /* .count number */
+    lua_pushunsigned(L, stats.count);
+    lua_setfield(L, -2, "count");
+    /* .window_ms number */
+    lua_pushunsigned(L, reader->capture_window_ns / 1000000);
+    lua_setfield(L, -2, "window_ms");
+
+    if (stats.period_count > 0) {
+        double period_mean_ns = (double)stats.period_sum_ns / stats.period_count;
+
+        /* .period_*_ns numbers */
+        lua_pushunsigned(L, stats.period_min_ns);
+        lua_setfield(L, -2, "period_min_ns");
+        lua_pushunsigned(L, stats.period_max_ns);
+        lua_setfield(L, -2, "period_max_ns");
+        lua_pushnumber(L, period_mean_ns);
+        lua_setfield(L, -2, "period_mean_ns");
+        /* .frequency number */
+        lua_pushnumber(L, 1e9 / period_mean_ns);
+        lua_setfield(L, -2, "frequency");
+
+        if (stats.pulse_count > 0) {
+            double pulse_mean_ns = (double)stats.pulse_sum_ns / stats.pulse_count;
+
+            /* .pulse_*_ns numbers */
+            lua_pushunsigned(L, stats.pulse_min_ns);
+            lua_setfield(L, -2, "pulse_min_ns");
+            lua_pushunsigned(L, stats.pulse_max_ns);
+            lua_setfield(L, -2, "pulse_max_ns");
+            lua_pushnumber(L, pulse_mean_ns);
+            lua_setfield(L, -2, "pulse_mean_ns");
+            /* .duty_cycle number */
+            lua_pushnumber(L, pulse_mean_ns / period_mean_ns);
+            lua_setfield(L, -2, "duty_cycle");
+        }
+    }
+
+    return 1;
+}
+
+static int lua_gpio_capture_stop(lua_State *L) {
+    lua_gpio_t *handle;
+
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+
+    if (handle->reader != NULL && handle->reader->capture_enabled)
+        lua_gpio_reader_stop(handle);
+
+    return 0;
+}
+
+#define GPIO_BUFFER_DEFAULT_CAPACITY    4096
+#define GPIO_BUFFER_MAX_CAPACITY        (1u << 24)
+
+static int lua_gpio_buffer_start(lua_State *L) {
+    lua_gpio_t *handle;
+    lua_gpio_reader_t *reader;
+    uint32_t capacity = GPIO_BUFFER_DEFAULT_CAPACITY;
+    uint32_t size;
+    gpio_edge_t edge;
+
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+
+    /* Optional capacity */
+    if (!lua_isnoneornil(L, 2)) {
+        lua_gpio_checktype(L, 2, LUA_TNUMBER);
+        capacity = lua_tounsigned(L, 2);
+
+        if (capacity == 0 || capacity > GPIO_BUFFER_MAX_CAPACITY)
+            return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid capacity, should be between 1 and %u", GPIO_BUFFER_MAX_CAPACITY);
+    }
+
+    lua_gpio_reader_check_edge(L, handle, &edge);
+
+    /* Round capacity up to a power of two */
+    for (size = 1; size < capacity; size <<= 1);
+
+    if ((reader = calloc(1, sizeof(lua_gpio_reader_t))) == NULL)
+        return lua_gpio_error(L, GPIO_ERROR_IO, errno, "Error: allocating memory");
+
+    if ((reader->ring = calloc(size, sizeof(lua_gpio_event_t))) == NULL) {
+        free(reader);
+        return lua_gpio_error(L, GPIO_ERROR_IO, errno, "Error: allocating memory");
+    }
+
+    reader->ring_mask = size - 1;
+
+    lua_gpio_reader_start(L, handle, reader);
+
+    return 0;
+}
+
+static int lua_gpio_drain(lua_State *L) {
+    lua_gpio_t *handle;
+    lua_gpio_reader_t *reader;
+    uint32_t head, tail, count, max_events = 0;
+    uint32_t i;
+
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+
+    /* Optional max_events */
+    if (!lua_isnoneornil(L, 2)) {
+        lua_gpio_checktype(L, 2, LUA_TNUMBER);
+        max_events = lua_tounsigned(L, 2);
+    }
+
+    if ((reader = handle->reader) == NULL || reader->ring == NULL)
+        return lua_gpio_error(L, GPIO_ERROR_INVALID_OPERATION, 0, "Error: event buffer is not running");
+
+    head = __atomic_load_n(&reader->ring_head, __ATOMIC_ACQUIRE);
+    tail = reader->ring_tail;
+
+    count = head - tail;
+    if (max_events > 0 && count > max_events)
+        count = max_events;
+
+    /* Report a reader thread failure once the buffer is empty */
+    if (count == 0) {
+        int error, error_errno;
+
+        pthread_mutex_lock(&reader->lock);
+        error = reader->error;
+        error_errno = reader->error_errno;
+        pthread_mutex_unlock(&reader->lock);
+
+        if (error < 0)
+            return lua_gpio_error(L, error, error_errno, "Error: reader thread: %s [errno %d]", strerror(error_errno), error_errno);
+    }
+
+    lua_createtable(L, count, 0);
+
+    for (i = 0; i < count; i++) {
+        const lua_gpio_event_t *event = &reader->ring[(tail + i) & reader->ring_mask];
+
+        lua_createtable(L, 0, 4);
+        /* .edge string */
+        lua_pushstring(L, (event->edge == GPIO_EDGE_RISING) ? "rising" : "falling");
+        lua_setfield(L, -2, "edge");
+        /* .timestamp number */
+        lua_pushunsigned(L, event->timestamp);
+        lua_setfield(L, -2, "timestamp");
+        /* .seqno and .line_seqno numbers, if provided by the kernel */
+        if (event->seqno != 0) {
+            lua_pushunsigned(L, event->seqno);
+            lua_setfield(L, -2, "seqno");
+            lua_pushunsigned(L, event->line_seqno);
+            lua_setfield(L, -2, "line_seqno");
+        }
+
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    __atomic_store_n(&reader->ring_tail, tail + count, __ATOMIC_RELEASE);
+
+    /* Number of events dropped since the last drain */
+    lua_pushunsigned(L, __atomic_exchange_n(&reader->ring_overflows, 0, __ATOMIC_RELAXED));
+
+    return 2;
+}
+
+static int lua_gpio_buffer_stop(lua_State *L) {
+    lua_gpio_t *handle;
+
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+
+    if (handle->reader != NULL && handle->reader->ring != NULL)
+        lua_gpio_reader_stop(handle);
+
+    return 0;
+}
+
 static int lua_gpio_close(lua_State *L) {
+    lua_gpio_t *handle;
     gpio_t *gpio;
     int ret;
 
-    gpio = *((gpio_t **)luaL_checkudata(L, 1, "periphery.GPIO"));
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+    gpio = handle->gpio;
+
+    lua_gpio_reader_stop(handle);
 
     if ((ret = gpio_close(gpio)) < 0)
         return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
@@ -445,9 +1294,13 @@ static int lua_gpio_close(lua_State *L) {
 }
 
 static int lua_gpio_gc(lua_State *L) {
+    lua_gpio_t *handle;
     gpio_t *gpio;
 
-    gpio = *((gpio_t **)luaL_checkudata(L, 1, "periphery.GPIO"));
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+    gpio = handle->gpio;
+
+    lua_gpio_reader_stop(handle);
 
     gpio_close(gpio);
 
@@ -470,6 +1323,7 @@ static int lua_gpio_tostring(lua_State *L) {
 }
 
 static int lua_gpio_index(lua_State *L) {
+    lua_gpio_t *handle;
     gpio_t *gpio;
     const char *field;
 
@@ -484,7 +1338,8 @@ static int lua_gpio_index(lua_State *L) {
     if (!lua_isnil(L, -1))
         return 1;
 
-    gpio = *((gpio_t **)luaL_checkudata(L, 1, "periphery.GPIO"));
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+    gpio = handle->gpio;
 
     if (strcmp(field, "line") == 0) {
         lua_pushunsigned(L, gpio_line(gpio));
@@ -603,16 +1458,51 @@ static int lua_gpio_index(lua_State *L) {
         lua_pushboolean(L, inverted);
 
         return 1;
+    } else if (strcmp(field, "debounce_us") == 0) {
+#if PERIPHERY_GPIO_CDEV_V2_SUPPORT
+        struct gpio_v2_line_info line_info;
+        uint32_t debounce_us = 0;
+
+        lua_gpio_query_line_info(L, handle, &line_info);
+
+        for (unsigned int i = 0; i < line_info.num_attrs; i++) {
+            if (line_info.attrs[i].id == GPIO_V2_LINE_ATTR_ID_DEBOUNCE)
+                debounce_us = line_info.attrs[i].debounce_period_us;
+        }
+
+        lua_pushunsigned(L, debounce_us);
+        return 1;
+#else
+        return lua_gpio_error(L, GPIO_ERROR_UNSUPPORTED, 0, "Error: line debounce and event clock require gpio-cdev v2 ABI support");
+#endif
+    } else if (strcmp(field, "event_clock") == 0) {
+#if PERIPHERY_GPIO_CDEV_V2_SUPPORT
+        struct gpio_v2_line_info line_info;
+
+        lua_gpio_query_line_info(L, handle, &line_info);
+
+        if (line_info.flags & GPIO_V2_FLAG_EVENT_CLOCK_REALTIME)
+            lua_pushstring(L, "realtime");
+        else if (line_info.flags & GPIO_V2_FLAG_EVENT_CLOCK_HTE)
+            lua_pushstring(L, "hte");
+        else
+            lua_pushstring(L, "monotonic");
+        return 1;
+#else
+        return lua_gpio_error(L, GPIO_ERROR_UNSUPPORTED, 0, "Error: line debounce and event clock require gpio-cdev v2 ABI support");
+#endif
     }
 
     return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: unknown property");
 }
 
 static int lua_gpio_newindex(lua_State *L) {
+    lua_gpio_t *handle;
     gpio_t *gpio;
     const char *field;
 
-    gpio = *((gpio_t **)luaL_checkudata(L, 1, "periphery.GPIO"));
+    handle = (lua_gpio_t *)luaL_checkudata(L, 1, "periphery.GPIO");
+    gpio = handle->gpio;
 
     if (!lua_isstring(L, 2))
         return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: unknown property");
@@ -637,6 +1527,8 @@ static int lua_gpio_newindex(lua_State *L) {
         gpio_direction_t direction;
         int ret;
 
+        lua_gpio_check_no_reader(L, handle);
+
         const char *value;
         lua_gpio_checktype(L, 3, LUA_TSTRING);
         value = lua_tostring(L, 3);
@@ -655,11 +1547,15 @@ static int lua_gpio_newindex(lua_State *L) {
         if ((ret = gpio_set_direction(gpio, direction)) < 0)
             return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
 
+        lua_gpio_reapply_line_config(L, handle);
+
         return 0;
     } else if (strcmp(field, "edge") == 0) {
         gpio_edge_t edge;
         int ret;
 
+        lua_gpio_check_no_reader(L, handle);
+
         const char *value;
         lua_gpio_checktype(L, 3, LUA_TSTRING);
         value = lua_tostring(L, 3);
@@ -678,11 +1574,15 @@ static int lua_gpio_newindex(lua_State *L) {
         if ((ret = gpio_set_edge(gpio, edge)) < 0)
             return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
 
+        lua_gpio_reapply_line_config(L, handle);
+
         return 0;
     } else if (strcmp(field, "bias") == 0) {
         gpio_bias_t bias;
         int ret;
 
+        lua_gpio_check_no_reader(L, handle);
+
         const char *value;
         lua_gpio_checktype(L, 3, LUA_TSTRING);
         value = lua_tostring(L, 3);
@@ -701,11 +1601,15 @@ static int lua_gpio_newindex(lua_State *L) {
         if ((ret = gpio_set_bias(gpio, bias)) < 0)
             return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
 
+        lua_gpio_reapply_line_config(L, handle);
+
         return 0;
     } else if (strcmp(field, "drive") == 0) {
         gpio_drive_t drive;
         int ret;
 
+        lua_gpio_check_no_reader(L, handle);
+
         const char *value;
         lua_gpio_checktype(L, 3, LUA_TSTRING);
         value = lua_tostring(L, 3);
@@ -722,29 +1626,252 @@ static int lua_gpio_newindex(lua_State *L) {
         if ((ret = gpio_set_drive(gpio, drive)) < 0)
             return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
 
+        lua_gpio_reapply_line_config(L, handle);
+
         return 0;
     } else if (strcmp(field, "inverted") == 0) {
         bool inverted;
         int ret;
 
+        lua_gpio_check_no_reader(L, handle);
+
         lua_gpio_checktype(L, 3, LUA_TBOOLEAN);
         inverted = lua_toboolean(L, 3);
 
         if ((ret = gpio_set_inverted(gpio, inverted)) < 0)
             return lua_gpio_error(L, ret, gpio_errno(gpio), "Error: %s", gpio_errmsg(gpio));
 
+        lua_gpio_reapply_line_config(L, handle);
+
+        return 0;
+    } else if (strcmp(field, "debounce_us") == 0) {
+        lua_gpio_check_no_reader(L, handle);
+
+        lua_gpio_checktype(L, 3, LUA_TNUMBER);
+        handle->debounce_us = lua_tounsigned(L, 3);
+
+        lua_gpio_apply_line_config(L, handle);
+
         return 0;
+    } else if (strcmp(field, "event_clock") == 0) {
+        lua_gpio_event_clock_t event_clock;
+
+        lua_gpio_check_no_reader(L, handle);
+
+        lua_gpio_checktype(L, 3, LUA_TSTRING);
+
+        if (lua_gpio_parse_event_clock(lua_tostring(L, 3), &event_clock) < 0)
+            return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid event clock, should be 'monotonic', 'realtime', or 'hte'");
+
+        handle->event_clock = event_clock;
+
+        lua_gpio_apply_line_config(L, handle);
+
+        return 0;
+    }
+
+    return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static lua_gpio_pollset_t *lua_gpio_pollset_checkopen(lua_State *L, int index) {
+    lua_gpio_pollset_t *pollset = luaL_checkudata(L, index, "periphery.GPIO.PollSet");
+
+    if (pollset->set.epfd < 0)
+        lua_gpio_error(L, GPIO_ERROR_INVALID_OPERATION, 0, "Error: poll set is closed");
+
+    return pollset;
+}
+
+static int lua_gpio_pollset_add(lua_State *L) {
+    lua_gpio_pollset_t *pollset;
+    gpio_t *gpio;
+
+    pollset = lua_gpio_pollset_checkopen(L, 1);
+    gpio = *((gpio_t **)luaL_checkudata(L, 2, "periphery.GPIO"));
+
+    /* Sysfs GPIO value files signal edges with POLLPRI */
+    if (lua_periphery_epoll_set_add(L, &pollset->set, 2, gpio_fd(gpio), lua_gpio_is_sysfs(gpio) ? (EPOLLPRI | EPOLLERR) : EPOLLIN) < 0)
+        return lua_gpio_error(L, GPIO_ERROR_IO, errno, "Error: adding GPIO to poll set: %s [errno %d]", strerror(errno), errno);
+
+    return 0;
+}
+
+static int lua_gpio_pollset_remove(lua_State *L) {
+    lua_gpio_pollset_t *pollset;
+
+    pollset = lua_gpio_pollset_checkopen(L, 1);
+    luaL_checkudata(L, 2, "periphery.GPIO");
+
+    lua_periphery_epoll_set_remove(L, &pollset->set, 2);
+
+    return 0;
+}
+
+static int lua_gpio_pollset_new(lua_State *L) {
+    lua_gpio_pollset_t *pollset;
+
+    /* Remove self table object */
+    lua_remove(L, 1);
+
+    /* Create handle userdata */
+    pollset = lua_newuserdata(L, sizeof(lua_gpio_pollset_t));
+    pollset->set.epfd = -1;
+    pollset->set.fds_ref = LUA_NOREF;
+    pollset->set.handles_ref = LUA_NOREF;
+    pollset->set.events = NULL;
+    pollset->ready_ref = LUA_NOREF;
+    /* Set GPIO PollSet metatable on it */
+    luaL_getmetatable(L, "periphery.GPIO.PollSet");
+    lua_setmetatable(L, -2);
+    /* Move userdata to the beginning of the stack */
+    lua_insert(L, 1);
+
+    if (lua_periphery_epoll_set_open(L, &pollset->set) < 0)
+        return lua_gpio_error(L, GPIO_ERROR_OPEN, errno, "Error: creating epoll instance: %s [errno %d]", strerror(errno), errno);
+
+    lua_newtable(L);
+    pollset->ready_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    /* Optional initial GPIOs */
+    if (lua_istable(L, 2)) {
+        unsigned int count = luaL_len(L, 2);
+
+        for (unsigned int i = 0; i < count; i++) {
+            lua_pushcclosure(L, lua_gpio_pollset_add, 0);
+            lua_pushvalue(L, 1);
+            lua_pushunsigned(L, i+1);
+            lua_gettable(L, 2);
+            lua_call(L, 2, 0);
+        }
+    } else if (!lua_isnone(L, 2) && !lua_isnil(L, 2))
+        return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid type of argument 'gpios', should be table or nil");
+
+    /* Leave only userdata on the stack */
+    lua_settop(L, 1);
+
+    return 1;
+}
+
+static int lua_gpio_pollset_wait(lua_State *L) {
+    lua_gpio_pollset_t *pollset;
+    int timeout_ms;
+
+    pollset = lua_gpio_pollset_checkopen(L, 1);
+
+    /* Optional timeout argument */
+    if (lua_isnone(L, 2) || lua_isnil(L, 2))
+        timeout_ms = -1;
+    else if (lua_isnumber(L, 2))
+        timeout_ms = lua_tointeger(L, 2);
+    else
+        return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
+
+    /* Fill ready table with GPIOs that had edge events occur */
+    lua_settop(L, 1);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, pollset->ready_ref);
+
+    if (lua_periphery_epoll_set_wait(L, &pollset->set, timeout_ms, 2, 0) < 0) {
+        if (errno == ENOMEM)
+            return lua_gpio_error(L, GPIO_ERROR_IO, errno, "Error: allocating memory");
+        return lua_gpio_error(L, GPIO_ERROR_IO, errno, "Error: polling GPIO poll set: %s [errno %d]", strerror(errno), errno);
+    }
+
+    return 1;
+}
+
+static void lua_gpio_pollset_release(lua_State *L, lua_gpio_pollset_t *pollset) {
+    lua_periphery_epoll_set_close(L, &pollset->set);
+
+    luaL_unref(L, LUA_REGISTRYINDEX, pollset->ready_ref);
+    pollset->ready_ref = LUA_NOREF;
+}
+
+static int lua_gpio_pollset_close(lua_State *L) {
+    lua_gpio_pollset_t *pollset;
+
+    pollset = luaL_checkudata(L, 1, "periphery.GPIO.PollSet");
+
+    lua_gpio_pollset_release(L, pollset);
+
+    return 0;
+}
+
+static int lua_gpio_pollset_gc(lua_State *L) {
+    lua_gpio_pollset_t *pollset;
+
+    pollset = luaL_checkudata(L, 1, "periphery.GPIO.PollSet");
+
+    lua_gpio_pollset_release(L, pollset);
+
+    return 0;
+}
+
+static int lua_gpio_pollset_tostring(lua_State *L) {
+    lua_gpio_pollset_t *pollset;
+
+    pollset = luaL_checkudata(L, 1, "periphery.GPIO.PollSet");
+
+    lua_pushfstring(L, "GPIO PollSet (fd=%d, count=%d)", pollset->set.epfd, (int)pollset->set.count);
+
+    return 1;
+}
+
+static int lua_gpio_pollset_index(lua_State *L) {
+    lua_gpio_pollset_t *pollset;
+    const char *field;
+
+    if (!lua_isstring(L, 2))
+        return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: unknown method or property");
+
+    field = lua_tostring(L, 2);
+
+    /* Look up method in metatable */
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, field);
+    if (!lua_isnil(L, -1))
+        return 1;
+
+    pollset = luaL_checkudata(L, 1, "periphery.GPIO.PollSet");
+
+    if (strcmp(field, "fd") == 0) {
+        lua_pushinteger(L, pollset->set.epfd);
+        return 1;
+    } else if (strcmp(field, "count") == 0) {
+        lua_pushunsigned(L, pollset->set.count);
+        return 1;
     }
 
     return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: unknown property");
 }
 
+static int lua_gpio_pollset_newindex(lua_State *L) {
+    return lua_gpio_error(L, GPIO_ERROR_ARG, 0, "Error: immutable property");
+}
+
+static const struct luaL_Reg periphery_gpio_pollset_m[] = {
+    {"close", lua_gpio_pollset_close},
+    {"add", lua_gpio_pollset_add},
+    {"remove", lua_gpio_pollset_remove},
+    {"wait", lua_gpio_pollset_wait},
+    {"__gc", lua_gpio_pollset_gc},
+    {"__tostring", lua_gpio_pollset_tostring},
+    {"__index", lua_gpio_pollset_index},
+    {"__newindex", lua_gpio_pollset_newindex},
+    {NULL, NULL}
+};
+
 static const struct luaL_Reg periphery_gpio_m[] = {
     {"close", lua_gpio_close},
     {"read", lua_gpio_read},
     {"write", lua_gpio_write},
     {"poll", lua_gpio_poll},
     {"read_event", lua_gpio_read_event},
+    {"capture_start", lua_gpio_capture_start},
+    {"capture_read", lua_gpio_capture_read},
+    {"capture_stop", lua_gpio_capture_stop},
+    {"buffer_start", lua_gpio_buffer_start},
+    {"drain", lua_gpio_drain},
+    {"buffer_stop", lua_gpio_buffer_stop},
     {"poll_multiple", lua_gpio_poll_multiple},
     {"__gc", lua_gpio_gc},
     {"__tostring", lua_gpio_tostring},
@@ -766,6 +1893,29 @@ LUALIB_API int luaopen_periphery_gpio(lua_State *L) {
     lua_pushstring(L, "protected metatable");
     lua_setfield(L, -2, "__metatable");
 
+    /* Create periphery.GPIO.PollSet metatable */
+    luaL_newmetatable(L, "periphery.GPIO.PollSet");
+    /* Set metatable functions */
+    funcs = (const struct luaL_Reg *)periphery_gpio_pollset_m;
+    for (; funcs->name != NULL; funcs++) {
+        lua_pushcclosure(L, funcs->func, 0);
+        lua_setfield(L, -2, funcs->name);
+    }
+    /* Set metatable properties */
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+
+    /* Create {__call = lua_gpio_pollset_new, __metatable = "protected metatable"} table */
+    lua_newtable(L);
+    lua_pushcclosure(L, lua_gpio_pollset_new, 0);
+    lua_setfield(L, -2, "__call");
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+    /* Set it as the metatable for the periphery.GPIO.PollSet metatable */
+    lua_setmetatable(L, -2);
+    /* Set it as the PollSet field of the periphery.GPIO metatable */
+    lua_setfield(L, -2, "PollSet");
+
     /* Create {__call = lua_gpio_new, __metatable = "protected metatable"} table */
     lua_newtable(L);
     lua_pushcclosure(L, lua_gpio_new, 0);
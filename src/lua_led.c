@@ -12,6 +12,9 @@
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <c-periphery/src/led.h>
 #include "lua_periphery.h"
@@ -28,12 +31,30 @@ led = LED{name=<string>}
 -- Methods
 led:read() --> <boolean>
 led:write(value <boolean|number>)
+led:blink(on_ms <number>, off_ms <number>)
+led:oneshot([on_ms <number|nil>, off_ms <number|nil>])
+led:pattern(steps <table>)
 led:close()
 
 -- Properties
 led.brightness      mutable <number>
 led.max_brightness  immutable <number>
+led.trigger         mutable <string>
+led.triggers        immutable <table>
+led.delay_on        mutable <number>
+led.delay_off       mutable <number>
 led.name            immutable <string>
+
+-- Static methods
+group = LED.group(leds <table>)
+
+-- Group methods
+group:write_all(values <table>) --> <number>
+group:read_all() --> <table>
+group:close()
+
+-- Group properties
+group.count         immutable <number>
 */
 
 static const char *led_error_code_strings[] = {
@@ -77,6 +98,159 @@ static void lua_led_checktype(lua_State *L, int index, int type) {
         lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid argument #%d (%s expected, got %s)", index, lua_typename(L, type), lua_typename(L, lua_type(L, index)));
 }
 
+/* Size of LED attribute buffers, and initial size of the trigger attribute
+ * buffer, which grows as needed, as the trigger attribute is a binary
+ * attribute not limited to a page since Linux 5.9 */
+#define LED_ATTR_BUF_SIZE   4096
+
+static void lua_led_attr_path(lua_State *L, led_t *led, const char *attr, char *path, size_t size) {
+    char name[64];
+    int ret;
+
+    if ((ret = led_name(led, name, sizeof(name))) < 0)
+        lua_led_error(L, ret, led_errno(led), "Error: %s", led_errmsg(led));
+
+    snprintf(path, size, "/sys/class/leds/%s/%s", name, attr);
+}
+
+static void lua_led_attr_read(lua_State *L, led_t *led, const char *attr, char *buf, size_t size) {
+    char path[128];
+    ssize_t len;
+    int fd;
+
+    lua_led_attr_path(L, led, attr, path, sizeof(path));
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        lua_led_error(L, LED_ERROR_QUERY, errno, "Error: opening LED '%s': %s [errno %d]", attr, strerror(errno), errno);
+
+    if ((len = read(fd, buf, size - 1)) < 0) {
+        int errsv = errno;
+        close(fd);
+        lua_led_error(L, LED_ERROR_QUERY, errsv, "Error: reading LED '%s': %s [errno %d]", attr, strerror(errsv), errsv);
+    }
+
+    close(fd);
+
+    /* Strip trailing newline */
+    if (len > 0 && buf[len - 1] == '\n')
+        len--;
+    buf[len] = '\0';
+}
+
+static void lua_led_attr_write(lua_State *L, led_t *led, const char *attr, const char *buf) {
+    char path[128];
+    int fd;
+
+    lua_led_attr_path(L, led, attr, path, sizeof(path));
+
+    if ((fd = open(path, O_WRONLY)) < 0)
+        lua_led_error(L, LED_ERROR_IO, errno, "Error: opening LED '%s': %s [errno %d]", attr, strerror(errno), errno);
+
+    if (write(fd, buf, strlen(buf)) < 0) {
+        int errsv = errno;
+        close(fd);
+        lua_led_error(L, LED_ERROR_IO, errsv, "Error: writing LED '%s': %s [errno %d]", attr, strerror(errsv), errsv);
+    }
+
+    close(fd);
+}
+
+static void lua_led_attr_write_unsigned(lua_State *L, led_t *led, const char *attr, unsigned int value) {
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "%u\n", value);
+
+    lua_led_attr_write(L, led, attr, buf);
+}
+
+/* Read the trigger attribute to EOF into a buffer allocated with malloc(),
+ * which should be freed by the caller */
+static char *lua_led_triggers_read(lua_State *L, led_t *led) {
+    char path[128];
+    char *buf, *newbuf;
+    size_t size = LED_ATTR_BUF_SIZE;
+    size_t len = 0;
+    ssize_t ret;
+    int fd;
+
+    lua_led_attr_path(L, led, "trigger", path, sizeof(path));
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        lua_led_error(L, LED_ERROR_QUERY, errno, "Error: opening LED 'trigger': %s [errno %d]", strerror(errno), errno);
+
+    if ((buf = malloc(size)) == NULL) {
+        int errsv = errno;
+        close(fd);
+        lua_led_error(L, LED_ERROR_QUERY, errsv, "Error: allocating memory");
+    }
+
+    while (true) {
+        /* Grow buffer, leaving room for the terminator */
+        if (len == size - 1) {
+            if ((newbuf = realloc(buf, size * 2)) == NULL) {
+                int errsv = errno;
+                free(buf);
+                close(fd);
+                lua_led_error(L, LED_ERROR_QUERY, errsv, "Error: allocating memory");
+            }
+            buf = newbuf;
+            size *= 2;
+        }
+
+        if ((ret = read(fd, buf + len, size - 1 - len)) < 0) {
+            int errsv = errno;
+            if (errsv == EINTR)
+                continue;
+            free(buf);
+            close(fd);
+            lua_led_error(L, LED_ERROR_QUERY, errsv, "Error: reading LED 'trigger': %s [errno %d]", strerror(errsv), errsv);
+        } else if (ret == 0) {
+            break;
+        }
+
+        len += ret;
+    }
+
+    close(fd);
+
+    /* Strip trailing newline */
+    if (len > 0 && buf[len - 1] == '\n')
+        len--;
+    buf[len] = '\0';
+
+    return buf;
+}
+
+/* Copy the selected trigger, which is bracketed in the trigger attribute,
+ * into trigger */
+static void lua_led_get_trigger(lua_State *L, led_t *led, char *trigger, size_t size) {
+    char *buf;
+    char *start, *end;
+
+    buf = lua_led_triggers_read(L, led);
+
+    if ((start = strchr(buf, '[')) == NULL || (end = strchr(start, ']')) == NULL) {
+        snprintf(trigger, size, "none");
+        free(buf);
+        return;
+    }
+
+    *end = '\0';
+    snprintf(trigger, size, "%s", start + 1);
+    free(buf);
+}
+
+/* Select a trigger, unless it is already selected, as reselecting a trigger
+ * resets its parameters */
+static void lua_led_set_trigger(lua_State *L, led_t *led, const char *trigger) {
+    char current[64];
+
+    lua_led_get_trigger(L, led, current, sizeof(current));
+
+    if (strcmp(current, trigger) != 0)
+        lua_led_attr_write(L, led, "trigger", trigger);
+}
+
 static int lua_led_open(lua_State *L) {
     led_t *led;
     const char *name;
@@ -165,6 +339,100 @@ static int lua_led_write(lua_State *L) {
     return 0;
 }
 
+static int lua_led_blink(lua_State *L) {
+    led_t *led;
+    unsigned int on_ms, off_ms;
+
+    led = *((led_t **)luaL_checkudata(L, 1, "periphery.LED"));
+    lua_led_checktype(L, 2, LUA_TNUMBER);
+    lua_led_checktype(L, 3, LUA_TNUMBER);
+
+    on_ms = lua_tounsigned(L, 2);
+    off_ms = lua_tounsigned(L, 3);
+
+    lua_led_set_trigger(L, led, "timer");
+    lua_led_attr_write_unsigned(L, led, "delay_on", on_ms);
+    lua_led_attr_write_unsigned(L, led, "delay_off", off_ms);
+
+    return 0;
+}
+
+static int lua_led_oneshot(lua_State *L) {
+    led_t *led;
+
+    led = *((led_t **)luaL_checkudata(L, 1, "periphery.LED"));
+
+    /* Optional on_ms and off_ms */
+    if (!lua_isnoneornil(L, 2))
+        lua_led_checktype(L, 2, LUA_TNUMBER);
+    if (!lua_isnoneornil(L, 3))
+        lua_led_checktype(L, 3, LUA_TNUMBER);
+
+    lua_led_set_trigger(L, led, "oneshot");
+
+    if (!lua_isnoneornil(L, 2))
+        lua_led_attr_write_unsigned(L, led, "delay_on", lua_tounsigned(L, 2));
+    if (!lua_isnoneornil(L, 3))
+        lua_led_attr_write_unsigned(L, led, "delay_off", lua_tounsigned(L, 3));
+
+    lua_led_attr_write(L, led, "shot", "1\n");
+
+    return 0;
+}
+
+static int lua_led_pattern(lua_State *L) {
+    led_t *led;
+    char pattern[LED_ATTR_BUF_SIZE];
+    char buf[16];
+    size_t len = 0;
+    unsigned int count;
+    int repeat = -1;
+
+    led = *((led_t **)luaL_checkudata(L, 1, "periphery.LED"));
+    lua_led_checktype(L, 2, LUA_TTABLE);
+
+    /* Optional repeat */
+    lua_getfield(L, 2, "repeat");
+    if (lua_isnumber(L, -1))
+        repeat = lua_tointeger(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid type of table argument 'repeat', should be number");
+    lua_pop(L, 1);
+
+    if ((count = luaL_len(L, 2)) == 0)
+        return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid pattern, should have at least one step");
+
+    /* Format steps as "<brightness> <duration_ms> ..." */
+    for (unsigned int i = 1; i <= count; i++) {
+        lua_rawgeti(L, 2, i);
+        if (!lua_istable(L, -1))
+            return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid pattern step %u, should be table", i);
+
+        lua_getfield(L, -1, "brightness");
+        lua_getfield(L, -2, "duration_ms");
+        if (!lua_isnumber(L, -2))
+            return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid field 'brightness' in pattern step %u, should be number", i);
+        if (!lua_isnumber(L, -1))
+            return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid field 'duration_ms' in pattern step %u, should be number", i);
+
+        len += snprintf(pattern + len, sizeof(pattern) - len, "%s%u %u", (i > 1) ? " " : "", (unsigned int)lua_tounsigned(L, -2), (unsigned int)lua_tounsigned(L, -1));
+        if (len >= sizeof(pattern) - 1)
+            return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid pattern, too many steps");
+
+        lua_pop(L, 3);
+    }
+    pattern[len++] = '\n';
+    pattern[len] = '\0';
+
+    lua_led_set_trigger(L, led, "pattern");
+    lua_led_attr_write(L, led, "pattern", pattern);
+
+    snprintf(buf, sizeof(buf), "%d\n", repeat);
+    lua_led_attr_write(L, led, "repeat", buf);
+
+    return 0;
+}
+
 static int lua_led_close(lua_State *L) {
     led_t *led;
     int ret;
@@ -246,6 +514,41 @@ static int lua_led_index(lua_State *L) {
 
         lua_pushunsigned(L, max_brightness);
         return 1;
+    } else if (strcmp(field, "trigger") == 0) {
+        char trigger[64];
+
+        lua_led_get_trigger(L, led, trigger, sizeof(trigger));
+
+        lua_pushstring(L, trigger);
+        return 1;
+    } else if (strcmp(field, "triggers") == 0) {
+        char *buf;
+        char *token, *saveptr;
+        unsigned int i = 0;
+
+        buf = lua_led_triggers_read(L, led);
+
+        lua_newtable(L);
+        for (token = strtok_r(buf, " ", &saveptr); token != NULL; token = strtok_r(NULL, " ", &saveptr)) {
+            size_t len = strlen(token);
+
+            /* Strip brackets of the selected trigger */
+            if (token[0] == '[' && len > 1 && token[len - 1] == ']')
+                lua_pushlstring(L, token + 1, len - 2);
+            else
+                lua_pushstring(L, token);
+
+            lua_rawseti(L, -2, ++i);
+        }
+        free(buf);
+        return 1;
+    } else if (strcmp(field, "delay_on") == 0 || strcmp(field, "delay_off") == 0) {
+        char buf[16];
+
+        lua_led_attr_read(L, led, field, buf, sizeof(buf));
+
+        lua_pushunsigned(L, strtoul(buf, NULL, 10));
+        return 1;
     }
 
     return lua_led_error(L, LED_ERROR_ARG, 0, "Error: unknown property");
@@ -266,6 +569,23 @@ static int lua_led_newindex(lua_State *L) {
         return lua_led_error(L, LED_ERROR_ARG, 0, "Error: immutable property");
     } else if (strcmp(field, "max_brightness") == 0) {
         return lua_led_error(L, LED_ERROR_ARG, 0, "Error: immutable property");
+    } else if (strcmp(field, "triggers") == 0) {
+        return lua_led_error(L, LED_ERROR_ARG, 0, "Error: immutable property");
+    } else if (strcmp(field, "trigger") == 0) {
+        char buf[64];
+
+        lua_led_checktype(L, 3, LUA_TSTRING);
+        snprintf(buf, sizeof(buf), "%s\n", lua_tostring(L, 3));
+
+        lua_led_attr_write(L, led, "trigger", buf);
+
+        return 0;
+    } else if (strcmp(field, "delay_on") == 0 || strcmp(field, "delay_off") == 0) {
+        lua_led_checktype(L, 3, LUA_TNUMBER);
+
+        lua_led_attr_write_unsigned(L, led, field, lua_tounsigned(L, 3));
+
+        return 0;
     } else if (strcmp(field, "brightness") == 0) {
         unsigned int brightness;
         int ret;
@@ -282,10 +602,287 @@ static int lua_led_newindex(lua_State *L) {
     return lua_led_error(L, LED_ERROR_ARG, 0, "Error: unknown property");
 }
 
+/* LED group userdata */
+typedef struct lua_led_group {
+    unsigned int count;
+    /* Brightness attribute fds, kept open and accessed with pread()/pwrite()
+     * at offset 0 */
+    int *fds;
+    /* Brightness last read or written */
+    unsigned int *brightness;
+    unsigned int *max_brightness;
+    /* Values being written, reused across writes */
+    unsigned int *values;
+} lua_led_group_t;
+
+static bool lua_led_isled(lua_State *L, int index) {
+    bool isled;
+
+    if (!lua_isuserdata(L, index) || !lua_getmetatable(L, index))
+        return false;
+
+    luaL_getmetatable(L, "periphery.LED");
+    isled = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);
+
+    return isled;
+}
+
+static int lua_led_group_read_attr(int fd, unsigned int *value) {
+    char buf[16];
+    ssize_t len;
+
+    if ((len = pread(fd, buf, sizeof(buf) - 1, 0)) < 0)
+        return -1;
+
+    buf[len] = '\0';
+    *value = strtoul(buf, NULL, 10);
+
+    return 0;
+}
+
+static void lua_led_group_release(lua_led_group_t *group) {
+    for (unsigned int i = 0; i < group->count; i++) {
+        if (group->fds[i] >= 0)
+            close(group->fds[i]);
+    }
+
+    free(group->fds);
+    free(group->brightness);
+    free(group->max_brightness);
+    free(group->values);
+    group->fds = NULL;
+    group->brightness = NULL;
+    group->max_brightness = NULL;
+    group->values = NULL;
+    group->count = 0;
+}
+
+static int lua_led_group(lua_State *L) {
+    lua_led_group_t *group;
+    unsigned int count;
+
+    lua_led_checktype(L, 1, LUA_TTABLE);
+
+    if ((count = luaL_len(L, 1)) == 0)
+        return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid group, should have at least one LED");
+
+    /* Create handle userdata */
+    group = lua_newuserdata(L, sizeof(lua_led_group_t));
+    group->count = 0;
+    group->fds = NULL;
+    group->brightness = NULL;
+    group->max_brightness = NULL;
+    group->values = NULL;
+    /* Set LED Group metatable on it */
+    luaL_getmetatable(L, "periphery.LED.Group");
+    lua_setmetatable(L, -2);
+
+    group->fds = malloc(count * sizeof(int));
+    group->brightness = calloc(count, sizeof(unsigned int));
+    group->max_brightness = calloc(count, sizeof(unsigned int));
+    group->values = calloc(count, sizeof(unsigned int));
+    if (group->fds == NULL || group->brightness == NULL || group->max_brightness == NULL || group->values == NULL)
+        return lua_led_error(L, LED_ERROR_OPEN, errno, "Error: allocating memory");
+
+    for (unsigned int i = 0; i < count; i++)
+        group->fds[i] = -1;
+    group->count = count;
+
+    for (unsigned int i = 0; i < count; i++) {
+        char name[64];
+        char path[128];
+        int fd;
+
+        /* Member by name or by LED object */
+        lua_rawgeti(L, 1, i + 1);
+        if (lua_type(L, -1) == LUA_TSTRING) {
+            snprintf(name, sizeof(name), "%s", lua_tostring(L, -1));
+        } else if (lua_led_isled(L, -1)) {
+            led_t *led = *((led_t **)lua_touserdata(L, -1));
+            int ret;
+
+            if ((ret = led_name(led, name, sizeof(name))) < 0)
+                return lua_led_error(L, ret, led_errno(led), "Error: %s", led_errmsg(led));
+        } else {
+            return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid group member %u, should be string or LED object", i + 1);
+        }
+        lua_pop(L, 1);
+
+        snprintf(path, sizeof(path), "/sys/class/leds/%s/max_brightness", name);
+        if ((fd = open(path, O_RDONLY)) < 0)
+            return lua_led_error(L, LED_ERROR_OPEN, errno, "Error: opening LED '%s' 'max_brightness': %s [errno %d]", name, strerror(errno), errno);
+        if (lua_led_group_read_attr(fd, &group->max_brightness[i]) < 0) {
+            int errsv = errno;
+            close(fd);
+            return lua_led_error(L, LED_ERROR_QUERY, errsv, "Error: reading LED '%s' 'max_brightness': %s [errno %d]", name, strerror(errsv), errsv);
+        }
+        close(fd);
+
+        snprintf(path, sizeof(path), "/sys/class/leds/%s/brightness", name);
+        if ((group->fds[i] = open(path, O_RDWR)) < 0)
+            return lua_led_error(L, LED_ERROR_OPEN, errno, "Error: opening LED '%s' 'brightness': %s [errno %d]", name, strerror(errno), errno);
+        if (lua_led_group_read_attr(group->fds[i], &group->brightness[i]) < 0)
+            return lua_led_error(L, LED_ERROR_QUERY, errno, "Error: reading LED '%s' 'brightness': %s [errno %d]", name, strerror(errno), errno);
+    }
+
+    return 1;
+}
+
+static lua_led_group_t *lua_led_group_checkopen(lua_State *L, int index) {
+    lua_led_group_t *group = luaL_checkudata(L, index, "periphery.LED.Group");
+
+    if (group->fds == NULL)
+        lua_led_error(L, LED_ERROR_ARG, 0, "Error: LED group is closed");
+
+    return group;
+}
+
+static int lua_led_group_write_all(lua_State *L) {
+    lua_led_group_t *group;
+    unsigned int *values;
+    unsigned int written = 0;
+
+    group = lua_led_group_checkopen(L, 1);
+    lua_led_checktype(L, 2, LUA_TTABLE);
+
+    if (luaL_len(L, 2) != group->count)
+        return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid number of values, should be %u", group->count);
+
+    /* Collect all values before the first write */
+    values = group->values;
+
+    for (unsigned int i = 0; i < group->count; i++) {
+        lua_rawgeti(L, 2, i + 1);
+
+        if (lua_isboolean(L, -1))
+            values[i] = lua_toboolean(L, -1) ? group->max_brightness[i] : 0;
+        else if (lua_isnumber(L, -1))
+            values[i] = lua_tounsigned(L, -1);
+        else
+            return lua_led_error(L, LED_ERROR_ARG, 0, "Error: invalid value %u (number or boolean expected, got %s)", i + 1, lua_typename(L, lua_type(L, -1)));
+
+        lua_pop(L, 1);
+    }
+
+    /* Write only the changed values */
+    for (unsigned int i = 0; i < group->count; i++) {
+        char buf[16];
+        int len;
+
+        if (values[i] == group->brightness[i])
+            continue;
+
+        len = snprintf(buf, sizeof(buf), "%u\n", values[i]);
+
+        if (pwrite(group->fds[i], buf, len, 0) < 0)
+            return lua_led_error(L, LED_ERROR_IO, errno, "Error: writing LED %u 'brightness': %s [errno %d]", i + 1, strerror(errno), errno);
+
+        group->brightness[i] = values[i];
+        written++;
+    }
+
+    lua_pushunsigned(L, written);
+
+    return 1;
+}
+
+static int lua_led_group_read_all(lua_State *L) {
+    lua_led_group_t *group;
+
+    group = lua_led_group_checkopen(L, 1);
+
+    lua_createtable(L, group->count, 0);
+
+    for (unsigned int i = 0; i < group->count; i++) {
+        if (lua_led_group_read_attr(group->fds[i], &group->brightness[i]) < 0)
+            return lua_led_error(L, LED_ERROR_IO, errno, "Error: reading LED %u 'brightness': %s [errno %d]", i + 1, strerror(errno), errno);
+
+        lua_pushunsigned(L, group->brightness[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    return 1;
+}
+
+static int lua_led_group_close(lua_State *L) {
+    lua_led_group_t *group;
+
+    group = luaL_checkudata(L, 1, "periphery.LED.Group");
+
+    lua_led_group_release(group);
+
+    return 0;
+}
+
+static int lua_led_group_gc(lua_State *L) {
+    lua_led_group_t *group;
+
+    group = luaL_checkudata(L, 1, "periphery.LED.Group");
+
+    lua_led_group_release(group);
+
+    return 0;
+}
+
+static int lua_led_group_tostring(lua_State *L) {
+    lua_led_group_t *group;
+
+    group = luaL_checkudata(L, 1, "periphery.LED.Group");
+
+    lua_pushfstring(L, "LED Group (count=%d)", (int)group->count);
+
+    return 1;
+}
+
+static int lua_led_group_index(lua_State *L) {
+    lua_led_group_t *group;
+    const char *field;
+
+    if (!lua_isstring(L, 2))
+        return lua_led_error(L, LED_ERROR_ARG, 0, "Error: unknown method or property");
+
+    field = lua_tostring(L, 2);
+
+    /* Look up method in metatable */
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, field);
+    if (!lua_isnil(L, -1))
+        return 1;
+
+    group = luaL_checkudata(L, 1, "periphery.LED.Group");
+
+    if (strcmp(field, "count") == 0) {
+        lua_pushunsigned(L, group->count);
+        return 1;
+    }
+
+    return lua_led_error(L, LED_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static int lua_led_group_newindex(lua_State *L) {
+    return lua_led_error(L, LED_ERROR_ARG, 0, "Error: immutable property");
+}
+
+static const struct luaL_Reg periphery_led_group_m[] = {
+    {"close", lua_led_group_close},
+    {"write_all", lua_led_group_write_all},
+    {"read_all", lua_led_group_read_all},
+    {"__gc", lua_led_group_gc},
+    {"__tostring", lua_led_group_tostring},
+    {"__index", lua_led_group_index},
+    {"__newindex", lua_led_group_newindex},
+    {NULL, NULL}
+};
+
 static const struct luaL_Reg periphery_led_m[] = {
     {"close", lua_led_close},
     {"read", lua_led_read},
     {"write", lua_led_write},
+    {"blink", lua_led_blink},
+    {"oneshot", lua_led_oneshot},
+    {"pattern", lua_led_pattern},
+    {"group", lua_led_group},
     {"__gc", lua_led_gc},
     {"__tostring", lua_led_tostring},
     {"__index", lua_led_index},
@@ -306,6 +903,19 @@ LUALIB_API int luaopen_periphery_led(lua_State *L) {
     lua_pushstring(L, "protected metatable");
     lua_setfield(L, -2, "__metatable");
 
+    /* Create periphery.LED.Group metatable */
+    luaL_newmetatable(L, "periphery.LED.Group");
+    /* Set metatable functions */
+    funcs = (const struct luaL_Reg *)periphery_led_group_m;
+    for (; funcs->name != NULL; funcs++) {
+        lua_pushcclosure(L, funcs->func, 0);
+        lua_setfield(L, -2, funcs->name);
+    }
+    /* Set metatable properties */
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+    lua_pop(L, 1);
+
     /* Create {__call = lua_led_new, __metatable = "protected metatable"} table */
     lua_newtable(L);
     lua_pushcclosure(L, lua_led_new, 0);
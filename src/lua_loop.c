@@ -0,0 +1,464 @@
+/*
+ * lua-periphery by vsergeev
+ * https://github.com/vsergeev/lua-periphery
+ * License: MIT
+ */
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+
+#include "lua_periphery.h"
+#include "lua_compat.h"
+
+/*
+local periphery = require('periphery')
+local loop = periphery.loop
+
+-- Functions
+loop.spawn(fn <function>, ...) --> <thread>
+loop.run()
+loop.sleep_ms(duration <number>)
+loop.count() --> <number>
+*/
+
+enum loop_error_code {
+    LOOP_ERROR_ARG          = -1, /* Invalid arguments */
+    LOOP_ERROR_IO           = -2, /* Polling file descriptors */
+};
+
+static const char *loop_error_code_strings[] = {
+    [-LOOP_ERROR_ARG]       = "LOOP_ERROR_ARG",
+    [-LOOP_ERROR_IO]        = "LOOP_ERROR_IO",
+};
+
+/* Registry keys of the scheduler state: the table of tasks (thread -> true),
+ * the array of tasks ready to be resumed, and the array of waiting tasks, as
+ * {thread, fd, events, deadline_ms} entries */
+#define LOOP_TASKS_KEY      "periphery.loop.tasks"
+#define LOOP_READY_KEY      "periphery.loop.ready"
+#define LOOP_WAITING_KEY    "periphery.loop.waiting"
+#define LOOP_RUNNING_KEY    "periphery.loop.running"
+
+/* Address identifying wait requests among values yielded by tasks */
+static const char lua_loop_wait_marker = 0;
+
+static int lua_loop_error(lua_State *L, enum loop_error_code code, int c_errno, const char *fmt, ...) {
+    char message[128];
+    va_list ap;
+
+    va_start(ap, fmt);
+
+    /* Create error table */
+    lua_newtable(L);
+    /* .code string */
+    lua_pushstring(L, loop_error_code_strings[-code]);
+    lua_setfield(L, -2, "code");
+    /* .c_errno number */
+    lua_pushinteger(L, c_errno);
+    lua_setfield(L, -2, "c_errno");
+    /* .message string */
+    vsnprintf(message, sizeof(message), fmt, ap);
+    lua_pushstring(L, message);
+    lua_setfield(L, -2, "message");
+
+    va_end(ap);
+
+    /* Set error metatable on it */
+    luaL_getmetatable(L, "periphery.error");
+    lua_setmetatable(L, -2);
+
+    return lua_error(L);
+}
+
+static double lua_loop_monotonic_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((double)ts.tv_sec * 1e3) + ((double)ts.tv_nsec / 1e6);
+}
+
+/******************************************************************************/
+/* Cooperative I/O API for the other modules */
+/******************************************************************************/
+
+bool lua_periphery_loop_can_yield(lua_State *L) {
+#if LUA_VERSION_NUM >= 502
+    bool managed;
+
+#if LUA_VERSION_NUM >= 503
+    if (!lua_isyieldable(L))
+        return false;
+#endif
+
+    lua_getfield(L, LUA_REGISTRYINDEX, LOOP_TASKS_KEY);
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        return false;
+    }
+
+    lua_pushthread(L);
+    lua_rawget(L, -2);
+    managed = lua_toboolean(L, -1);
+    lua_pop(L, 2);
+
+    return managed;
+#else
+    /* Lua 5.1 C functions cannot be continued after a yield */
+    return false;
+#endif
+}
+
+double lua_periphery_loop_deadline(int timeout_ms) {
+    return (timeout_ms < 0) ? -1 : lua_loop_monotonic_ms() + timeout_ms;
+}
+
+int lua_periphery_loop_remaining(double deadline_ms) {
+    double remaining_ms;
+
+    if (deadline_ms < 0)
+        return -1;
+
+    remaining_ms = deadline_ms - lua_loop_monotonic_ms();
+
+    return (remaining_ms > 0) ? (int)(remaining_ms + 0.999) : 0;
+}
+
+#if LUA_VERSION_NUM >= 503
+static int lua_loop_continue(lua_State *L, int status, lua_KContext ctx) {
+    return ((lua_CFunction)ctx)(L);
+}
+#endif
+
+int lua_periphery_loop_wait(lua_State *L, int fd, int events, int timeout_ms, lua_CFunction k) {
+    lua_pushlightuserdata(L, (void *)&lua_loop_wait_marker);
+    lua_pushinteger(L, fd);
+    lua_pushinteger(L, events);
+    lua_pushinteger(L, timeout_ms);
+
+#if LUA_VERSION_NUM == 502
+    return lua_yieldk(L, 4, 0, k);
+#elif LUA_VERSION_NUM >= 503
+    return lua_yieldk(L, 4, (lua_KContext)k, lua_loop_continue);
+#else
+    return lua_loop_error(L, LOOP_ERROR_ARG, 0, "Error: yielding requires Lua 5.2 or greater");
+#endif
+}
+
+/******************************************************************************/
+/* Scheduler */
+/******************************************************************************/
+
+static int lua_loop_resume(lua_State *co, lua_State *from, int nargs, int *nres) {
+#if LUA_VERSION_NUM >= 504
+    return lua_resume(co, from, nargs, nres);
+#else
+    int status;
+
+#if LUA_VERSION_NUM >= 502
+    status = lua_resume(co, from, nargs);
+#else
+    status = lua_resume(co, nargs);
+#endif
+    *nres = lua_gettop(co);
+
+    return status;
+#endif
+}
+
+static void lua_loop_append(lua_State *L, const char *key) {
+    /* Append the value at the top of the stack to the array at key */
+    lua_getfield(L, LUA_REGISTRYINDEX, key);
+    lua_insert(L, -2);
+    lua_rawseti(L, -2, luaL_len(L, -2) + 1);
+    lua_pop(L, 1);
+}
+
+static void lua_loop_remove_task(lua_State *L, int index) {
+    if (index < 0)
+        index = lua_gettop(L) + index + 1;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, LOOP_TASKS_KEY);
+    lua_pushvalue(L, index);
+    lua_pushnil(L);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+static void lua_loop_set_running(lua_State *L, bool running) {
+    lua_pushboolean(L, running);
+    lua_setfield(L, LUA_REGISTRYINDEX, LOOP_RUNNING_KEY);
+}
+
+/* Resume the task at the top of the stack, and pop it. Returns -1 with the
+ * task's error object pushed if the task raised an error. */
+static int lua_loop_resume_task(lua_State *L) {
+    lua_State *co = lua_tothread(L, -1);
+    int nargs, nres, status;
+
+    /* A task that has not started yet holds its function and arguments */
+    nargs = (lua_status(co) == LUA_YIELD) ? 0 : lua_gettop(co) - 1;
+
+    status = lua_loop_resume(co, L, nargs, &nres);
+
+    if (status == LUA_YIELD) {
+        if (nres == 4 && lua_touserdata(co, -4) == (void *)&lua_loop_wait_marker) {
+            int timeout_ms = lua_tointeger(co, -1);
+
+            /* Wait entry {thread, fd, events, deadline_ms} */
+            lua_createtable(L, 4, 0);
+            lua_pushvalue(L, -2);
+            lua_rawseti(L, -2, 1);
+            lua_pushinteger(L, lua_tointeger(co, -3));
+            lua_rawseti(L, -2, 2);
+            lua_pushinteger(L, lua_tointeger(co, -2));
+            lua_rawseti(L, -2, 3);
+            lua_pushnumber(L, lua_periphery_loop_deadline(timeout_ms));
+            lua_rawseti(L, -2, 4);
+            lua_loop_append(L, LOOP_WAITING_KEY);
+        } else {
+            /* Plain coroutine.yield(), rescheduled on the next iteration */
+            lua_pushvalue(L, -1);
+            lua_loop_append(L, LOOP_READY_KEY);
+        }
+
+        lua_pop(co, nres);
+        lua_pop(L, 1);
+    } else if (status == 0) {
+        /* Task returned */
+        lua_pop(co, nres);
+        lua_loop_remove_task(L, -1);
+        lua_pop(L, 1);
+    } else {
+        /* Task raised an error */
+        lua_loop_remove_task(L, -1);
+        lua_pop(L, 1);
+        lua_xmove(co, L, 1);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int lua_loop_spawn(lua_State *L) {
+    lua_State *co;
+    int nargs = lua_gettop(L);
+
+    if (!lua_isfunction(L, 1))
+        return lua_loop_error(L, LOOP_ERROR_ARG, 0, "Error: invalid type of argument 'fn', should be function");
+
+    co = lua_newthread(L);
+    /* Move function and arguments to the new thread */
+    lua_insert(L, 1);
+    lua_xmove(L, co, nargs);
+
+    /* Register the task and schedule it */
+    lua_getfield(L, LUA_REGISTRYINDEX, LOOP_TASKS_KEY);
+    lua_pushvalue(L, 1);
+    lua_pushboolean(L, true);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_pushvalue(L, 1);
+    lua_loop_append(L, LOOP_READY_KEY);
+
+    return 1;
+}
+
+static int lua_loop_run(lua_State *L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, LOOP_RUNNING_KEY);
+    if (lua_toboolean(L, -1))
+        return lua_loop_error(L, LOOP_ERROR_ARG, 0, "Error: loop is already running");
+    lua_pop(L, 1);
+
+    lua_loop_set_running(L, true);
+
+    for (;;) {
+        struct pollfd *fds;
+        unsigned int nready, nwaiting, nfds = 0;
+        int timeout_ms = -1;
+        double now_ms;
+        int ret;
+
+        /* Swap in a new ready array, and resume the ready tasks */
+        lua_getfield(L, LUA_REGISTRYINDEX, LOOP_READY_KEY);
+        lua_newtable(L);
+        lua_setfield(L, LUA_REGISTRYINDEX, LOOP_READY_KEY);
+
+        nready = luaL_len(L, -1);
+        for (unsigned int i = 1; i <= nready; i++) {
+            lua_rawgeti(L, -1, i);
+
+            if (lua_loop_resume_task(L) < 0) {
+                /* Reschedule the tasks not resumed yet, and propagate the
+                 * task's error from run() */
+                for (unsigned int j = i + 1; j <= nready; j++) {
+                    lua_rawgeti(L, -2, j);
+                    lua_loop_append(L, LOOP_READY_KEY);
+                }
+
+                lua_loop_set_running(L, false);
+                return lua_error(L);
+            }
+        }
+        lua_pop(L, 1);
+
+        lua_getfield(L, LUA_REGISTRYINDEX, LOOP_READY_KEY);
+        nready = luaL_len(L, -1);
+        lua_pop(L, 1);
+
+        lua_getfield(L, LUA_REGISTRYINDEX, LOOP_WAITING_KEY);
+        nwaiting = luaL_len(L, -1);
+
+        if (nready == 0 && nwaiting == 0) {
+            lua_pop(L, 1);
+            break;
+        }
+
+        /* Collect fds and the earliest deadline of the waiting tasks */
+        fds = lua_newuserdata(L, (nwaiting > 0 ? nwaiting : 1) * sizeof(struct pollfd));
+
+        for (unsigned int i = 1; i <= nwaiting; i++) {
+            int remaining_ms;
+
+            lua_rawgeti(L, -2, i);
+
+            lua_rawgeti(L, -1, 2);
+            lua_rawgeti(L, -2, 3);
+            if (lua_tointeger(L, -2) >= 0) {
+                fds[nfds].fd = lua_tointeger(L, -2);
+                fds[nfds].events = lua_tointeger(L, -1);
+                fds[nfds].revents = 0;
+                nfds++;
+            }
+            lua_pop(L, 2);
+
+            lua_rawgeti(L, -1, 4);
+            remaining_ms = lua_periphery_loop_remaining(lua_tonumber(L, -1));
+            if (remaining_ms >= 0 && (timeout_ms < 0 || remaining_ms < timeout_ms))
+                timeout_ms = remaining_ms;
+            lua_pop(L, 2);
+        }
+
+        if (nready > 0)
+            timeout_ms = 0;
+
+        if ((ret = poll(fds, nfds, timeout_ms)) < 0 && errno != EINTR) {
+            int errsv = errno;
+            lua_loop_set_running(L, false);
+            return lua_loop_error(L, LOOP_ERROR_IO, errsv, "Error: polling: %s [errno %d]", strerror(errsv), errsv);
+        }
+
+        /* Move tasks whose fd is ready or whose deadline passed to the ready
+         * array, keeping the rest waiting */
+        now_ms = lua_loop_monotonic_ms();
+        lua_newtable(L);
+        nfds = 0;
+
+        for (unsigned int i = 1, j = 0; i <= nwaiting; i++) {
+            bool ready = false;
+            double deadline_ms;
+
+            lua_rawgeti(L, -3, i);
+
+            lua_rawgeti(L, -1, 2);
+            if (lua_tointeger(L, -1) >= 0)
+                ready = (ret > 0) && fds[nfds++].revents != 0;
+            lua_pop(L, 1);
+
+            lua_rawgeti(L, -1, 4);
+            deadline_ms = lua_tonumber(L, -1);
+            lua_pop(L, 1);
+
+            if (ready || (deadline_ms >= 0 && now_ms >= deadline_ms)) {
+                lua_rawgeti(L, -1, 1);
+                lua_loop_append(L, LOOP_READY_KEY);
+                lua_pop(L, 1);
+            } else {
+                lua_rawseti(L, -2, ++j);
+            }
+        }
+
+        lua_setfield(L, LUA_REGISTRYINDEX, LOOP_WAITING_KEY);
+        lua_pop(L, 2);
+    }
+
+    lua_loop_set_running(L, false);
+
+    return 0;
+}
+
+static int lua_loop_sleep_ms_k(lua_State *L) {
+    return 0;
+}
+
+static int lua_loop_sleep_ms(lua_State *L) {
+    unsigned int duration;
+    struct timespec ts;
+
+    duration = luaL_checkunsigned(L, 1);
+
+    if (lua_periphery_loop_can_yield(L)) {
+        lua_settop(L, 0);
+        return lua_periphery_loop_wait(L, -1, 0, duration, lua_loop_sleep_ms_k);
+    }
+
+    ts.tv_sec = duration / 1000;
+    ts.tv_nsec = (duration - ts.tv_sec*1000)*1000000;
+    nanosleep(&ts, NULL);
+
+    return 0;
+}
+
+static int lua_loop_count(lua_State *L) {
+    unsigned int count = 0;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, LOOP_TASKS_KEY);
+    lua_pushnil(L);
+    while (lua_next(L, -2) != 0) {
+        count++;
+        lua_pop(L, 1);
+    }
+
+    lua_pushunsigned(L, count);
+
+    return 1;
+}
+
+static const struct luaL_Reg periphery_loop_f[] = {
+    {"spawn", lua_loop_spawn},
+    {"run", lua_loop_run},
+    {"sleep_ms", lua_loop_sleep_ms},
+    {"count", lua_loop_count},
+    {NULL, NULL}
+};
+
+LUALIB_API int luaopen_periphery_loop(lua_State *L) {
+    /* Create scheduler state */
+    lua_newtable(L);
+    lua_setfield(L, LUA_REGISTRYINDEX, LOOP_TASKS_KEY);
+    lua_newtable(L);
+    lua_setfield(L, LUA_REGISTRYINDEX, LOOP_READY_KEY);
+    lua_newtable(L);
+    lua_setfield(L, LUA_REGISTRYINDEX, LOOP_WAITING_KEY);
+    lua_loop_set_running(L, false);
+
+    /* Create table of functions */
+    lua_newtable(L);
+    const struct luaL_Reg *funcs = (const struct luaL_Reg *)periphery_loop_f;
+    for (; funcs->name != NULL; funcs++) {
+        lua_pushcclosure(L, funcs->func, 0);
+        lua_setfield(L, -2, funcs->name);
+    }
+
+    return 1;
+}
@@ -0,0 +1,793 @@
+/*
+ * lua-periphery by vsergeev
+ * https://github.com/vsergeev/lua-periphery
+ * License: MIT
+ */
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+#include <c-periphery/src/serial.h>
+#include "lua_periphery.h"
+#include "lua_compat.h"
+
+/*
+local periphery = require('periphery')
+local ModbusRTU = periphery.ModbusRTU
+
+-- Constructor
+modbus = ModbusRTU(serial <Serial object>)
+modbus = ModbusRTU{serial=<Serial object>, timeout_ms=1000, retries=0}
+
+-- Methods
+modbus:read_holding_registers(slave <number>, address <number>, count <number>) --> <table>
+modbus:read_input_registers(slave <number>, address <number>, count <number>) --> <table>
+modbus:write_single_register(slave <number>, address <number>, value <number>)
+modbus:write_multiple_registers(slave <number>, address <number>, values <table>)
+modbus:read_holding_registers_batch(requests <table>) --> <table>, <table>
+modbus:close()
+
+-- Properties
+modbus.timeout_ms   mutable <number>
+modbus.retries      mutable <number>
+modbus.serial       immutable <Serial object>
+*/
+
+enum modbus_error_code {
+    MODBUS_ERROR_ARG        = -1, /* Invalid arguments */
+    MODBUS_ERROR_IO         = -2, /* Serial port I/O */
+    MODBUS_ERROR_TIMEOUT    = -3, /* Response timeout */
+    MODBUS_ERROR_CRC        = -4, /* Response CRC mismatch */
+    MODBUS_ERROR_RESPONSE   = -5, /* Malformed response */
+    MODBUS_ERROR_EXCEPTION  = -6, /* Exception response */
+};
+
+static const char *modbus_error_code_strings[] = {
+    [-MODBUS_ERROR_ARG]         = "MODBUS_ERROR_ARG",
+    [-MODBUS_ERROR_IO]          = "MODBUS_ERROR_IO",
+    [-MODBUS_ERROR_TIMEOUT]     = "MODBUS_ERROR_TIMEOUT",
+    [-MODBUS_ERROR_CRC]         = "MODBUS_ERROR_CRC",
+    [-MODBUS_ERROR_RESPONSE]    = "MODBUS_ERROR_RESPONSE",
+    [-MODBUS_ERROR_EXCEPTION]   = "MODBUS_ERROR_EXCEPTION",
+};
+
+#define MODBUS_FC_READ_HOLDING_REGISTERS    0x03
+#define MODBUS_FC_READ_INPUT_REGISTERS      0x04
+#define MODBUS_FC_WRITE_SINGLE_REGISTER     0x06
+#define MODBUS_FC_WRITE_MULTIPLE_REGISTERS  0x10
+
+#define MODBUS_MAX_READ_REGISTERS           125
+#define MODBUS_MAX_WRITE_REGISTERS          123
+#define MODBUS_MAX_ADU_LEN                  256
+#define MODBUS_MAX_RETRIES                  100
+
+/* ModbusRTU userdata */
+typedef struct lua_modbus {
+    /* Serial port of the Serial object referenced by serial_ref, or NULL
+     * when closed */
+    serial_t *serial;
+    int serial_ref;
+
+    int timeout_ms;
+    unsigned int retries;
+
+    /* Inter-frame gap (t3.5) and end of the last frame on the bus */
+    uint64_t frame_gap_ns;
+    uint64_t last_frame_ns;
+
+    /* Error of the last transaction */
+    int c_errno;
+    char errmsg[96];
+} lua_modbus_t;
+
+static const uint16_t modbus_crc16_table[256] = {
+    0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241,
+    0xc601, 0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440,
+    0xcc01, 0x0cc0, 0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40,
+    0x0a00, 0xcac1, 0xcb81, 0x0b40, 0xc901, 0x09c0, 0x0880, 0xc841,
+    0xd801, 0x18c0, 0x1980, 0xd941, 0x1b00, 0xdbc1, 0xda81, 0x1a40,
+    0x1e00, 0xdec1, 0xdf81, 0x1f40, 0xdd01, 0x1dc0, 0x1c80, 0xdc41,
+    0x1400, 0xd4c1, 0xd581, 0x1540, 0xd701, 0x17c0, 0x1680, 0xd641,
+    0xd201, 0x12c0, 0x1380, 0xd341, 0x1100, 0xd1c1, 0xd081, 0x1040,
+    0xf001, 0x30c0, 0x3180, 0xf141, 0x3300, 0xf3c1, 0xf281, 0x3240,
+    0x3600, 0xf6c1, 0xf781, 0x3740, 0xf501, 0x35c0, 0x3480, 0xf441,
+    0x3c00, 0xfcc1, 0xfd81, 0x3d40, 0xff01, 0x3fc0, 0x3e80, 0xfe41,
+    0xfa01, 0x3ac0, 0x3b80, 0xfb41, 0x3900, 0xf9c1, 0xf881, 0x3840,
+    0x2800, 0xe8c1, 0xe981, 0x2940, 0xeb01, 0x2bc0, 0x2a80, 0xea41,
+    0xee01, 0x2ec0, 0x2f80, 0xef41, 0x2d00, 0xedc1, 0xec81, 0x2c40,
+    0xe401, 0x24c0, 0x2580, 0xe541, 0x2700, 0xe7c1, 0xe681, 0x2640,
+    0x2200, 0xe2c1, 0xe381, 0x2340, 0xe101, 0x21c0, 0x2080, 0xe041,
+    0xa001, 0x60c0, 0x6180, 0xa141, 0x6300, 0xa3c1, 0xa281, 0x6240,
+    0x6600, 0xa6c1, 0xa781, 0x6740, 0xa501, 0x65c0, 0x6480, 0xa441,
+    0x6c00, 0xacc1, 0xad81, 0x6d40, 0xaf01, 0x6fc0, 0x6e80, 0xae41,
+    0xaa01, 0x6ac0, 0x6b80, 0xab41, 0x6900, 0xa9c1, 0xa881, 0x6840,
+    0x7800, 0xb8c1, 0xb981, 0x7940, 0xbb01, 0x7bc0, 0x7a80, 0xba41,
+    0xbe01, 0x7ec0, 0x7f80, 0xbf41, 0x7d00, 0xbdc1, 0xbc81, 0x7c40,
+    0xb401, 0x74c0, 0x7580, 0xb541, 0x7700, 0xb7c1, 0xb681, 0x7640,
+    0x7200, 0xb2c1, 0xb381, 0x7340, 0xb101, 0x71c0, 0x7080, 0xb041,
+    0x5000, 0x90c1, 0x9181, 0x5140, 0x9301, 0x53c0, 0x5280, 0x9241,
+    0x9601, 0x56c0, 0x5780, 0x9741, 0x5500, 0x95c1, 0x9481, 0x5440,
+    0x9c01, 0x5cc0, 0x5d80, 0x9d41, 0x5f00, 0x9fc1, 0x9e81, 0x5e40,
+    0x5a00, 0x9ac1, 0x9b81, 0x5b40, 0x9901, 0x59c0, 0x5880, 0x9841,
+    0x8801, 0x48c0, 0x4980, 0x8941, 0x4b00, 0x8bc1, 0x8a81, 0x4a40,
+    0x4e00, 0x8ec1, 0x8f81, 0x4f40, 0x8d01, 0x4dc0, 0x4c80, 0x8c41,
+    0x4400, 0x84c1, 0x8581, 0x4540, 0x8701, 0x47c0, 0x4680, 0x8641,
+    0x8201, 0x42c0, 0x4380, 0x8341, 0x4100, 0x81c1, 0x8081, 0x4040,
+};
+
+static void lua_modbus_push_error(lua_State *L, enum modbus_error_code code, int c_errno, const char *fmt, ...) {
+    char message[128];
+    va_list ap;
+
+    va_start(ap, fmt);
+
+    /* Create error table */
+    lua_newtable(L);
+    /* .code string */
+    lua_pushstring(L, modbus_error_code_strings[-code]);
+    lua_setfield(L, -2, "code");
+    /* .c_errno number */
+    lua_pushinteger(L, c_errno);
+    lua_setfield(L, -2, "c_errno");
+    /* .message string */
+    vsnprintf(message, sizeof(message), fmt, ap);
+    lua_pushstring(L, message);
+    lua_setfield(L, -2, "message");
+
+    va_end(ap);
+
+    /* Set error metatable on it */
+    luaL_getmetatable(L, "periphery.error");
+    lua_setmetatable(L, -2);
+}
+
+static int lua_modbus_error(lua_State *L, enum modbus_error_code code, int c_errno, const char *fmt, ...) {
+    char message[128];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(message, sizeof(message), fmt, ap);
+    va_end(ap);
+
+    lua_modbus_push_error(L, code, c_errno, "%s", message);
+
+    return lua_error(L);
+}
+
+static void lua_modbus_checktype(lua_State *L, int index, int type) {
+    if (lua_type(L, index) != type)
+        lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid argument #%d (%s expected, got %s)", index, lua_typename(L, type), lua_typename(L, lua_type(L, index)));
+}
+
+static lua_modbus_t *lua_modbus_checkopen(lua_State *L, int index) {
+    lua_modbus_t *modbus = luaL_checkudata(L, index, "periphery.ModbusRTU");
+
+    if (modbus->serial == NULL)
+        lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: ModbusRTU is closed");
+
+    return modbus;
+}
+
+static unsigned int lua_modbus_checkretries(lua_State *L, int index) {
+    lua_Number retries = lua_tonumber(L, index);
+
+    if (!(retries >= 0 && retries <= MODBUS_MAX_RETRIES))
+        lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid retries, should be between 0 and %d", MODBUS_MAX_RETRIES);
+
+    return (unsigned int)retries;
+}
+
+static bool lua_modbus_isserial(lua_State *L, int index) {
+    bool ret;
+
+    if (!lua_isuserdata(L, index) || !lua_getmetatable(L, index))
+        return false;
+
+    luaL_getmetatable(L, "periphery.Serial");
+    ret = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);
+
+    return ret;
+}
+
+static uint16_t lua_modbus_crc16(const uint8_t *buf, size_t len) {
+    uint16_t crc = 0xffff;
+
+    while (len--)
+        crc = (crc >> 8) ^ modbus_crc16_table[(crc ^ *buf++) & 0xff];
+
+    return crc;
+}
+
+static uint64_t lua_modbus_monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int lua_modbus_transact_error(lua_modbus_t *modbus, int code, int c_errno, const char *fmt, ...) {
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(modbus->errmsg, sizeof(modbus->errmsg), fmt, ap);
+    va_end(ap);
+
+    modbus->c_errno = c_errno;
+
+    return code;
+}
+
+/* Compute the inter-frame gap from the current serial port settings */
+static int lua_modbus_update_timing(lua_modbus_t *modbus) {
+    uint32_t baudrate;
+    unsigned int databits, stopbits;
+    serial_parity_t parity;
+    unsigned int char_bits;
+
+    if (serial_get_databits(modbus->serial, &databits) < 0 ||
+            serial_get_parity(modbus->serial, &parity) < 0 ||
+            serial_get_stopbits(modbus->serial, &stopbits) < 0)
+        return lua_modbus_transact_error(modbus, MODBUS_ERROR_IO, serial_errno(modbus->serial), "Error: %s", serial_errmsg(modbus->serial));
+
+#if defined(TCGETS2) && defined(BOTHER)
+    struct termios2 termios2_settings;
+
+    /* Output speed in effect, including arbitrary baudrates */
+    if (ioctl(serial_fd(modbus->serial), TCGETS2, &termios2_settings) < 0)
+        return lua_modbus_transact_error(modbus, MODBUS_ERROR_IO, errno, "Error: querying baudrate: %s [errno %d]", strerror(errno), errno);
+
+    baudrate = termios2_settings.c_ospeed;
+#else
+    if (serial_get_baudrate(modbus->serial, &baudrate) < 0)
+        return lua_modbus_transact_error(modbus, MODBUS_ERROR_IO, serial_errno(modbus->serial), "Error: %s", serial_errmsg(modbus->serial));
+#endif
+
+    /* Start bit, data bits, parity bit, stop bits */
+    char_bits = 1 + databits + ((parity != PARITY_NONE) ? 1 : 0) + stopbits;
+
+    /* t3.5 is 3.5 character times, fixed at 1750 us above 19200 baud */
+    if (baudrate == 0 || baudrate > 19200)
+        modbus->frame_gap_ns = 1750000;
+    else
+        modbus->frame_gap_ns = (uint64_t)char_bits * 3500000000ULL / baudrate;
+
+    return 0;
+}
+
+/* Wait out the inter-frame gap after the last frame on the bus */
+static void lua_modbus_wait_frame_gap(lua_modbus_t *modbus) {
+    uint64_t deadline_ns = modbus->last_frame_ns + modbus->frame_gap_ns;
+    struct timespec ts;
+
+    if (lua_modbus_monotonic_ns() >= deadline_ns)
+        return;
+
+    ts.tv_sec = deadline_ns / 1000000000;
+    ts.tv_nsec = deadline_ns % 1000000000;
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/* Send a request PDU to a slave and receive the response ADU, which is
+ * expected to be response_len bytes long without exceptions */
+static int lua_modbus_transact_once(lua_State *L, lua_modbus_t *modbus, uint8_t slave, const uint8_t *pdu, size_t pdu_len, uint8_t *response, size_t response_len) {
+    uint8_t request[MODBUS_MAX_ADU_LEN];
+    size_t request_len;
+    uint64_t deadline_ns;
+    uint16_t crc;
+    size_t received;
+    int ret;
+
+    /* Build ADU */
+    request[0] = slave;
+    memcpy(request + 1, pdu, pdu_len);
+    crc = lua_modbus_crc16(request, 1 + pdu_len);
+    request[1 + pdu_len] = crc & 0xff;
+    request[2 + pdu_len] = crc >> 8;
+    request_len = 3 + pdu_len;
+
+    lua_modbus_wait_frame_gap(modbus);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, modbus->serial_ref);
+
+    /* Discard stale input, e.g. a late response to a timed out request, also
+     * from the receive buffer of the Serial object */
+    if ((ret = lua_periphery_serial_discard(L, -1, &modbus->c_errno, modbus->errmsg, sizeof(modbus->errmsg))) == 0)
+        /* Transmit the request through the Serial object, which drives the
+         * RS-485 driver enable in GPIO-assisted RS-485 mode */
+        ret = lua_periphery_serial_transmit(L, -1, request, request_len, &modbus->c_errno, modbus->errmsg, sizeof(modbus->errmsg));
+
+    lua_pop(L, 1);
+
+    if (ret < 0)
+        return MODBUS_ERROR_IO;
+
+    modbus->last_frame_ns = lua_modbus_monotonic_ns();
+
+    /* No response to broadcast requests */
+    if (slave == 0)
+        return 0;
+
+    deadline_ns = modbus->last_frame_ns + (uint64_t)modbus->timeout_ms * 1000000;
+
+    /* Receive the length of an exception response first, which is the
+     * shortest response */
+    received = 0;
+    while (received < response_len) {
+        size_t expected = (received < 5) ? 5 : response_len;
+        uint64_t now_ns = lua_modbus_monotonic_ns();
+        int timeout_ms = (now_ns < deadline_ns) ? (int)((deadline_ns - now_ns + 999999) / 1000000) : 0;
+
+        if ((ret = serial_read(modbus->serial, response + received, expected - received, timeout_ms)) < 0)
+            return lua_modbus_transact_error(modbus, MODBUS_ERROR_IO, serial_errno(modbus->serial), "Error: %s", serial_errmsg(modbus->serial));
+
+        received += ret;
+
+        if (ret == 0 || (timeout_ms == 0 && received < expected)) {
+            modbus->last_frame_ns = lua_modbus_monotonic_ns();
+            return lua_modbus_transact_error(modbus, MODBUS_ERROR_TIMEOUT, 0, "Error: response timeout from slave %u", slave);
+        }
+
+        /* Exception response */
+        if (received == 5 && response[1] == (pdu[0] | 0x80))
+            break;
+    }
+
+    modbus->last_frame_ns = lua_modbus_monotonic_ns();
+
+    crc = lua_modbus_crc16(response, received - 2);
+    if (response[received - 2] != (crc & 0xff) || response[received - 1] != (crc >> 8))
+        return lua_modbus_transact_error(modbus, MODBUS_ERROR_CRC, 0, "Error: response CRC mismatch from slave %u", slave);
+
+    if (response[0] != slave)
+        return lua_modbus_transact_error(modbus, MODBUS_ERROR_RESPONSE, 0, "Error: response from unexpected slave %u", response[0]);
+
+    if (response[1] == (pdu[0] | 0x80))
+        return lua_modbus_transact_error(modbus, MODBUS_ERROR_EXCEPTION, response[2], "Error: slave %u exception code %u", slave, response[2]);
+    else if (response[1] != pdu[0])
+        return lua_modbus_transact_error(modbus, MODBUS_ERROR_RESPONSE, 0, "Error: unexpected function code %u from slave %u", response[1], slave);
+
+    return 0;
+}
+
+static int lua_modbus_transact(lua_State *L, lua_modbus_t *modbus, uint8_t slave, const uint8_t *pdu, size_t pdu_len, uint8_t *response, size_t response_len) {
+    unsigned int attempt;
+    int ret = 0;
+
+    /* Retry on timeout and corrupted responses */
+    for (attempt = 0; attempt <= modbus->retries; attempt++) {
+        ret = lua_modbus_transact_once(L, modbus, slave, pdu, pdu_len, response, response_len);
+        if (ret != MODBUS_ERROR_TIMEOUT && ret != MODBUS_ERROR_CRC)
+            break;
+    }
+
+    return ret;
+}
+
+static int lua_modbus_read_registers_raw(lua_State *L, lua_modbus_t *modbus, uint8_t function, uint8_t slave, uint16_t address, uint16_t count, uint16_t *values) {
+    uint8_t pdu[5];
+    uint8_t response[MODBUS_MAX_ADU_LEN];
+    unsigned int i;
+    int ret;
+
+    pdu[0] = function;
+    pdu[1] = address >> 8;
+    pdu[2] = address & 0xff;
+    pdu[3] = count >> 8;
+    pdu[4] = count & 0xff;
+
+    if ((ret = lua_modbus_transact(L, modbus, slave, pdu, sizeof(pdu), response, 5 + 2*count)) < 0)
+        return ret;
+
+    if (response[2] != 2*count)
+        return lua_modbus_transact_error(modbus, MODBUS_ERROR_RESPONSE, 0, "Error: unexpected byte count %u from slave %u", response[2], slave);
+
+    for (i = 0; i < count; i++)
+        values[i] = ((uint16_t)response[3 + 2*i] << 8) | response[4 + 2*i];
+
+    return 0;
+}
+
+static void lua_modbus_check_address(lua_State *L, int index, unsigned int *slave, unsigned int *address) {
+    lua_modbus_checktype(L, index, LUA_TNUMBER);
+    lua_modbus_checktype(L, index+1, LUA_TNUMBER);
+
+    *slave = lua_tounsigned(L, index);
+    *address = lua_tounsigned(L, index+1);
+
+    if (*slave > 247)
+        lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid slave address, should be between 0 and 247");
+    if (*address > 0xffff)
+        lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid register address, should be between 0 and 65535");
+}
+
+static int lua_modbus_read_registers(lua_State *L, uint8_t function) {
+    lua_modbus_t *modbus;
+    unsigned int slave, address, count;
+    uint16_t values[MODBUS_MAX_READ_REGISTERS];
+    unsigned int i;
+    int ret;
+
+    modbus = lua_modbus_checkopen(L, 1);
+    lua_modbus_check_address(L, 2, &slave, &address);
+    lua_modbus_checktype(L, 4, LUA_TNUMBER);
+
+    count = lua_tounsigned(L, 4);
+
+    if (slave == 0)
+        return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid slave address, reads cannot be broadcast");
+    if (count == 0 || count > MODBUS_MAX_READ_REGISTERS)
+        return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid register count, should be between 1 and %u", MODBUS_MAX_READ_REGISTERS);
+
+    if ((ret = lua_modbus_update_timing(modbus)) < 0 ||
+            (ret = lua_modbus_read_registers_raw(L, modbus, function, slave, address, count, values)) < 0)
+        return lua_modbus_error(L, ret, modbus->c_errno, "%s", modbus->errmsg);
+
+    lua_createtable(L, count, 0);
+    for (i = 0; i < count; i++) {
+        lua_pushinteger(L, values[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+
+    return 1;
+}
+
+static int lua_modbus_read_holding_registers(lua_State *L) {
+    return lua_modbus_read_registers(L, MODBUS_FC_READ_HOLDING_REGISTERS);
+}
+
+static int lua_modbus_read_input_registers(lua_State *L) {
+    return lua_modbus_read_registers(L, MODBUS_FC_READ_INPUT_REGISTERS);
+}
+
+static int lua_modbus_write_single_register(lua_State *L) {
+    lua_modbus_t *modbus;
+    unsigned int slave, address, value;
+    uint8_t pdu[5];
+    uint8_t response[8];
+    int ret;
+
+    modbus = lua_modbus_checkopen(L, 1);
+    lua_modbus_check_address(L, 2, &slave, &address);
+    lua_modbus_checktype(L, 4, LUA_TNUMBER);
+
+    value = lua_tounsigned(L, 4);
+    if (value > 0xffff)
+        return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid register value, should be between 0 and 65535");
+
+    pdu[0] = MODBUS_FC_WRITE_SINGLE_REGISTER;
+    pdu[1] = address >> 8;
+    pdu[2] = address & 0xff;
+    pdu[3] = value >> 8;
+    pdu[4] = value & 0xff;
+
+    /* Response echoes the request */
+    if ((ret = lua_modbus_update_timing(modbus)) < 0 ||
+            (ret = lua_modbus_transact(L, modbus, slave, pdu, sizeof(pdu), response, sizeof(response))) < 0)
+        return lua_modbus_error(L, ret, modbus->c_errno, "%s", modbus->errmsg);
+
+    return 0;
+}
+
+static int lua_modbus_write_multiple_registers(lua_State *L) {
+    lua_modbus_t *modbus;
+    unsigned int slave, address, count;
+    uint8_t pdu[6 + 2*MODBUS_MAX_WRITE_REGISTERS];
+    uint8_t response[8];
+    unsigned int i;
+    int ret;
+
+    modbus = lua_modbus_checkopen(L, 1);
+    lua_modbus_check_address(L, 2, &slave, &address);
+    lua_modbus_checktype(L, 4, LUA_TTABLE);
+
+    count = luaL_len(L, 4);
+    if (count == 0 || count > MODBUS_MAX_WRITE_REGISTERS)
+        return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid register count, should be between 1 and %u", MODBUS_MAX_WRITE_REGISTERS);
+
+    pdu[0] = MODBUS_FC_WRITE_MULTIPLE_REGISTERS;
+    pdu[1] = address >> 8;
+    pdu[2] = address & 0xff;
+    pdu[3] = count >> 8;
+    pdu[4] = count & 0xff;
+    pdu[5] = 2*count;
+
+    for (i = 0; i < count; i++) {
+        unsigned int value;
+
+        lua_pushunsigned(L, i+1);
+        lua_gettable(L, 4);
+        if (!lua_isnumber(L, -1))
+            return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid element index %d in values table (number expected, got %s)", i+1, lua_typename(L, lua_type(L, -1)));
+
+        value = lua_tounsigned(L, -1);
+        if (value > 0xffff)
+            return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid register value at index %d, should be between 0 and 65535", i+1);
+
+        pdu[6 + 2*i] = value >> 8;
+        pdu[7 + 2*i] = value & 0xff;
+
+        lua_pop(L, 1);
+    }
+
+    if ((ret = lua_modbus_update_timing(modbus)) < 0 ||
+            (ret = lua_modbus_transact(L, modbus, slave, pdu, 6 + 2*count, response, sizeof(response))) < 0)
+        return lua_modbus_error(L, ret, modbus->c_errno, "%s", modbus->errmsg);
+
+    return 0;
+}
+
+static int lua_modbus_read_holding_registers_batch(lua_State *L) {
+    lua_modbus_t *modbus;
+    unsigned int num_requests;
+    unsigned int i, j;
+    int ret;
+
+    modbus = lua_modbus_checkopen(L, 1);
+    lua_modbus_checktype(L, 2, LUA_TTABLE);
+
+    num_requests = luaL_len(L, 2);
+
+    /* Validate all requests before starting the batch */
+    for (i = 0; i < num_requests; i++) {
+        const char *fields[] = {"slave", "address", "count"};
+
+        lua_pushunsigned(L, i+1);
+        lua_gettable(L, 2);
+        if (!lua_istable(L, -1))
+            return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid element index %d in requests table (table expected, got %s)", i+1, lua_typename(L, lua_type(L, -1)));
+
+        for (j = 0; j < 3; j++) {
+            lua_getfield(L, -1, fields[j]);
+            if (!lua_isnumber(L, -1))
+                return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid type of field '%s' in request index %d, should be number", fields[j], i+1);
+            lua_pop(L, 1);
+        }
+
+        lua_pop(L, 1);
+    }
+
+    if ((ret = lua_modbus_update_timing(modbus)) < 0)
+        return lua_modbus_error(L, ret, modbus->c_errno, "%s", modbus->errmsg);
+
+    /* Results and errors tables */
+    lua_createtable(L, num_requests, 0);
+    lua_newtable(L);
+
+    /* Issue requests back-to-back, separated only by the inter-frame gap */
+    for (i = 0; i < num_requests; i++) {
+        unsigned int slave, address, count;
+        uint16_t values[MODBUS_MAX_READ_REGISTERS];
+
+        lua_pushunsigned(L, i+1);
+        lua_gettable(L, 2);
+        lua_getfield(L, -1, "slave");
+        lua_getfield(L, -2, "address");
+        lua_getfield(L, -3, "count");
+        slave = lua_tounsigned(L, -3);
+        address = lua_tounsigned(L, -2);
+        count = lua_tounsigned(L, -1);
+        lua_pop(L, 4);
+
+        if (slave == 0 || slave > 247 || address > 0xffff || count == 0 || count > MODBUS_MAX_READ_REGISTERS) {
+            lua_modbus_transact_error(modbus, MODBUS_ERROR_ARG, 0, "Error: invalid slave, address, or count in request index %d", i+1);
+            ret = MODBUS_ERROR_ARG;
+        } else {
+            ret = lua_modbus_read_registers_raw(L, modbus, MODBUS_FC_READ_HOLDING_REGISTERS, slave, address, count, values);
+        }
+
+        if (ret < 0) {
+            /* results[i] = false, errors[i] = error object */
+            lua_pushboolean(L, false);
+            lua_rawseti(L, -3, i + 1);
+            lua_modbus_push_error(L, ret, modbus->c_errno, "%s", modbus->errmsg);
+            lua_rawseti(L, -2, i + 1);
+            continue;
+        }
+
+        lua_createtable(L, count, 0);
+        for (j = 0; j < count; j++) {
+            lua_pushinteger(L, values[j]);
+            lua_rawseti(L, -2, j + 1);
+        }
+        lua_rawseti(L, -3, i + 1);
+    }
+
+    return 2;
+}
+
+static int lua_modbus_new(lua_State *L) {
+    lua_modbus_t *modbus;
+    int timeout_ms = 1000;
+    unsigned int retries = 0;
+
+    /* Remove self table object */
+    lua_remove(L, 1);
+
+    /* Arguments passed in table form */
+    if (lua_istable(L, 1)) {
+        lua_getfield(L, 1, "serial");
+        if (!lua_modbus_isserial(L, 2))
+            return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid type on table argument 'serial', should be Serial object");
+
+        /* Optional timeout_ms */
+        lua_getfield(L, 1, "timeout_ms");
+        if (lua_isnumber(L, -1))
+            timeout_ms = lua_tointeger(L, -1);
+        else if (!lua_isnil(L, -1))
+            return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid type of table argument 'timeout_ms', should be number");
+        lua_pop(L, 1);
+
+        /* Optional retries */
+        lua_getfield(L, 1, "retries");
+        if (lua_isnumber(L, -1))
+            retries = lua_modbus_checkretries(L, -1);
+        else if (!lua_isnil(L, -1))
+            return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid type of table argument 'retries', should be number");
+        lua_pop(L, 1);
+
+        /* Leave Serial object at index 2 */
+        lua_settop(L, 2);
+    /* Arguments passed normally */
+    } else {
+        if (!lua_modbus_isserial(L, 1))
+            return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid argument #1 (Serial object expected, got %s)", lua_typename(L, lua_type(L, 1)));
+
+        lua_settop(L, 1);
+        lua_pushvalue(L, 1);
+    }
+
+    if (timeout_ms < 0)
+        return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid timeout, should be non-negative");
+
+    /* Create handle userdata */
+    modbus = lua_newuserdata(L, sizeof(lua_modbus_t));
+    memset(modbus, 0, sizeof(lua_modbus_t));
+    modbus->serial = *((serial_t **)lua_touserdata(L, 2));
+    modbus->timeout_ms = timeout_ms;
+    modbus->retries = retries;
+    /* Set ModbusRTU metatable on it */
+    luaL_getmetatable(L, "periphery.ModbusRTU");
+    lua_setmetatable(L, -2);
+
+    /* Reference Serial object, to keep it alive */
+    lua_pushvalue(L, 2);
+    modbus->serial_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    return 1;
+}
+
+static int lua_modbus_close(lua_State *L) {
+    lua_modbus_t *modbus = luaL_checkudata(L, 1, "periphery.ModbusRTU");
+
+    if (modbus->serial == NULL)
+        return 0;
+
+    luaL_unref(L, LUA_REGISTRYINDEX, modbus->serial_ref);
+    modbus->serial_ref = LUA_NOREF;
+    modbus->serial = NULL;
+
+    return 0;
+}
+
+static int lua_modbus_tostring(lua_State *L) {
+    lua_modbus_t *modbus = luaL_checkudata(L, 1, "periphery.ModbusRTU");
+
+    if (modbus->serial == NULL)
+        lua_pushstring(L, "ModbusRTU (closed)");
+    else
+        lua_pushfstring(L, "ModbusRTU (fd=%d, timeout_ms=%d, retries=%d)", serial_fd(modbus->serial), modbus->timeout_ms, (int)modbus->retries);
+
+    return 1;
+}
+
+static int lua_modbus_index(lua_State *L) {
+    lua_modbus_t *modbus;
+    const char *field;
+
+    if (!lua_isstring(L, 2))
+        return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: unknown method or property");
+
+    field = lua_tostring(L, 2);
+
+    /* Look up method in metatable */
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, field);
+    if (!lua_isnil(L, -1))
+        return 1;
+
+    modbus = luaL_checkudata(L, 1, "periphery.ModbusRTU");
+
+    if (strcmp(field, "timeout_ms") == 0) {
+        lua_pushinteger(L, modbus->timeout_ms);
+        return 1;
+    } else if (strcmp(field, "retries") == 0) {
+        lua_pushunsigned(L, modbus->retries);
+        return 1;
+    } else if (strcmp(field, "serial") == 0) {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, modbus->serial_ref);
+        return 1;
+    }
+
+    return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static int lua_modbus_newindex(lua_State *L) {
+    lua_modbus_t *modbus;
+    const char *field;
+
+    modbus = luaL_checkudata(L, 1, "periphery.ModbusRTU");
+
+    if (!lua_isstring(L, 2))
+        return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: unknown property");
+
+    field = lua_tostring(L, 2);
+
+    if (strcmp(field, "serial") == 0) {
+        return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: immutable property");
+    } else if (strcmp(field, "timeout_ms") == 0) {
+        lua_modbus_checktype(L, 3, LUA_TNUMBER);
+        if (lua_tointeger(L, 3) < 0)
+            return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: invalid timeout, should be non-negative");
+
+        modbus->timeout_ms = lua_tointeger(L, 3);
+        return 0;
+    } else if (strcmp(field, "retries") == 0) {
+        lua_modbus_checktype(L, 3, LUA_TNUMBER);
+
+        modbus->retries = lua_modbus_checkretries(L, 3);
+        return 0;
+    }
+
+    return lua_modbus_error(L, MODBUS_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static const struct luaL_Reg periphery_modbus_m[] = {
+    {"close", lua_modbus_close},
+    {"read_holding_registers", lua_modbus_read_holding_registers},
+    {"read_input_registers", lua_modbus_read_input_registers},
+    {"write_single_register", lua_modbus_write_single_register},
+    {"write_multiple_registers", lua_modbus_write_multiple_registers},
+    {"read_holding_registers_batch", lua_modbus_read_holding_registers_batch},
+    {"__gc", lua_modbus_close},
+    {"__tostring", lua_modbus_tostring},
+    {"__index", lua_modbus_index},
+    {"__newindex", lua_modbus_newindex},
+    {NULL, NULL}
+};
+
+LUALIB_API int luaopen_periphery_modbus(lua_State *L) {
+    /* Create periphery.ModbusRTU metatable */
+    luaL_newmetatable(L, "periphery.ModbusRTU");
+    /* Set metatable functions */
+    const struct luaL_Reg *funcs = (const struct luaL_Reg *)periphery_modbus_m;
+    for (; funcs->name != NULL; funcs++) {
+        lua_pushcclosure(L, funcs->func, 0);
+        lua_setfield(L, -2, funcs->name);
+    }
+    /* Set metatable properties */
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+
+    /* Create {__call = lua_modbus_new, __metatable = "protected metatable"} table */
+    lua_newtable(L);
+    lua_pushcclosure(L, lua_modbus_new, 0);
+    lua_setfield(L, -2, "__call");
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+    /* Set it as the metatable for the periphery.ModbusRTU metatable */
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
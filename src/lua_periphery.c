@@ -8,6 +8,8 @@
 #include <lualib.h>
 #include <lauxlib.h>
 
+#include <stdint.h>
+#include <errno.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -21,6 +23,10 @@ LUALIB_API int luaopen_periphery_spi(lua_State *L);
 LUALIB_API int luaopen_periphery_mmio(lua_State *L);
 LUALIB_API int luaopen_periphery_i2c(lua_State *L);
 LUALIB_API int luaopen_periphery_serial(lua_State *L);
+LUALIB_API int luaopen_periphery_modbus(lua_State *L);
+LUALIB_API int luaopen_periphery_poller(lua_State *L);
+LUALIB_API int luaopen_periphery_timer(lua_State *L);
+LUALIB_API int luaopen_periphery_loop(lua_State *L);
 
 static int periphery_error_tostring(lua_State *L) {
     lua_getfield(L, -1, "message");
@@ -63,6 +69,76 @@ static int periphery_sleep_us(lua_State *L) {
     return 0;
 }
 
+static const char *const periphery_clock_names[] = {"monotonic", "realtime", "boottime", NULL};
+static const clockid_t periphery_clock_ids[] = {CLOCK_MONOTONIC, CLOCK_REALTIME, CLOCK_BOOTTIME};
+
+static int64_t periphery_timespec_to_ns(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static int64_t periphery_checkns(lua_State *L, int index) {
+#if LUA_VERSION_NUM >= 503
+    /* Nanosecond timestamps of the realtime clock exceed the integer
+     * precision of floats */
+    if (lua_isinteger(L, index))
+        return lua_tointeger(L, index);
+#endif
+    return (int64_t)luaL_checknumber(L, index);
+}
+
+static void periphery_pushns(lua_State *L, int64_t ns) {
+#if LUA_VERSION_NUM >= 503
+    lua_pushinteger(L, (lua_Integer)ns);
+#else
+    lua_pushnumber(L, (lua_Number)ns);
+#endif
+}
+
+static int periphery_clock_ns(lua_State *L) {
+    clockid_t clock;
+    struct timespec ts;
+
+    clock = periphery_clock_ids[luaL_checkoption(L, 1, "monotonic", periphery_clock_names)];
+
+    clock_gettime(clock, &ts);
+
+    periphery_pushns(L, periphery_timespec_to_ns(&ts));
+
+    return 1;
+}
+
+static int periphery_sleep_until_ns(lua_State *L) {
+    int64_t deadline_ns, spin_ns;
+    clockid_t clock;
+    struct timespec ts;
+
+    deadline_ns = periphery_checkns(L, 1);
+    clock = periphery_clock_ids[luaL_checkoption(L, 2, "monotonic", periphery_clock_names)];
+    spin_ns = (int64_t)(luaL_optnumber(L, 3, 0) * 1000);
+
+    if (spin_ns < 0)
+        return luaL_argerror(L, 3, "should be non-negative");
+
+    /* Sleep until the spin window before the deadline, restarting on
+     * signals, as the deadline is absolute */
+    if (deadline_ns - spin_ns > 0) {
+        ts.tv_sec = (deadline_ns - spin_ns) / 1000000000;
+        ts.tv_nsec = (deadline_ns - spin_ns) % 1000000000;
+        while (clock_nanosleep(clock, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+    }
+
+    /* Spin on the clock for the rest of the window, to avoid the wakeup
+     * latency of the scheduler */
+    if (spin_ns > 0) {
+        do {
+            clock_gettime(clock, &ts);
+        } while (periphery_timespec_to_ns(&ts) < deadline_ns);
+    }
+
+    return 0;
+}
+
 LUALIB_API int luaopen_periphery(lua_State *L) {
     /* Create error metatable with __tostring */
     luaL_newmetatable(L, "periphery.error");
@@ -91,9 +167,21 @@ LUALIB_API int luaopen_periphery(lua_State *L) {
     luaopen_periphery_serial(L);
     lua_setfield(L, -2, "Serial");
 
+    luaopen_periphery_modbus(L);
+    lua_setfield(L, -2, "ModbusRTU");
+
     luaopen_periphery_mmio(L);
     lua_setfield(L, -2, "MMIO");
 
+    luaopen_periphery_poller(L);
+    lua_setfield(L, -2, "Poller");
+
+    luaopen_periphery_timer(L);
+    lua_setfield(L, -2, "Timer");
+
+    luaopen_periphery_loop(L);
+    lua_setfield(L, -2, "loop");
+
     lua_pushstring(L, LUA_PERIPHERY_VERSION);
     lua_setfield(L, -2, "version");
 
@@ -103,6 +191,10 @@ LUALIB_API int luaopen_periphery(lua_State *L) {
     lua_setfield(L, -2, "sleep_ms");
     lua_pushcclosure(L, periphery_sleep_us, 0);
     lua_setfield(L, -2, "sleep_us");
+    lua_pushcclosure(L, periphery_sleep_until_ns, 0);
+    lua_setfield(L, -2, "sleep_until_ns");
+    lua_pushcclosure(L, periphery_clock_ns, 0);
+    lua_setfield(L, -2, "clock_ns");
 
     return 1;
 }
@@ -7,6 +7,10 @@
 #ifndef _LUA_PERIPHERY_H
 #define _LUA_PERIPHERY_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #include <c-periphery/src/version.h>
 
 #define _STRINGIFY(x)   #x
@@ -16,5 +20,68 @@
                                         STRINGIFY(PERIPHERY_VERSION_MINOR) "." \
                                         STRINGIFY(PERIPHERY_VERSION_PATCH)
 
+/* Cooperative I/O with the periphery.loop scheduler. Blocking methods called
+ * from a task of the scheduler yield with lua_periphery_loop_wait(), and are
+ * continued with k, with the same stack below the yielded values, once fd is
+ * ready for events or timeout_ms elapses. */
+bool lua_periphery_loop_can_yield(lua_State *L);
+int lua_periphery_loop_wait(lua_State *L, int fd, int events, int timeout_ms, lua_CFunction k);
+double lua_periphery_loop_deadline(int timeout_ms);
+int lua_periphery_loop_remaining(double deadline_ms);
+
+/* Handle queries for periphery.Poller. lua_periphery_gpio_events() returns
+ * the poll events signaling an edge event of the GPIO at index, or 0 if it is
+ * not a GPIO. lua_periphery_serial_buffered() returns the number of bytes held
+ * in the receive buffer of the Serial at index, which its fd does not signal,
+ * or -1 if it is not a Serial. */
+int lua_periphery_gpio_events(lua_State *L, int index);
+int lua_periphery_serial_buffered(lua_State *L, int index);
+
+/* Epoll set of handles, the shared core of periphery.Poller, GPIO.PollSet, and
+ * Serial.PollSet. Handles are registered with their fd in registry tables of
+ * fd -> handle and handle -> fd. Adding a handle evicts a closed handle whose
+ * fd was reused, and pushes the evicted handle, or nil. Waiting fills the
+ * arrays at ready_index and revents_index, unless zero, with the ready handles
+ * and their events, clears entries left from a previous wait, and returns the
+ * number of ready handles, so the arrays may be reused across waits. Serial
+ * objects holding received bytes in their receive buffer are ready for POLLIN
+ * without waiting. Functions returning int return -1 with errno set on
+ * failure, without pushing values or raising a Lua error. */
+struct epoll_event;
+
+typedef struct lua_periphery_epoll_set {
+    int epfd;
+    int fds_ref;
+    int handles_ref;
+    unsigned int count;
+    struct epoll_event *events;
+    unsigned int events_size;
+} lua_periphery_epoll_set_t;
+
+int lua_periphery_epoll_set_open(lua_State *L, lua_periphery_epoll_set_t *set);
+void lua_periphery_epoll_set_close(lua_State *L, lua_periphery_epoll_set_t *set);
+int lua_periphery_epoll_set_add(lua_State *L, lua_periphery_epoll_set_t *set, int index, int fd, uint32_t events);
+void lua_periphery_epoll_set_remove(lua_State *L, lua_periphery_epoll_set_t *set, int index);
+int lua_periphery_epoll_set_wait(lua_State *L, lua_periphery_epoll_set_t *set, int timeout_ms, int ready_index, int revents_index);
+
+/* Append the Serial objects registered in the table of handle -> fd at
+ * handles_index, which hold received bytes in their receive buffer, to the
+ * arrays of ready handles and events at ready_index and revents_index, unless
+ * zero, after their first count entries. Only Serial objects that received
+ * bytes since their receive buffer was last found empty are visited, rather
+ * than all registered handles. Returns the new length of the arrays. */
+unsigned int lua_periphery_serial_ready(lua_State *L, int handles_index, int ready_index, int revents_index, unsigned int count);
+
+/* Serial transmit for protocol modules built on periphery.Serial.
+ * lua_periphery_serial_transmit() writes len bytes of buf to the Serial at
+ * index and waits for them to be transmitted, asserting the driver enable GPIO
+ * in GPIO-assisted RS-485 mode. Returns 0 on success, or a negative Serial
+ * error code with c_errno and errmsg set, without raising a Lua error.
+ * lua_periphery_serial_discard() discards the received input of the Serial at
+ * index, both in its receive buffer and in the kernel, with the same error
+ * convention. */
+int lua_periphery_serial_transmit(lua_State *L, int index, const uint8_t *buf, size_t len, int *c_errno, char *errmsg, size_t errmsg_len);
+int lua_periphery_serial_discard(lua_State *L, int index, int *c_errno, char *errmsg, size_t errmsg_len);
+
 #endif
 
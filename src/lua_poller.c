@@ -0,0 +1,604 @@
+/*
+ * lua-periphery by vsergeev
+ * https://github.com/vsergeev/lua-periphery
+ * License: MIT
+ */
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "lua_periphery.h"
+#include "lua_compat.h"
+
+/*
+local periphery = require('periphery')
+local Poller = periphery.Poller
+
+-- Constructor
+poller = Poller([handles <table|nil>])
+
+-- Methods
+poller:add(handle <object|number>, [events <number|nil>, callback <function|nil>])
+poller:remove(handle <object|number>)
+poller:wait([timeout_ms <number|nil>]) --> <table>, <table>
+poller:close()
+
+-- Constants
+Poller.IN
+Poller.PRI
+Poller.OUT
+Poller.ERR
+Poller.HUP
+
+-- Properties
+poller.fd           immutable <number>
+poller.count        immutable <number>
+*/
+
+enum poller_error_code {
+    POLLER_ERROR_ARG        = -1, /* Invalid arguments */
+    POLLER_ERROR_OPEN       = -2, /* Creating epoll instance */
+    POLLER_ERROR_IO         = -3, /* Registering or polling handles */
+    POLLER_ERROR_ALLOC      = -4, /* Allocating memory */
+};
+
+static const char *poller_error_code_strings[] = {
+    [-POLLER_ERROR_ARG]     = "POLLER_ERROR_ARG",
+    [-POLLER_ERROR_OPEN]    = "POLLER_ERROR_OPEN",
+    [-POLLER_ERROR_IO]      = "POLLER_ERROR_IO",
+    [-POLLER_ERROR_ALLOC]   = "POLLER_ERROR_ALLOC",
+};
+
+/* Poller userdata */
+typedef struct lua_poller {
+    lua_periphery_epoll_set_t set;
+    /* Registry reference to table of handle -> callback */
+    int callbacks_ref;
+} lua_poller_t;
+
+static int lua_poller_error(lua_State *L, enum poller_error_code code, int c_errno, const char *fmt, ...) {
+    char message[128];
+    va_list ap;
+
+    va_start(ap, fmt);
+
+    /* Create error table */
+    lua_newtable(L);
+    /* .code string */
+    lua_pushstring(L, poller_error_code_strings[-code]);
+    lua_setfield(L, -2, "code");
+    /* .c_errno number */
+    lua_pushinteger(L, c_errno);
+    lua_setfield(L, -2, "c_errno");
+    /* .message string */
+    vsnprintf(message, sizeof(message), fmt, ap);
+    lua_pushstring(L, message);
+    lua_setfield(L, -2, "message");
+
+    va_end(ap);
+
+    /* Set error metatable on it */
+    luaL_getmetatable(L, "periphery.error");
+    lua_setmetatable(L, -2);
+
+    return lua_error(L);
+}
+
+static lua_poller_t *lua_poller_checkopen(lua_State *L, int index) {
+    lua_poller_t *poller = luaL_checkudata(L, index, "periphery.Poller");
+
+    if (poller->set.epfd < 0)
+        lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: poller is closed");
+
+    return poller;
+}
+
+static int lua_poller_getfd(lua_State *L) {
+    lua_getfield(L, 1, "fd");
+    return 1;
+}
+
+static int lua_poller_checkfd(lua_State *L, int index) {
+    int fd;
+
+    if (lua_type(L, index) == LUA_TNUMBER) {
+        fd = lua_tointeger(L, index);
+    } else if (lua_isuserdata(L, index) || lua_istable(L, index)) {
+        /* Look up the fd property in protected mode, as handles raise an
+         * error on unknown properties */
+        lua_pushcclosure(L, lua_poller_getfd, 0);
+        lua_pushvalue(L, index);
+        if (lua_pcall(L, 1, 1, 0) != 0 || !lua_isnumber(L, -1))
+            return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: invalid handle, should have an fd property");
+
+        fd = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+    } else {
+        return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: invalid type of argument 'handle', should be object or number");
+    }
+
+    if (fd < 0)
+        return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: invalid handle, handle is closed");
+
+    return fd;
+}
+
+/* Remove the handle at index, registered with fd, from the tables of the set,
+ * without removing fd from the epoll set */
+static void lua_periphery_epoll_set_forget(lua_State *L, lua_periphery_epoll_set_t *set, int index, int fd) {
+    lua_rawgeti(L, LUA_REGISTRYINDEX, set->handles_ref);
+    lua_pushvalue(L, index);
+    lua_pushnil(L);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, set->fds_ref);
+    lua_pushnil(L);
+    lua_rawseti(L, -2, fd);
+    lua_pop(L, 1);
+
+    set->count--;
+}
+
+int lua_periphery_epoll_set_open(lua_State *L, lua_periphery_epoll_set_t *set) {
+    set->fds_ref = LUA_NOREF;
+    set->handles_ref = LUA_NOREF;
+    set->count = 0;
+    set->events = NULL;
+    set->events_size = 0;
+
+    if ((set->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        return -1;
+
+    lua_newtable(L);
+    set->fds_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    lua_newtable(L);
+    set->handles_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    return 0;
+}
+
+void lua_periphery_epoll_set_close(lua_State *L, lua_periphery_epoll_set_t *set) {
+    if (set->epfd >= 0) {
+        close(set->epfd);
+        set->epfd = -1;
+    }
+
+    luaL_unref(L, LUA_REGISTRYINDEX, set->fds_ref);
+    luaL_unref(L, LUA_REGISTRYINDEX, set->handles_ref);
+    set->fds_ref = LUA_NOREF;
+    set->handles_ref = LUA_NOREF;
+    set->count = 0;
+
+    free(set->events);
+    set->events = NULL;
+    set->events_size = 0;
+}
+
+void lua_periphery_epoll_set_remove(lua_State *L, lua_periphery_epoll_set_t *set, int index) {
+    int fd;
+
+    /* Look up the fd the handle was registered with, as it may have since
+     * been closed */
+    lua_rawgeti(L, LUA_REGISTRYINDEX, set->handles_ref);
+    lua_pushvalue(L, index);
+    lua_rawget(L, -2);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 2);
+        return;
+    }
+
+    fd = lua_tointeger(L, -1);
+    lua_pop(L, 2);
+
+    /* The fd may already be closed, which removes it from the epoll set */
+    epoll_ctl(set->epfd, EPOLL_CTL_DEL, fd, NULL);
+
+    lua_periphery_epoll_set_forget(L, set, index, fd);
+}
+
+int lua_periphery_epoll_set_add(lua_State *L, lua_periphery_epoll_set_t *set, int index, int fd, uint32_t events) {
+    struct epoll_event event;
+    int top;
+
+    /* Absolute index, as values are pushed below */
+    if (index < 0)
+        index = lua_gettop(L) + index + 1;
+
+    /* Re-adding a handle refreshes its registration */
+    lua_periphery_epoll_set_remove(L, set, index);
+
+    /* The fd may still be registered through another handle of the same
+     * open file */
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+
+    if (epoll_ctl(set->epfd, EPOLL_CTL_ADD, fd, &event) < 0 && (errno != EEXIST || epoll_ctl(set->epfd, EPOLL_CTL_MOD, fd, &event) < 0))
+        return -1;
+
+    /* Evict a handle still registered with the same fd, which was closed and
+     * had its fd reused. Closing the fd already removed it from the epoll
+     * set, and deleting it now would remove the new registration. */
+    lua_rawgeti(L, LUA_REGISTRYINDEX, set->fds_ref);
+    lua_rawgeti(L, -1, fd);
+    top = lua_gettop(L);
+    if (!lua_isnil(L, top))
+        lua_periphery_epoll_set_forget(L, set, top, fd);
+
+    /* Stack: [..., fds, evicted] */
+    lua_pushvalue(L, index);
+    lua_rawseti(L, -3, fd);
+    lua_remove(L, -2);
+
+    lua_rawgeti(L, LUA_REGISTRYINDEX, set->handles_ref);
+    lua_pushvalue(L, index);
+    lua_pushinteger(L, fd);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    set->count++;
+
+    return 0;
+}
+
+/* Clear the entries of the array at index after its first count entries */
+static void lua_periphery_epoll_set_truncate(lua_State *L, int index, unsigned int count) {
+    while (true) {
+        lua_rawgeti(L, index, ++count);
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            return;
+        }
+        lua_pop(L, 1);
+
+        lua_pushnil(L);
+        lua_rawseti(L, index, count);
+    }
+}
+
+int lua_periphery_epoll_set_wait(lua_State *L, lua_periphery_epoll_set_t *set, int timeout_ms, int ready_index, int revents_index) {
+    unsigned int j;
+    int base;
+    int ret;
+
+    /* Absolute indices, as values are pushed below */
+    if (ready_index < 0)
+        ready_index = lua_gettop(L) + ready_index + 1;
+    if (revents_index < 0)
+        revents_index = lua_gettop(L) + revents_index + 1;
+
+    /* Grow events buffer to number of registered handles */
+    if (set->events_size < set->count || set->events_size == 0) {
+        unsigned int size = set->count > 0 ? set->count : 1;
+        struct epoll_event *events;
+
+        if ((events = realloc(set->events, size * sizeof(struct epoll_event))) == NULL)
+            return -1;
+
+        set->events = events;
+        set->events_size = size;
+    }
+
+    /* Stack: [..., fds, handles] */
+    lua_rawgeti(L, LUA_REGISTRYINDEX, set->fds_ref);
+    base = lua_gettop(L);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, set->handles_ref);
+
+    /* Serial ports with bytes held in their receive buffer are immediately
+     * readable */
+    j = lua_periphery_serial_ready(L, base + 1, ready_index, revents_index, 0);
+
+    if ((ret = epoll_wait(set->epfd, set->events, set->events_size, (j > 0) ? 0 : timeout_ms)) < 0) {
+        int errsv = errno;
+        lua_settop(L, base - 1);
+        errno = errsv;
+        return -1;
+    }
+
+    /* Fill ready arrays with the handles and their events, skipping Serial
+     * ports already reported */
+    for (int i = 0; i < ret; i++) {
+        lua_rawgeti(L, base, set->events[i].data.fd);
+        if (lua_isnil(L, -1) || lua_periphery_serial_buffered(L, -1) > 0) {
+            lua_pop(L, 1);
+            continue;
+        }
+        lua_rawseti(L, ready_index, ++j);
+        if (revents_index != 0) {
+            lua_pushunsigned(L, set->events[i].events);
+            lua_rawseti(L, revents_index, j);
+        }
+    }
+
+    lua_settop(L, base - 1);
+
+    /* Clear stale entries from a previous wait */
+    lua_periphery_epoll_set_truncate(L, ready_index, j);
+    if (revents_index != 0)
+        lua_periphery_epoll_set_truncate(L, revents_index, j);
+
+    return j;
+}
+
+static void lua_poller_set(lua_State *L, int ref, int key_index, int value_index) {
+    lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+    lua_pushvalue(L, key_index);
+    lua_pushvalue(L, value_index);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+static int lua_poller_add(lua_State *L) {
+    lua_poller_t *poller;
+    uint32_t events;
+    int fd;
+
+    poller = lua_poller_checkopen(L, 1);
+    fd = lua_poller_checkfd(L, 2);
+
+    /* Optional events argument, defaulting to the events signaling an edge
+     * event for GPIOs, and to readable data otherwise */
+    if (lua_isnone(L, 3) || lua_isnil(L, 3)) {
+        events = lua_periphery_gpio_events(L, 2);
+        if (events == 0)
+            events = EPOLLIN;
+    } else if (lua_isnumber(L, 3)) {
+        events = lua_tounsigned(L, 3);
+    } else {
+        return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: invalid type of argument 'events', should be number or nil");
+    }
+
+    /* Optional callback argument */
+    if (!lua_isnone(L, 4) && !lua_isnil(L, 4) && !lua_isfunction(L, 4))
+        return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: invalid type of argument 'callback', should be function or nil");
+
+    lua_settop(L, 4);
+
+    if (lua_periphery_epoll_set_add(L, &poller->set, 2, fd, events) < 0)
+        return lua_poller_error(L, POLLER_ERROR_IO, errno, "Error: adding handle to poller: %s [errno %d]", strerror(errno), errno);
+
+    /* Drop the callback of an evicted handle */
+    if (!lua_isnil(L, 5)) {
+        lua_pushnil(L);
+        lua_poller_set(L, poller->callbacks_ref, 5, 6);
+    }
+
+    lua_pushnil(L);
+    lua_poller_set(L, poller->callbacks_ref, 2, lua_isfunction(L, 4) ? 4 : lua_gettop(L));
+
+    return 0;
+}
+
+static int lua_poller_remove(lua_State *L) {
+    lua_poller_t *poller;
+
+    poller = lua_poller_checkopen(L, 1);
+    lua_settop(L, 2);
+
+    lua_periphery_epoll_set_remove(L, &poller->set, 2);
+
+    lua_pushnil(L);
+    lua_poller_set(L, poller->callbacks_ref, 2, 3);
+
+    return 0;
+}
+
+static int lua_poller_new(lua_State *L) {
+    lua_poller_t *poller;
+
+    /* Remove self table object */
+    lua_remove(L, 1);
+
+    /* Create handle userdata */
+    poller = lua_newuserdata(L, sizeof(lua_poller_t));
+    poller->set.epfd = -1;
+    poller->set.fds_ref = LUA_NOREF;
+    poller->set.handles_ref = LUA_NOREF;
+    poller->set.events = NULL;
+    poller->callbacks_ref = LUA_NOREF;
+    /* Set Poller metatable on it */
+    luaL_getmetatable(L, "periphery.Poller");
+    lua_setmetatable(L, -2);
+    /* Move userdata to the beginning of the stack */
+    lua_insert(L, 1);
+
+    if (lua_periphery_epoll_set_open(L, &poller->set) < 0)
+        return lua_poller_error(L, POLLER_ERROR_OPEN, errno, "Error: creating epoll instance: %s [errno %d]", strerror(errno), errno);
+
+    lua_newtable(L);
+    poller->callbacks_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    /* Optional initial handles */
+    if (lua_istable(L, 2)) {
+        unsigned int count = luaL_len(L, 2);
+
+        for (unsigned int i = 0; i < count; i++) {
+            lua_pushcclosure(L, lua_poller_add, 0);
+            lua_pushvalue(L, 1);
+            lua_rawgeti(L, 2, i+1);
+            lua_call(L, 2, 0);
+        }
+    } else if (!lua_isnone(L, 2) && !lua_isnil(L, 2))
+        return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: invalid type of argument 'handles', should be table or nil");
+
+    /* Leave only userdata on the stack */
+    lua_settop(L, 1);
+
+    return 1;
+}
+
+static int lua_poller_wait(lua_State *L) {
+    lua_poller_t *poller;
+    int timeout_ms;
+    int count;
+
+    poller = lua_poller_checkopen(L, 1);
+
+    /* Optional timeout argument */
+    if (lua_isnone(L, 2) || lua_isnil(L, 2))
+        timeout_ms = -1;
+    else if (lua_isnumber(L, 2))
+        timeout_ms = lua_tointeger(L, 2);
+    else
+        return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
+
+    lua_settop(L, 1);
+
+    /* Stack: [self, ready, revents]. The ready arrays are created for each
+     * wait, so that callbacks may wait on the poller again. */
+    lua_newtable(L);
+    lua_newtable(L);
+
+    if ((count = lua_periphery_epoll_set_wait(L, &poller->set, timeout_ms, 2, 3)) < 0)
+        return lua_poller_error(L, (errno == ENOMEM) ? POLLER_ERROR_ALLOC : POLLER_ERROR_IO, errno, "Error: polling poller: %s [errno %d]", strerror(errno), errno);
+
+    /* Call the callbacks of ready handles */
+    lua_rawgeti(L, LUA_REGISTRYINDEX, poller->callbacks_ref);
+    for (int i = 1; i <= count; i++) {
+        lua_rawgeti(L, 2, i);
+        lua_rawget(L, 4);
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            continue;
+        }
+        lua_rawgeti(L, 2, i);
+        lua_rawgeti(L, 3, i);
+        lua_call(L, 2, 0);
+    }
+    lua_pop(L, 1);
+
+    return 2;
+}
+
+static void lua_poller_release(lua_State *L, lua_poller_t *poller) {
+    lua_periphery_epoll_set_close(L, &poller->set);
+
+    luaL_unref(L, LUA_REGISTRYINDEX, poller->callbacks_ref);
+    poller->callbacks_ref = LUA_NOREF;
+}
+
+static int lua_poller_close(lua_State *L) {
+    lua_poller_t *poller;
+
+    poller = luaL_checkudata(L, 1, "periphery.Poller");
+
+    lua_poller_release(L, poller);
+
+    return 0;
+}
+
+static int lua_poller_gc(lua_State *L) {
+    lua_poller_t *poller;
+
+    poller = luaL_checkudata(L, 1, "periphery.Poller");
+
+    lua_poller_release(L, poller);
+
+    return 0;
+}
+
+static int lua_poller_tostring(lua_State *L) {
+    lua_poller_t *poller;
+
+    poller = luaL_checkudata(L, 1, "periphery.Poller");
+
+    lua_pushfstring(L, "Poller (fd=%d, count=%d)", poller->set.epfd, (int)poller->set.count);
+
+    return 1;
+}
+
+static int lua_poller_index(lua_State *L) {
+    lua_poller_t *poller;
+    const char *field;
+
+    if (!lua_isstring(L, 2))
+        return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: unknown method or property");
+
+    field = lua_tostring(L, 2);
+
+    /* Look up method in metatable */
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, field);
+    if (!lua_isnil(L, -1))
+        return 1;
+
+    poller = luaL_checkudata(L, 1, "periphery.Poller");
+
+    if (strcmp(field, "fd") == 0) {
+        lua_pushinteger(L, poller->set.epfd);
+        return 1;
+    } else if (strcmp(field, "count") == 0) {
+        lua_pushunsigned(L, poller->set.count);
+        return 1;
+    }
+
+    return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static int lua_poller_newindex(lua_State *L) {
+    return lua_poller_error(L, POLLER_ERROR_ARG, 0, "Error: immutable property");
+}
+
+static const struct luaL_Reg periphery_poller_m[] = {
+    {"close", lua_poller_close},
+    {"add", lua_poller_add},
+    {"remove", lua_poller_remove},
+    {"wait", lua_poller_wait},
+    {"__gc", lua_poller_gc},
+    {"__tostring", lua_poller_tostring},
+    {"__index", lua_poller_index},
+    {"__newindex", lua_poller_newindex},
+    {NULL, NULL}
+};
+
+static const struct {
+    const char *name;
+    uint32_t events;
+} periphery_poller_events[] = {
+    {"IN", EPOLLIN},
+    {"PRI", EPOLLPRI},
+    {"OUT", EPOLLOUT},
+    {"ERR", EPOLLERR},
+    {"HUP", EPOLLHUP},
+    {NULL, 0}
+};
+
+LUALIB_API int luaopen_periphery_poller(lua_State *L) {
+    /* Create periphery.Poller metatable */
+    luaL_newmetatable(L, "periphery.Poller");
+    /* Set metatable functions */
+    const struct luaL_Reg *funcs = (const struct luaL_Reg *)periphery_poller_m;
+    for (; funcs->name != NULL; funcs++) {
+        lua_pushcclosure(L, funcs->func, 0);
+        lua_setfield(L, -2, funcs->name);
+    }
+    /* Set event constants */
+    for (unsigned int i = 0; periphery_poller_events[i].name != NULL; i++) {
+        lua_pushunsigned(L, periphery_poller_events[i].events);
+        lua_setfield(L, -2, periphery_poller_events[i].name);
+    }
+    /* Set metatable properties */
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+
+    /* Create {__call = lua_poller_new, __metatable = "protected metatable"} table */
+    lua_newtable(L);
+    lua_pushcclosure(L, lua_poller_new, 0);
+    lua_setfield(L, -2, "__call");
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+    /* Set it as the metatable for the periphery.Poller metatable */
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
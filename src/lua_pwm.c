@@ -12,6 +12,13 @@
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
 
 #include <c-periphery/src/pwm.h>
 #include "lua_periphery.h"
@@ -28,8 +35,25 @@ pwm = PWM{chip=<number>, channel=<number>}
 -- Methods
 pwm:enable()
 pwm:disable()
+pwm:configure{period_ns=<number>, duty_cycle_ns=<number>, polarity=<string>, enabled=<boolean>}
+pwm:ramp{to=<number>, duration_ms=<number>, curve="linear", step_us=1000}
+pwm:play(sequence <table>, loop <boolean|nil>)
+pwm:wait(timeout_ms <number|nil>) --> <boolean>
+pwm:stop()
 pwm:close()
 
+-- Static methods
+group = PWM.group(pwms <table>)
+
+-- Group methods
+group:set_duty_cycles(duty_cycles <table>) --> <number>
+group:set_duty_cycles_ns(duty_cycles_ns <table>) --> <number>
+group:close()
+
+-- Group properties
+group.count         immutable <number>
+group.pwms          immutable <table>
+
 -- Properties
 pwm.enabled         mutable <boolean>
 pwm.period_ns       mutable <number>
@@ -50,6 +74,68 @@ static const char *pwm_error_code_strings[] = {
     [-PWM_ERROR_CLOSE]      = "PWM_ERROR_CLOSE",
 };
 
+/* Native duty cycle player, which writes a precomputed sequence of duty
+ * cycles on a background thread at absolute deadlines */
+typedef struct lua_pwm_player {
+    int duty_cycle_fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    /* Signalled on stop request and on completion, with CLOCK_MONOTONIC
+     * timeouts */
+    pthread_cond_t cond;
+
+    /* Steps, owned by the thread. Step i writes duty_cycles_ns[i] at
+     * offsets_ns[i] after the start of the sequence, and the sequence lasts
+     * duration_ns. */
+    uint64_t *duty_cycles_ns;
+    uint64_t *offsets_ns;
+    size_t count;
+    uint64_t duration_ns;
+    bool loop;
+
+    /* State, protected by lock */
+    bool stop;
+    bool done;
+    uint64_t duty_cycle_ns;
+    int error_errno;
+} lua_pwm_player_t;
+
+/* PWM handle userdata */
+typedef struct lua_pwm {
+    pwm_t *pwm;
+
+    /* Sysfs attribute fds, kept open and accessed with pread()/pwrite() at
+     * offset 0 */
+    int enable_fd;
+    int period_fd;
+    int duty_cycle_fd;
+    int polarity_fd;
+
+    /* Attribute values last read or written, which are authoritative while
+     * the PWM is open */
+    bool enabled;
+    uint64_t period_ns;
+    uint64_t duty_cycle_ns;
+    pwm_polarity_t polarity;
+
+    /* Native duty cycle player, or NULL when not running */
+    lua_pwm_player_t *player;
+} lua_pwm_t;
+
+/* PWM group userdata */
+typedef struct lua_pwm_group {
+    /* Registry reference to array of member PWMs, which keeps them alive */
+    int pwms_ref;
+    unsigned int count;
+    struct lua_pwm **pwms;
+    /* Formatted duty cycles, reused across updates */
+    struct {
+        uint64_t duty_cycle_ns;
+        char str[24];
+        int len;
+    } *bufs;
+} lua_pwm_group_t;
+
 static int lua_pwm_error(lua_State *L, enum pwm_error_code code, int c_errno, const char *fmt, ...) {
     char message[128];
     va_list ap;
@@ -83,13 +169,264 @@ static void lua_pwm_checktype(lua_State *L, int index, int type) {
         lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid argument #%d (%s expected, got %s)", index, lua_typename(L, type), lua_typename(L, lua_type(L, index)));
 }
 
+static int lua_pwm_attr_read(int fd, char *buf, size_t size) {
+    ssize_t ret;
+
+    if ((ret = pread(fd, buf, size - 1, 0)) < 0)
+        return -1;
+
+    buf[ret] = '\0';
+
+    return 0;
+}
+
+static int lua_pwm_attr_write(int fd, const char *buf) {
+    if (pwrite(fd, buf, strlen(buf), 0) < 0)
+        return -1;
+
+    return 0;
+}
+
+static int lua_pwm_attr_write_u64(int fd, uint64_t value) {
+    char buf[24];
+
+    snprintf(buf, sizeof(buf), "%" PRIu64 "\n", value);
+
+    return lua_pwm_attr_write(fd, buf);
+}
+
+static void lua_pwm_close_attrs(lua_pwm_t *handle) {
+    int *fds[] = {&handle->enable_fd, &handle->period_fd, &handle->duty_cycle_fd, &handle->polarity_fd};
+
+    for (size_t i = 0; i < sizeof(fds)/sizeof(fds[0]); i++) {
+        if (*fds[i] >= 0) {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+}
+
+/* Open the sysfs attributes of the PWM and read their current values into
+ * the cache */
+static int lua_pwm_open_attrs(lua_State *L, lua_pwm_t *handle) {
+    static const char *names[] = {"enable", "period", "duty_cycle", "polarity"};
+    int *fds[] = {&handle->enable_fd, &handle->period_fd, &handle->duty_cycle_fd, &handle->polarity_fd};
+    char path[96];
+    char buf[24];
+
+    for (size_t i = 0; i < sizeof(fds)/sizeof(fds[0]); i++) {
+        snprintf(path, sizeof(path), "/sys/class/pwm/pwmchip%u/pwm%u/%s", pwm_chip(handle->pwm), pwm_channel(handle->pwm), names[i]);
+
+        if ((*fds[i] = open(path, O_RDWR)) < 0) {
+            int errsv = errno;
+            lua_pwm_close_attrs(handle);
+            pwm_close(handle->pwm);
+            return lua_pwm_error(L, PWM_ERROR_OPEN, errsv, "Error: opening PWM '%s': %s [errno %d]", names[i], strerror(errsv), errsv);
+        }
+
+        if (lua_pwm_attr_read(*fds[i], buf, sizeof(buf)) < 0) {
+            int errsv = errno;
+            lua_pwm_close_attrs(handle);
+            pwm_close(handle->pwm);
+            return lua_pwm_error(L, PWM_ERROR_QUERY, errsv, "Error: reading PWM '%s': %s [errno %d]", names[i], strerror(errsv), errsv);
+        }
+
+        if (fds[i] == &handle->enable_fd)
+            handle->enabled = buf[0] == '1';
+        else if (fds[i] == &handle->period_fd)
+            handle->period_ns = strtoull(buf, NULL, 10);
+        else if (fds[i] == &handle->duty_cycle_fd)
+            handle->duty_cycle_ns = strtoull(buf, NULL, 10);
+        else
+            handle->polarity = (strncmp(buf, "inversed", 8) == 0) ? PWM_POLARITY_INVERSED : PWM_POLARITY_NORMAL;
+    }
+
+    return 0;
+}
+
+static int lua_pwm_set_enabled(lua_State *L, lua_pwm_t *handle, bool enabled) {
+    if (lua_pwm_attr_write(handle->enable_fd, enabled ? "1\n" : "0\n") < 0)
+        return lua_pwm_error(L, PWM_ERROR_CONFIGURE, errno, "Error: writing PWM 'enable': %s [errno %d]", strerror(errno), errno);
+
+    handle->enabled = enabled;
+
+    return 0;
+}
+
+static int lua_pwm_set_period_ns(lua_State *L, lua_pwm_t *handle, uint64_t period_ns) {
+    if (lua_pwm_attr_write_u64(handle->period_fd, period_ns) < 0)
+        return lua_pwm_error(L, PWM_ERROR_CONFIGURE, errno, "Error: writing PWM 'period': %s [errno %d]", strerror(errno), errno);
+
+    handle->period_ns = period_ns;
+
+    return 0;
+}
+
+static int lua_pwm_set_duty_cycle_ns(lua_State *L, lua_pwm_t *handle, uint64_t duty_cycle_ns) {
+    if (lua_pwm_attr_write_u64(handle->duty_cycle_fd, duty_cycle_ns) < 0)
+        return lua_pwm_error(L, PWM_ERROR_CONFIGURE, errno, "Error: writing PWM 'duty_cycle': %s [errno %d]", strerror(errno), errno);
+
+    handle->duty_cycle_ns = duty_cycle_ns;
+
+    return 0;
+}
+
+static int lua_pwm_set_polarity(lua_State *L, lua_pwm_t *handle, pwm_polarity_t polarity) {
+    if (lua_pwm_attr_write(handle->polarity_fd, (polarity == PWM_POLARITY_INVERSED) ? "inversed\n" : "normal\n") < 0)
+        return lua_pwm_error(L, PWM_ERROR_CONFIGURE, errno, "Error: writing PWM 'polarity': %s [errno %d]", strerror(errno), errno);
+
+    handle->polarity = polarity;
+
+    return 0;
+}
+
+static lua_pwm_t *lua_pwm_checkopen(lua_State *L, int index) {
+    lua_pwm_t *handle = (lua_pwm_t *)luaL_checkudata(L, index, "periphery.PWM");
+
+    if (handle->enable_fd < 0)
+        lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: PWM is closed");
+
+    return handle;
+}
+
+static uint64_t lua_pwm_monotonic_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/* Wait until an absolute CLOCK_MONOTONIC deadline, returning true if a stop
+ * was requested in the meantime */
+static bool lua_pwm_player_wait_until(lua_pwm_player_t *player, uint64_t deadline_ns) {
+    struct timespec ts;
+    bool stop;
+
+    ts.tv_sec = deadline_ns / 1000000000;
+    ts.tv_nsec = deadline_ns % 1000000000;
+
+    pthread_mutex_lock(&player->lock);
+    while (!player->stop) {
+        if (pthread_cond_timedwait(&player->cond, &player->lock, &ts) == ETIMEDOUT)
+            break;
+    }
+    stop = player->stop;
+    pthread_mutex_unlock(&player->lock);
+
+    return stop;
+}
+
+static void *lua_pwm_player_thread(void *arg) {
+    lua_pwm_player_t *player = arg;
+    uint64_t start_ns = lua_pwm_monotonic_ns();
+    uint64_t last_ns = player->duty_cycle_ns;
+    int error_errno = 0;
+    bool stop = false;
+
+    while (!stop) {
+        for (size_t i = 0; i < player->count; i++) {
+            if ((stop = lua_pwm_player_wait_until(player, start_ns + player->offsets_ns[i])))
+                break;
+
+            if (player->duty_cycles_ns[i] == last_ns)
+                continue;
+
+            if (lua_pwm_attr_write_u64(player->duty_cycle_fd, player->duty_cycles_ns[i]) < 0) {
+                error_errno = errno;
+                stop = true;
+                break;
+            }
+
+            last_ns = player->duty_cycles_ns[i];
+
+            pthread_mutex_lock(&player->lock);
+            player->duty_cycle_ns = last_ns;
+            pthread_mutex_unlock(&player->lock);
+        }
+
+        if (!stop && !player->loop) {
+            lua_pwm_player_wait_until(player, start_ns + player->duration_ns);
+            break;
+        }
+
+        /* Deadlines of the next iteration follow on from the previous ones,
+         * so late writes do not accumulate drift */
+        start_ns += player->duration_ns;
+    }
+
+    pthread_mutex_lock(&player->lock);
+    player->done = true;
+    player->error_errno = error_errno;
+    pthread_cond_broadcast(&player->cond);
+    pthread_mutex_unlock(&player->lock);
+
+    return NULL;
+}
+
+/* Stop the player, if any, and take over its last written duty cycle */
+static void lua_pwm_player_stop(lua_pwm_t *handle) {
+    lua_pwm_player_t *player = handle->player;
+
+    if (player == NULL)
+        return;
+
+    pthread_mutex_lock(&player->lock);
+    player->stop = true;
+    pthread_cond_broadcast(&player->cond);
+    pthread_mutex_unlock(&player->lock);
+
+    pthread_join(player->thread, NULL);
+
+    handle->duty_cycle_ns = player->duty_cycle_ns;
+
+    pthread_cond_destroy(&player->cond);
+    pthread_mutex_destroy(&player->lock);
+    free(player->duty_cycles_ns);
+    free(player->offsets_ns);
+    free(player);
+
+    handle->player = NULL;
+}
+
+/* Refresh the cached duty cycle from a running player */
+static void lua_pwm_player_sync(lua_pwm_t *handle) {
+    lua_pwm_player_t *player = handle->player;
+
+    if (player == NULL)
+        return;
+
+    pthread_mutex_lock(&player->lock);
+    handle->duty_cycle_ns = player->duty_cycle_ns;
+    pthread_mutex_unlock(&player->lock);
+}
+
+/* Release a finished player, or raise an error if the player is still
+ * running */
+static void lua_pwm_check_no_player(lua_State *L, lua_pwm_t *handle) {
+    lua_pwm_player_t *player = handle->player;
+    bool done;
+
+    if (player == NULL)
+        return;
+
+    pthread_mutex_lock(&player->lock);
+    done = player->done;
+    pthread_mutex_unlock(&player->lock);
+
+    if (!done)
+        lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: PWM is being driven by a ramp or sequence");
+
+    lua_pwm_player_stop(handle);
+}
+
 static int lua_pwm_open(lua_State *L) {
-    pwm_t *pwm;
+    lua_pwm_t *handle;
     unsigned int chip;
     unsigned int channel;
     int ret;
 
-    pwm = *((pwm_t **)luaL_checkudata(L, 1, "periphery.PWM"));
+    handle = (lua_pwm_t *)luaL_checkudata(L, 1, "periphery.PWM");
 
     /* Arguments passed in table form */
     if (lua_istable(L, 2)) {
@@ -112,8 +449,10 @@ static int lua_pwm_open(lua_State *L) {
         channel = lua_tounsigned(L, 3);
     }
 
-    if ((ret = pwm_open(pwm, chip, channel)) < 0)
-        return lua_pwm_error(L, ret, pwm_errno(pwm), pwm_errmsg(pwm));
+    if ((ret = pwm_open(handle->pwm, chip, channel)) < 0)
+        return lua_pwm_error(L, ret, pwm_errno(handle->pwm), pwm_errmsg(handle->pwm));
+
+    lua_pwm_open_attrs(L, handle);
 
     return 0;
 }
@@ -123,8 +462,17 @@ static int lua_pwm_new(lua_State *L) {
     lua_remove(L, 1);
 
     /* Create handle userdata */
-    pwm_t **pwm = lua_newuserdata(L, sizeof(pwm_t *));
-    *pwm = pwm_new();
+    lua_pwm_t *handle = lua_newuserdata(L, sizeof(lua_pwm_t));
+    handle->pwm = pwm_new();
+    handle->enable_fd = -1;
+    handle->period_fd = -1;
+    handle->duty_cycle_fd = -1;
+    handle->polarity_fd = -1;
+    handle->enabled = false;
+    handle->period_ns = 0;
+    handle->duty_cycle_ns = 0;
+    handle->polarity = PWM_POLARITY_NORMAL;
+    handle->player = NULL;
     /* Set PWM metatable on it */
     luaL_getmetatable(L, "periphery.PWM");
     lua_setmetatable(L, -2);
@@ -141,49 +489,486 @@ static int lua_pwm_new(lua_State *L) {
 }
 
 static int lua_pwm_enable(lua_State *L) {
-    pwm_t *pwm;
-    int ret;
+    lua_pwm_t *handle;
 
-    pwm = *((pwm_t **)luaL_checkudata(L, 1, "periphery.PWM"));
+    handle = lua_pwm_checkopen(L, 1);
+    lua_pwm_check_no_player(L, handle);
 
-    if ((ret = pwm_enable(pwm)) < 0)
-        return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+    lua_pwm_set_enabled(L, handle, true);
 
     return 0;
 }
 
 static int lua_pwm_disable(lua_State *L) {
-    pwm_t *pwm;
+    lua_pwm_t *handle;
+
+    handle = lua_pwm_checkopen(L, 1);
+    lua_pwm_check_no_player(L, handle);
+
+    lua_pwm_set_enabled(L, handle, false);
+
+    return 0;
+}
+
+static int lua_pwm_configure(lua_State *L) {
+    lua_pwm_t *handle;
+    bool enabled, cur_enabled;
+    uint64_t period_ns, cur_period_ns;
+    uint64_t duty_cycle_ns, cur_duty_cycle_ns;
+    pwm_polarity_t polarity, cur_polarity;
+
+    handle = lua_pwm_checkopen(L, 1);
+    lua_pwm_checktype(L, 2, LUA_TTABLE);
+
+    lua_pwm_check_no_player(L, handle);
+
+    /* Current state, which omitted fields keep */
+    enabled = cur_enabled = handle->enabled;
+    period_ns = cur_period_ns = handle->period_ns;
+    duty_cycle_ns = cur_duty_cycle_ns = handle->duty_cycle_ns;
+    polarity = cur_polarity = handle->polarity;
+
+    /* Optional period_ns */
+    lua_getfield(L, 2, "period_ns");
+    if (lua_isnumber(L, -1))
+        period_ns = lua_tounsigned(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid type of table argument 'period_ns', should be number");
+
+    /* Optional duty_cycle_ns */
+    lua_getfield(L, 2, "duty_cycle_ns");
+    if (lua_isnumber(L, -1))
+        duty_cycle_ns = lua_tounsigned(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid type of table argument 'duty_cycle_ns', should be number");
+
+    /* Optional polarity */
+    lua_getfield(L, 2, "polarity");
+    if (lua_isstring(L, -1)) {
+        const char *s = lua_tostring(L, -1);
+
+        if (strcmp(s, "normal") == 0)
+            polarity = PWM_POLARITY_NORMAL;
+        else if (strcmp(s, "inversed") == 0)
+            polarity = PWM_POLARITY_INVERSED;
+        else
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid polarity, should be 'normal' or 'inversed'");
+    } else if (!lua_isnil(L, -1))
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid type of table argument 'polarity', should be string");
+
+    /* Optional enabled */
+    lua_getfield(L, 2, "enabled");
+    if (lua_isboolean(L, -1))
+        enabled = lua_toboolean(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid type of table argument 'enabled', should be boolean");
+
+    if (duty_cycle_ns > period_ns)
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid duty cycle, should not exceed period");
+
+    /* Disable first, if disabling, or if changing polarity, which most
+     * drivers only allow while disabled */
+    if (cur_enabled && (!enabled || polarity != cur_polarity)) {
+        lua_pwm_set_enabled(L, handle, false);
+        cur_enabled = false;
+    }
+
+    if (polarity != cur_polarity)
+        lua_pwm_set_polarity(L, handle, polarity);
+
+    /* The duty cycle may never exceed the period, so a period shorter than
+     * the current duty cycle is written after the new duty cycle */
+    if (period_ns < cur_duty_cycle_ns) {
+        if (duty_cycle_ns != cur_duty_cycle_ns)
+            lua_pwm_set_duty_cycle_ns(L, handle, duty_cycle_ns);
+        if (period_ns != cur_period_ns)
+            lua_pwm_set_period_ns(L, handle, period_ns);
+    } else {
+        if (period_ns != cur_period_ns)
+            lua_pwm_set_period_ns(L, handle, period_ns);
+        if (duty_cycle_ns != cur_duty_cycle_ns)
+            lua_pwm_set_duty_cycle_ns(L, handle, duty_cycle_ns);
+    }
+
+    /* Enable last */
+    if (enabled && !cur_enabled)
+        lua_pwm_set_enabled(L, handle, true);
+
+    return 0;
+}
+
+#define PWM_RAMP_DEFAULT_STEP_US    1000
+#define PWM_RAMP_MAX_STEPS          (1u << 20)
+#define PWM_PLAY_MAX_STEPS          (1u << 20)
+
+static void lua_pwm_player_start(lua_State *L, lua_pwm_t *handle, lua_pwm_player_t *player) {
+    pthread_condattr_t condattr;
     int ret;
 
-    pwm = *((pwm_t **)luaL_checkudata(L, 1, "periphery.PWM"));
+    player->duty_cycle_fd = handle->duty_cycle_fd;
+    player->duty_cycle_ns = handle->duty_cycle_ns;
+
+    pthread_mutex_init(&player->lock, NULL);
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&player->cond, &condattr);
+    pthread_condattr_destroy(&condattr);
+
+    if ((ret = pthread_create(&player->thread, NULL, lua_pwm_player_thread, player)) != 0) {
+        pthread_cond_destroy(&player->cond);
+        pthread_mutex_destroy(&player->lock);
+        free(player->duty_cycles_ns);
+        free(player->offsets_ns);
+        free(player);
+        lua_pwm_error(L, PWM_ERROR_CONFIGURE, ret, "Error: creating player thread: %s [errno %d]", strerror(ret), ret);
+    }
+
+    handle->player = player;
+}
+
+static lua_pwm_player_t *lua_pwm_player_new(lua_State *L, size_t count) {
+    lua_pwm_player_t *player;
+
+    if ((player = calloc(1, sizeof(lua_pwm_player_t))) == NULL)
+        lua_pwm_error(L, PWM_ERROR_CONFIGURE, errno, "Error: allocating memory");
+
+    player->count = count;
+    player->duty_cycles_ns = calloc(count, sizeof(uint64_t));
+    player->offsets_ns = calloc(count, sizeof(uint64_t));
+
+    if (player->duty_cycles_ns == NULL || player->offsets_ns == NULL) {
+        int errsv = errno;
+        free(player->duty_cycles_ns);
+        free(player->offsets_ns);
+        free(player);
+        lua_pwm_error(L, PWM_ERROR_CONFIGURE, errsv, "Error: allocating memory");
+    }
+
+    return player;
+}
+
+/* Parse a duty cycle, given as a ratio of the period in field ratio_field or
+ * in nanoseconds in field ns_field of the table at index. Returns false if
+ * neither field is set. */
+static bool lua_pwm_check_duty_cycle_field(lua_State *L, lua_pwm_t *handle, int index, const char *ratio_field, const char *ns_field, uint64_t *duty_cycle_ns) {
+    if (index < 0)
+        index = lua_gettop(L) + index + 1;
+
+    lua_getfield(L, index, ratio_field);
+    lua_getfield(L, index, ns_field);
+
+    if (lua_isnumber(L, -2)) {
+        double ratio = lua_tonumber(L, -2);
+
+        if (ratio < 0.0 || ratio > 1.0)
+            lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid table argument '%s', should be between 0.0 and 1.0", ratio_field);
+
+        *duty_cycle_ns = (uint64_t)(ratio * (double)handle->period_ns);
+    } else if (!lua_isnil(L, -2)) {
+        lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid type of table argument '%s', should be number", ratio_field);
+    } else if (lua_isnumber(L, -1)) {
+        *duty_cycle_ns = lua_tounsigned(L, -1);
+
+        if (*duty_cycle_ns > handle->period_ns)
+            lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid table argument '%s', should not exceed period", ns_field);
+    } else if (!lua_isnil(L, -1)) {
+        lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid type of table argument '%s', should be number", ns_field);
+    } else {
+        lua_pop(L, 2);
+        return false;
+    }
+
+    lua_pop(L, 2);
+
+    return true;
+}
+
+typedef enum lua_pwm_ramp_curve {
+    PWM_RAMP_LINEAR,
+    PWM_RAMP_EXP,
+    PWM_RAMP_TABLE,
+} lua_pwm_ramp_curve_t;
+
+static int lua_pwm_ramp(lua_State *L) {
+    lua_pwm_t *handle;
+    lua_pwm_player_t *player;
+    lua_pwm_ramp_curve_t curve = PWM_RAMP_LINEAR;
+    uint64_t from_ns, to_ns;
+    double duration_ms;
+    uint64_t duration_ns, step_ns = PWM_RAMP_DEFAULT_STEP_US * 1000;
+    size_t count, curve_count = 0;
+
+    handle = lua_pwm_checkopen(L, 1);
+    lua_pwm_checktype(L, 2, LUA_TTABLE);
+
+    lua_pwm_check_no_player(L, handle);
+
+    /* Target duty cycle */
+    if (!lua_pwm_check_duty_cycle_field(L, handle, 2, "to", "to_ns", &to_ns))
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: missing table argument 'to' or 'to_ns'");
+
+    /* Duration */
+    lua_getfield(L, 2, "duration_ms");
+    if (!lua_isnumber(L, -1))
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid type of table argument 'duration_ms', should be number");
+    if ((duration_ms = lua_tonumber(L, -1)) < 0)
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid table argument 'duration_ms', should be non-negative");
+    duration_ns = (uint64_t)(duration_ms * 1e6);
+
+    /* Optional step_us */
+    lua_getfield(L, 2, "step_us");
+    if (lua_isnumber(L, -1)) {
+        if ((step_ns = lua_tounsigned(L, -1) * 1000) == 0)
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid table argument 'step_us', should be positive");
+    } else if (!lua_isnil(L, -1)) {
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid type of table argument 'step_us', should be number");
+    }
+
+    /* Optional curve */
+    lua_getfield(L, 2, "curve");
+    if (lua_type(L, -1) == LUA_TSTRING) {
+        if (strcmp(lua_tostring(L, -1), "linear") == 0)
+            curve = PWM_RAMP_LINEAR;
+        else if (strcmp(lua_tostring(L, -1), "exp") == 0)
+            curve = PWM_RAMP_EXP;
+        else
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid table argument 'curve', should be 'linear', 'exp', or table");
+    } else if (lua_istable(L, -1)) {
+        curve = PWM_RAMP_TABLE;
+        curve_count = luaL_len(L, -1);
+
+        if (curve_count < 2)
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid table argument 'curve', should have at least 2 points");
+
+        for (size_t i = 1; i <= curve_count; i++) {
+            lua_rawgeti(L, -1, i);
+            if (!lua_isnumber(L, -1) || lua_tonumber(L, -1) < 0.0 || lua_tonumber(L, -1) > 1.0)
+                return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid curve point %u, should be number between 0.0 and 1.0", (unsigned int)i);
+            lua_pop(L, 1);
+        }
+    } else if (!lua_isnil(L, -1)) {
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid type of table argument 'curve', should be string or table");
+    }
+
+    count = (duration_ns + step_ns - 1) / step_ns;
+    if (count == 0)
+        count = 1;
+    if (count > PWM_RAMP_MAX_STEPS)
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: too many ramp steps, should be at most %u", PWM_RAMP_MAX_STEPS);
+
+    from_ns = handle->duty_cycle_ns;
+
+    player = lua_pwm_player_new(L, count);
+    player->duration_ns = duration_ns;
+    player->loop = false;
+
+    /* Precompute the duty cycle of each step, with the last step at the end
+     * of the ramp writing the exact target */
+    for (size_t i = 0; i < count; i++) {
+        uint64_t offset_ns = (i + 1 == count) ? duration_ns : (i + 1) * step_ns;
+        double t = (duration_ns > 0) ? (double)offset_ns / (double)duration_ns : 1.0;
+        double from = (double)from_ns, to = (double)to_ns;
+        double duty_cycle;
+
+        switch (curve) {
+            case PWM_RAMP_EXP: {
+                /* Exponential over a 100:1 range between the lower and
+                 * upper duty cycle, traversed backwards for falling ramps,
+                 * so that fades in both directions follow the same
+                 * perceptual brightness curve */
+                double lo = (from < to) ? from : to;
+                double hi = (from < to) ? to : from;
+                double u = (from <= to) ? t : 1.0 - t;
+
+                duty_cycle = lo + (hi - lo) * (pow(100.0, u) - 1.0) / 99.0;
+                break;
+            }
+            case PWM_RAMP_TABLE: {
+                /* Linear interpolation between evenly spaced curve points */
+                double x = t * (double)(curve_count - 1);
+                size_t k = (size_t)x;
+                double y0, y1;
+
+                if (k >= curve_count - 1)
+                    k = curve_count - 2;
+
+                lua_rawgeti(L, -1, k + 1);
+                lua_rawgeti(L, -2, k + 2);
+                y0 = lua_tonumber(L, -2);
+                y1 = lua_tonumber(L, -1);
+                lua_pop(L, 2);
+
+                duty_cycle = from + (to - from) * (y0 + (y1 - y0) * (x - (double)k));
+                break;
+            }
+            default:
+                duty_cycle = from + (to - from) * t;
+                break;
+        }
+
+        player->offsets_ns[i] = offset_ns;
+        player->duty_cycles_ns[i] = (i + 1 == count) ? to_ns : (uint64_t)(duty_cycle + 0.5);
+    }
+
+    lua_pwm_player_start(L, handle, player);
+
+    return 0;
+}
+
+static int lua_pwm_play(lua_State *L) {
+    lua_pwm_t *handle;
+    lua_pwm_player_t *player;
+    uint64_t offset_ns = 0;
+    bool loop = false;
+    size_t count;
+
+    handle = lua_pwm_checkopen(L, 1);
+    lua_pwm_checktype(L, 2, LUA_TTABLE);
+
+    /* Optional loop */
+    if (!lua_isnoneornil(L, 3)) {
+        lua_pwm_checktype(L, 3, LUA_TBOOLEAN);
+        loop = lua_toboolean(L, 3);
+    }
+
+    lua_pwm_check_no_player(L, handle);
+
+    count = luaL_len(L, 2);
+    if (count == 0 || count > PWM_PLAY_MAX_STEPS)
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid sequence length, should be between 1 and %u", PWM_PLAY_MAX_STEPS);
+
+    /* Validate the sequence before allocating the player */
+    for (size_t i = 1; i <= count; i++) {
+        uint64_t duty_cycle_ns;
+
+        lua_rawgeti(L, 2, i);
+        if (!lua_istable(L, -1))
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid sequence step %u, should be table", (unsigned int)i);
 
-    if ((ret = pwm_disable(pwm)) < 0)
-        return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+        if (!lua_pwm_check_duty_cycle_field(L, handle, -1, "duty_cycle", "duty_cycle_ns", &duty_cycle_ns))
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: missing field 'duty_cycle' or 'duty_cycle_ns' in sequence step %u", (unsigned int)i);
+
+        lua_getfield(L, -1, "duration_ms");
+        if (!lua_isnumber(L, -1) || lua_tonumber(L, -1) < 0)
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid field 'duration_ms' in sequence step %u, should be non-negative number", (unsigned int)i);
+        offset_ns += (uint64_t)(lua_tonumber(L, -1) * 1e6);
+
+        lua_pop(L, 2);
+    }
+
+    if (loop && offset_ns == 0)
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: looped sequence has zero duration");
+
+    player = lua_pwm_player_new(L, count);
+    player->duration_ns = offset_ns;
+    player->loop = loop;
+
+    /* Each step writes its duty cycle at the start of its duration */
+    offset_ns = 0;
+    for (size_t i = 0; i < count; i++) {
+        lua_rawgeti(L, 2, i + 1);
+        lua_pwm_check_duty_cycle_field(L, handle, -1, "duty_cycle", "duty_cycle_ns", &player->duty_cycles_ns[i]);
+        player->offsets_ns[i] = offset_ns;
+        lua_getfield(L, -1, "duration_ms");
+        offset_ns += (uint64_t)(lua_tonumber(L, -1) * 1e6);
+        lua_pop(L, 2);
+    }
+
+    lua_pwm_player_start(L, handle, player);
+
+    return 0;
+}
+
+static int lua_pwm_wait(lua_State *L) {
+    lua_pwm_t *handle;
+    lua_pwm_player_t *player;
+    int timeout_ms = -1;
+    int error_errno;
+    bool done;
+
+    handle = (lua_pwm_t *)luaL_checkudata(L, 1, "periphery.PWM");
+
+    /* Optional timeout */
+    if (!lua_isnoneornil(L, 2)) {
+        lua_pwm_checktype(L, 2, LUA_TNUMBER);
+        timeout_ms = lua_tointeger(L, 2);
+    }
+
+    if ((player = handle->player) == NULL) {
+        lua_pushboolean(L, true);
+        return 1;
+    }
+
+    pthread_mutex_lock(&player->lock);
+    if (timeout_ms < 0) {
+        while (!player->done)
+            pthread_cond_wait(&player->cond, &player->lock);
+    } else {
+        uint64_t deadline_ns = lua_pwm_monotonic_ns() + (uint64_t)timeout_ms * 1000000;
+        struct timespec ts;
+
+        ts.tv_sec = deadline_ns / 1000000000;
+        ts.tv_nsec = deadline_ns % 1000000000;
+
+        while (!player->done) {
+            if (pthread_cond_timedwait(&player->cond, &player->lock, &ts) == ETIMEDOUT)
+                break;
+        }
+    }
+    done = player->done;
+    error_errno = player->error_errno;
+    pthread_mutex_unlock(&player->lock);
+
+    if (!done) {
+        lua_pushboolean(L, false);
+        return 1;
+    }
+
+    lua_pwm_player_stop(handle);
+
+    if (error_errno != 0)
+        return lua_pwm_error(L, PWM_ERROR_CONFIGURE, error_errno, "Error: writing PWM 'duty_cycle': %s [errno %d]", strerror(error_errno), error_errno);
+
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+static int lua_pwm_stop(lua_State *L) {
+    lua_pwm_t *handle;
+
+    handle = (lua_pwm_t *)luaL_checkudata(L, 1, "periphery.PWM");
+
+    lua_pwm_player_stop(handle);
 
     return 0;
 }
 
 static int lua_pwm_close(lua_State *L) {
-    pwm_t *pwm;
+    lua_pwm_t *handle;
     int ret;
 
-    pwm = *((pwm_t **)luaL_checkudata(L, 1, "periphery.PWM"));
+    handle = (lua_pwm_t *)luaL_checkudata(L, 1, "periphery.PWM");
+
+    lua_pwm_player_stop(handle);
+    lua_pwm_close_attrs(handle);
 
-    if ((ret = pwm_close(pwm)) < 0)
-        return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+    if ((ret = pwm_close(handle->pwm)) < 0)
+        return lua_pwm_error(L, ret, pwm_errno(handle->pwm), "Error: %s", pwm_errmsg(handle->pwm));
 
     return 0;
 }
 
 static int lua_pwm_gc(lua_State *L) {
-    pwm_t *pwm;
+    lua_pwm_t *handle;
 
-    pwm = *((pwm_t **)luaL_checkudata(L, 1, "periphery.PWM"));
+    handle = (lua_pwm_t *)luaL_checkudata(L, 1, "periphery.PWM");
+
+    lua_pwm_player_stop(handle);
+    lua_pwm_close_attrs(handle);
 
-    pwm_close(pwm);
+    pwm_close(handle->pwm);
 
-    pwm_free(pwm);
+    pwm_free(handle->pwm);
 
     return 0;
 }
@@ -202,7 +987,7 @@ static int lua_pwm_tostring(lua_State *L) {
 }
 
 static int lua_pwm_index(lua_State *L) {
-    pwm_t *pwm;
+    lua_pwm_t *handle;
     const char *field;
 
     if (!lua_isstring(L, 2))
@@ -216,76 +1001,40 @@ static int lua_pwm_index(lua_State *L) {
     if (!lua_isnil(L, -1))
         return 1;
 
-    pwm = *((pwm_t **)luaL_checkudata(L, 1, "periphery.PWM"));
+    handle = (lua_pwm_t *)luaL_checkudata(L, 1, "periphery.PWM");
 
     if (strcmp(field, "chip") == 0) {
-        lua_pushunsigned(L, pwm_chip(pwm));
+        lua_pushunsigned(L, pwm_chip(handle->pwm));
         return 1;
     } else if (strcmp(field, "channel") == 0) {
-        lua_pushunsigned(L, pwm_channel(pwm));
+        lua_pushunsigned(L, pwm_channel(handle->pwm));
         return 1;
-    } else if (strcmp(field, "enabled") == 0) {
-        bool enabled;
-        int ret;
+    }
 
-        if ((ret = pwm_get_enabled(pwm, &enabled)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+    /* Attribute values are served from the cache */
+    handle = lua_pwm_checkopen(L, 1);
+    lua_pwm_player_sync(handle);
 
-        lua_pushboolean(L, enabled);
+    if (strcmp(field, "enabled") == 0) {
+        lua_pushboolean(L, handle->enabled);
         return 1;
     } else if (strcmp(field, "period_ns") == 0) {
-        uint64_t period_ns;
-        int ret;
-
-        if ((ret = pwm_get_period_ns(pwm, &period_ns)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
-
-        lua_pushunsigned(L, period_ns);
+        lua_pushunsigned(L, handle->period_ns);
         return 1;
     } else if (strcmp(field, "duty_cycle_ns") == 0) {
-        uint64_t duty_cycle_ns;
-        int ret;
-
-        if ((ret = pwm_get_duty_cycle_ns(pwm, &duty_cycle_ns)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
-
-        lua_pushunsigned(L, duty_cycle_ns);
+        lua_pushunsigned(L, handle->duty_cycle_ns);
         return 1;
     } else if (strcmp(field, "period") == 0) {
-        double period;
-        int ret;
-
-        if ((ret = pwm_get_period(pwm, &period)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
-
-        lua_pushnumber(L, period);
+        lua_pushnumber(L, (double)handle->period_ns / 1e9);
         return 1;
     } else if (strcmp(field, "duty_cycle") == 0) {
-        double duty_cycle;
-        int ret;
-
-        if ((ret = pwm_get_duty_cycle(pwm, &duty_cycle)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
-
-        lua_pushnumber(L, duty_cycle);
+        lua_pushnumber(L, (handle->period_ns > 0) ? (double)handle->duty_cycle_ns / (double)handle->period_ns : 0.0);
         return 1;
     } else if (strcmp(field, "frequency") == 0) {
-        double frequency;
-        int ret;
-
-        if ((ret = pwm_get_frequency(pwm, &frequency)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
-
-        lua_pushnumber(L, frequency);
+        lua_pushnumber(L, (handle->period_ns > 0) ? 1e9 / (double)handle->period_ns : 0.0);
         return 1;
     } else if (strcmp(field, "polarity") == 0) {
-        pwm_polarity_t polarity;
-        int ret;
-
-        if ((ret = pwm_get_polarity(pwm, &polarity)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
-
-        switch (polarity) {
+        switch (handle->polarity) {
             case PWM_POLARITY_NORMAL: lua_pushstring(L, "normal"); break;
             case PWM_POLARITY_INVERSED: lua_pushstring(L, "inversed"); break;
             default: lua_pushstring(L, "unknown"); break;
@@ -297,10 +1046,10 @@ static int lua_pwm_index(lua_State *L) {
 }
 
 static int lua_pwm_newindex(lua_State *L) {
-    pwm_t *pwm;
+    lua_pwm_t *handle;
     const char *field;
 
-    pwm = *((pwm_t **)luaL_checkudata(L, 1, "periphery.PWM"));
+    handle = (lua_pwm_t *)luaL_checkudata(L, 1, "periphery.PWM");
 
     if (!lua_isstring(L, 2))
         return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: unknown property");
@@ -311,76 +1060,68 @@ static int lua_pwm_newindex(lua_State *L) {
         return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: immutable property");
     } else if (strcmp(field, "channel") == 0) {
         return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: immutable property");
-    } else if (strcmp(field, "enabled") == 0) {
-        bool enabled;
-        int ret;
+    }
+
+    handle = lua_pwm_checkopen(L, 1);
+    lua_pwm_check_no_player(L, handle);
 
+    if (strcmp(field, "enabled") == 0) {
         lua_pwm_checktype(L, 3, LUA_TBOOLEAN);
-        enabled = lua_toboolean(L, 3);
 
-        if ((ret = pwm_set_enabled(pwm, enabled)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+        lua_pwm_set_enabled(L, handle, lua_toboolean(L, 3));
 
         return 0;
     } else if (strcmp(field, "period_ns") == 0) {
-        uint64_t period_ns;
-        int ret;
-
         lua_pwm_checktype(L, 3, LUA_TNUMBER);
-        period_ns = lua_tounsigned(L, 3);
 
-        if ((ret = pwm_set_period_ns(pwm, period_ns)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+        lua_pwm_set_period_ns(L, handle, lua_tounsigned(L, 3));
 
         return 0;
     } else if (strcmp(field, "duty_cycle_ns") == 0) {
-        uint64_t duty_cycle_ns;
-        int ret;
-
         lua_pwm_checktype(L, 3, LUA_TNUMBER);
-        duty_cycle_ns = lua_tounsigned(L, 3);
 
-        if ((ret = pwm_set_duty_cycle_ns(pwm, duty_cycle_ns)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+        lua_pwm_set_duty_cycle_ns(L, handle, lua_tounsigned(L, 3));
 
         return 0;
     } else if (strcmp(field, "period") == 0) {
         double period;
-        int ret;
 
         lua_pwm_checktype(L, 3, LUA_TNUMBER);
         period = lua_tonumber(L, 3);
 
-        if ((ret = pwm_set_period(pwm, period)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+        if (period < 0)
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid period, should be non-negative");
+
+        lua_pwm_set_period_ns(L, handle, (uint64_t)(period * 1e9));
 
         return 0;
     } else if (strcmp(field, "duty_cycle") == 0) {
         double duty_cycle;
-        int ret;
 
         lua_pwm_checktype(L, 3, LUA_TNUMBER);
         duty_cycle = lua_tonumber(L, 3);
 
-        if ((ret = pwm_set_duty_cycle(pwm, duty_cycle)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+        if (duty_cycle < 0.0 || duty_cycle > 1.0)
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid duty cycle, should be between 0.0 and 1.0");
+
+        lua_pwm_set_duty_cycle_ns(L, handle, (uint64_t)(duty_cycle * (double)handle->period_ns));
 
         return 0;
     } else if (strcmp(field, "frequency") == 0) {
         double frequency;
-        int ret;
 
         lua_pwm_checktype(L, 3, LUA_TNUMBER);
         frequency = lua_tonumber(L, 3);
 
-        if ((ret = pwm_set_frequency(pwm, frequency)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+        if (frequency <= 0)
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid frequency, should be positive");
+
+        lua_pwm_set_period_ns(L, handle, (uint64_t)(1e9 / frequency));
 
         return 0;
     } else if (strcmp(field, "polarity") == 0) {
         const char *s;
         pwm_polarity_t polarity;
-        int ret;
 
         lua_pwm_checktype(L, 3, LUA_TSTRING);
         s = lua_tostring(L, 3);
@@ -392,8 +1133,7 @@ static int lua_pwm_newindex(lua_State *L) {
         else
             return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid polarity, should be 'normal' or 'inversed'");
 
-        if ((ret = pwm_set_polarity(pwm, polarity)) < 0)
-            return lua_pwm_error(L, ret, pwm_errno(pwm), "Error: %s", pwm_errmsg(pwm));
+        lua_pwm_set_polarity(L, handle, polarity);
 
         return 0;
     }
@@ -401,10 +1141,257 @@ static int lua_pwm_newindex(lua_State *L) {
     return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: unknown property");
 }
 
+static bool lua_pwm_ispwm(lua_State *L, int index) {
+    bool ispwm;
+
+    if (!lua_isuserdata(L, index) || !lua_getmetatable(L, index))
+        return false;
+
+    luaL_getmetatable(L, "periphery.PWM");
+    ispwm = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);
+
+    return ispwm;
+}
+
+static int lua_pwm_group(lua_State *L) {
+    lua_pwm_group_t *group;
+    unsigned int count;
+
+    lua_pwm_checktype(L, 1, LUA_TTABLE);
+
+    count = luaL_len(L, 1);
+    if (count == 0)
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid group, should have at least one PWM");
+
+    for (unsigned int i = 1; i <= count; i++) {
+        lua_rawgeti(L, 1, i);
+        if (!lua_pwm_ispwm(L, -1))
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid group member %u, should be PWM object", i);
+        lua_pop(L, 1);
+    }
+
+    /* Create handle userdata */
+    group = lua_newuserdata(L, sizeof(lua_pwm_group_t));
+    group->pwms_ref = LUA_NOREF;
+    group->count = 0;
+    group->pwms = NULL;
+    group->bufs = NULL;
+    /* Set PWM Group metatable on it */
+    luaL_getmetatable(L, "periphery.PWM.Group");
+    lua_setmetatable(L, -2);
+
+    group->pwms = calloc(count, sizeof(lua_pwm_t *));
+    group->bufs = calloc(count, sizeof(*group->bufs));
+    if (group->pwms == NULL || group->bufs == NULL)
+        return lua_pwm_error(L, PWM_ERROR_CONFIGURE, errno, "Error: allocating memory");
+
+    /* Copy of the members, referenced to keep them alive */
+    lua_createtable(L, count, 0);
+    for (unsigned int i = 0; i < count; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        group->pwms[i] = (lua_pwm_t *)lua_touserdata(L, -1);
+        lua_rawseti(L, -2, i + 1);
+    }
+    group->pwms_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    group->count = count;
+
+    return 1;
+}
+
+static lua_pwm_group_t *lua_pwm_group_checkopen(lua_State *L, int index) {
+    lua_pwm_group_t *group = luaL_checkudata(L, index, "periphery.PWM.Group");
+
+    if (group->pwms_ref == LUA_NOREF)
+        lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: PWM group is closed");
+
+    return group;
+}
+
+static int lua_pwm_group_set_duty_cycles_common(lua_State *L, bool ratio) {
+    lua_pwm_group_t *group;
+    uint64_t first_ns = 0, last_ns = 0;
+    unsigned int i;
+
+    group = lua_pwm_group_checkopen(L, 1);
+    lua_pwm_checktype(L, 2, LUA_TTABLE);
+
+    if (luaL_len(L, 2) != group->count)
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid number of duty cycles, should be %u", group->count);
+
+    /* Validate and format all values before the first write */
+    for (i = 0; i < group->count; i++) {
+        lua_pwm_t *handle = group->pwms[i];
+        uint64_t duty_cycle_ns;
+
+        if (handle->enable_fd < 0)
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: PWM group member %u is closed", i + 1);
+
+        lua_pwm_check_no_player(L, handle);
+
+        lua_rawgeti(L, 2, i + 1);
+        if (!lua_isnumber(L, -1))
+            return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid duty cycle %u, should be number", i + 1);
+
+        if (ratio) {
+            double value = lua_tonumber(L, -1);
+
+            if (value < 0.0 || value > 1.0)
+                return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid duty cycle %u, should be between 0.0 and 1.0", i + 1);
+
+            duty_cycle_ns = (uint64_t)(value * (double)handle->period_ns);
+        } else {
+            duty_cycle_ns = lua_tounsigned(L, -1);
+
+            if (duty_cycle_ns > handle->period_ns)
+                return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: invalid duty cycle %u, should not exceed period", i + 1);
+        }
+
+        lua_pop(L, 1);
+
+        group->bufs[i].duty_cycle_ns = duty_cycle_ns;
+        group->bufs[i].len = snprintf(group->bufs[i].str, sizeof(group->bufs[i].str), "%" PRIu64 "\n", duty_cycle_ns);
+    }
+
+    /* Write back-to-back, timestamping the completion of the first and last
+     * writes */
+    for (i = 0; i < group->count; i++) {
+        if (pwrite(group->pwms[i]->duty_cycle_fd, group->bufs[i].str, group->bufs[i].len, 0) < 0)
+            break;
+
+        if (i == 0)
+            first_ns = lua_pwm_monotonic_ns();
+    }
+
+    last_ns = lua_pwm_monotonic_ns();
+
+    if (i < group->count) {
+        int errsv = errno;
+
+        for (unsigned int j = 0; j < i; j++)
+            group->pwms[j]->duty_cycle_ns = group->bufs[j].duty_cycle_ns;
+
+        return lua_pwm_error(L, PWM_ERROR_CONFIGURE, errsv, "Error: writing PWM 'duty_cycle' of group member %u: %s [errno %d]", i + 1, strerror(errsv), errsv);
+    }
+
+    for (i = 0; i < group->count; i++)
+        group->pwms[i]->duty_cycle_ns = group->bufs[i].duty_cycle_ns;
+
+    lua_pushunsigned(L, last_ns - first_ns);
+
+    return 1;
+}
+
+static int lua_pwm_group_set_duty_cycles(lua_State *L) {
+    return lua_pwm_group_set_duty_cycles_common(L, true);
+}
+
+static int lua_pwm_group_set_duty_cycles_ns(lua_State *L) {
+    return lua_pwm_group_set_duty_cycles_common(L, false);
+}
+
+static void lua_pwm_group_release(lua_State *L, lua_pwm_group_t *group) {
+    luaL_unref(L, LUA_REGISTRYINDEX, group->pwms_ref);
+    group->pwms_ref = LUA_NOREF;
+    group->count = 0;
+
+    free(group->pwms);
+    group->pwms = NULL;
+    free(group->bufs);
+    group->bufs = NULL;
+}
+
+static int lua_pwm_group_close(lua_State *L) {
+    lua_pwm_group_t *group;
+
+    group = luaL_checkudata(L, 1, "periphery.PWM.Group");
+
+    lua_pwm_group_release(L, group);
+
+    return 0;
+}
+
+static int lua_pwm_group_gc(lua_State *L) {
+    lua_pwm_group_t *group;
+
+    group = luaL_checkudata(L, 1, "periphery.PWM.Group");
+
+    lua_pwm_group_release(L, group);
+
+    return 0;
+}
+
+static int lua_pwm_group_tostring(lua_State *L) {
+    lua_pwm_group_t *group;
+
+    group = luaL_checkudata(L, 1, "periphery.PWM.Group");
+
+    lua_pushfstring(L, "PWM Group (count=%d)", (int)group->count);
+
+    return 1;
+}
+
+static int lua_pwm_group_index(lua_State *L) {
+    lua_pwm_group_t *group;
+    const char *field;
+
+    if (!lua_isstring(L, 2))
+        return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: unknown method or property");
+
+    field = lua_tostring(L, 2);
+
+    /* Look up method in metatable */
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, field);
+    if (!lua_isnil(L, -1))
+        return 1;
+
+    group = luaL_checkudata(L, 1, "periphery.PWM.Group");
+
+    if (strcmp(field, "count") == 0) {
+        lua_pushunsigned(L, group->count);
+        return 1;
+    } else if (strcmp(field, "pwms") == 0) {
+        lua_pwm_group_checkopen(L, 1);
+        /* Return a copy, so the group's members cannot be modified */
+        lua_createtable(L, group->count, 0);
+        lua_rawgeti(L, LUA_REGISTRYINDEX, group->pwms_ref);
+        for (unsigned int i = 1; i <= group->count; i++) {
+            lua_rawgeti(L, -1, i);
+            lua_rawseti(L, -3, i);
+        }
+        lua_pop(L, 1);
+        return 1;
+    }
+
+    return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static int lua_pwm_group_newindex(lua_State *L) {
+    return lua_pwm_error(L, PWM_ERROR_ARG, 0, "Error: immutable property");
+}
+
+static const struct luaL_Reg periphery_pwm_group_m[] = {
+    {"close", lua_pwm_group_close},
+    {"set_duty_cycles", lua_pwm_group_set_duty_cycles},
+    {"set_duty_cycles_ns", lua_pwm_group_set_duty_cycles_ns},
+    {"__gc", lua_pwm_group_gc},
+    {"__tostring", lua_pwm_group_tostring},
+    {"__index", lua_pwm_group_index},
+    {"__newindex", lua_pwm_group_newindex},
+    {NULL, NULL}
+};
+
 static const struct luaL_Reg periphery_pwm_m[] = {
     {"close", lua_pwm_close},
     {"enable", lua_pwm_enable},
     {"disable", lua_pwm_disable},
+    {"configure", lua_pwm_configure},
+    {"ramp", lua_pwm_ramp},
+    {"play", lua_pwm_play},
+    {"wait", lua_pwm_wait},
+    {"stop", lua_pwm_stop},
+    {"group", lua_pwm_group},
     {"__gc", lua_pwm_gc},
     {"__tostring", lua_pwm_tostring},
     {"__index", lua_pwm_index},
@@ -425,6 +1412,19 @@ LUALIB_API int luaopen_periphery_pwm(lua_State *L) {
     lua_pushstring(L, "protected metatable");
     lua_setfield(L, -2, "__metatable");
 
+    /* Create periphery.PWM.Group metatable */
+    luaL_newmetatable(L, "periphery.PWM.Group");
+    /* Set metatable functions */
+    funcs = (const struct luaL_Reg *)periphery_pwm_group_m;
+    for (; funcs->name != NULL; funcs++) {
+        lua_pushcclosure(L, funcs->func, 0);
+        lua_setfield(L, -2, funcs->name);
+    }
+    /* Set metatable properties */
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+    lua_pop(L, 1);
+
     /* Create {__call = lua_pwm_new, __metatable = "protected metatable"} table */
     lua_newtable(L);
     lua_pushcclosure(L, lua_pwm_new, 0);
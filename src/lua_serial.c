@@ -4,6 +4,9 @@
  * License: MIT
  */
 
+/* For ppoll() */
+#define _GNU_SOURCE
+
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
@@ -12,8 +15,20 @@
 #include <string.h>
 #include <stdint.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <asm/termbits.h>
+#include <linux/serial.h>
 
 #include <c-periphery/src/serial.h>
+#include <c-periphery/src/gpio.h>
 #include "lua_periphery.h"
 #include "lua_compat.h"
 
@@ -23,18 +38,55 @@ local Serial = periphery.Serial
 
 -- Constructor
 serial = Serial(device <path string>, baudrate <number>)
-serial = Serial{device=<path string>, baudrate=<number>, databits=8, parity="none", stopbits=1, xonxoff=false, rtscts=false}
+serial = Serial{device=<path string>, baudrate=<number>, databits=8, parity="none", stopbits=1, xonxoff=false, rtscts=false, vmin=0, vtime=0, low_latency=false}
 
 -- Methods
 serial:read(length <number>, [timeout_ms <number|nil>]) --> <string>
 serial:read{length=<length>, timeout_ms=nil} --> <string>
-serial:write(data <string>) --> <number>
+serial:read{length=<length>, total_timeout_ms=nil, interbyte_timeout_us=nil} --> <string>
+serial:read_into(buffer <Buffer>, offset <number>, length <number>, [timeout_ms <number|nil>]) --> <number>
+serial:read_until(delim <string>, [max_len <number|nil>, timeout_ms <number|nil>]) --> <string>
+serial:read_line([max_len <number|nil>, timeout_ms <number|nil>]) --> <string>
+serial:write(data <string|table>) --> <number>
+serial:set_framing(framing <string>, [max_frame_len <number>])
+serial:read_frame([timeout_ms <number|nil>]) --> <string|nil>
+serial:write_frame(data <string>) --> <number>
+serial:set_rs485(options <table>)
+serial:get_rs485() --> <table>
+serial:send_file(path_or_fd <string|number>, [offset <number|nil>, len <number|nil>, progress <function|nil>]) --> <number>
+serial:capture_to_file(path <string>, [bytes <number|nil>, duration_ms <number|nil>, progress <function|nil>]) --> <number>
 serial:poll([timeout_ms <number|nil>]) --> <boolean>
 serial:flush()
 serial:input_waiting() --> <number>
 serial:output_waiting() --> <number>
 serial:close()
 
+-- Static methods
+Serial.poll_multiple(serials <table>, [timeout_ms <number|nil>]) --> <table>
+
+-- Poll set constructor
+pollset = Serial.PollSet([serials <table|nil>])
+
+-- Poll set methods
+pollset:add(serial <Serial object>)
+pollset:remove(serial <Serial object>)
+pollset:wait([timeout_ms <number|nil>]) --> <table>
+pollset:close()
+
+-- Poll set properties
+pollset.fd          immutable <number>
+pollset.count       immutable <number>
+
+-- Byte buffer constructor
+buffer = Serial.Buffer(size <number>)
+
+-- Byte buffer methods
+buffer:sub([i <number>, j <number>]) --> <string>
+buffer[index]       mutable <number>
+
+-- Byte buffer properties
+buffer.size         immutable <number>
+
 -- Properties
 serial.baudrate     mutable <number>
 serial.databits     mutable <number>
@@ -42,6 +94,10 @@ serial.parity       mutable <string>
 serial.stopbits     mutable <number>
 serial.xonxoff      mutable <boolean>
 serial.rtscts       mutable <boolean>
+serial.vmin         mutable <number>
+serial.vtime        mutable <number>
+serial.low_latency  mutable <boolean>
+serial.framing      mutable <string>
 serial.fd           immutable <number>
 */
 
@@ -58,6 +114,93 @@ static const char *serial_error_code_strings[] = {
     [-SERIAL_ERROR_ALLOC]       = "SERIAL_ERROR_ALLOC",
 };
 
+typedef enum lua_serial_framing {
+    SERIAL_FRAMING_NONE,
+    SERIAL_FRAMING_COBS,
+    SERIAL_FRAMING_SLIP,
+    SERIAL_FRAMING_U8,
+    SERIAL_FRAMING_U16LE,
+    SERIAL_FRAMING_U16BE,
+    SERIAL_FRAMING_U32LE,
+    SERIAL_FRAMING_U32BE,
+} lua_serial_framing_t;
+
+static const char *lua_serial_framing_strings[] = {
+    [SERIAL_FRAMING_NONE]   = "none",
+    [SERIAL_FRAMING_COBS]   = "cobs",
+    [SERIAL_FRAMING_SLIP]   = "slip",
+    [SERIAL_FRAMING_U8]     = "u8",
+    [SERIAL_FRAMING_U16LE]  = "u16le",
+    [SERIAL_FRAMING_U16BE]  = "u16be",
+    [SERIAL_FRAMING_U32LE]  = "u32le",
+    [SERIAL_FRAMING_U32BE]  = "u32be",
+};
+
+#define SERIAL_FRAMING_DEFAULT_MAX_FRAME_LEN    4096
+
+#define SLIP_END        0xc0
+#define SLIP_ESC        0xdb
+#define SLIP_ESC_END    0xdc
+#define SLIP_ESC_ESC    0xdd
+
+typedef enum lua_serial_rs485_mode {
+    SERIAL_RS485_NONE,
+    SERIAL_RS485_KERNEL,
+    SERIAL_RS485_GPIO,
+} lua_serial_rs485_mode_t;
+
+/* Serial userdata. The serial_t handle must remain the first member, so that
+ * the userdata can be dereferenced as a serial_t ** by the methods below. */
+typedef struct lua_serial {
+    serial_t *serial;
+
+    /* Receive buffer of bytes read from the port but not yet returned to the
+     * user, held at rx_buf[rx_start .. rx_start + rx_len) */
+    uint8_t *rx_buf;
+    size_t rx_start;
+    size_t rx_len;
+    size_t rx_size;
+    /* Number of buffered bytes already searched for a frame delimiter */
+    size_t rx_scanned;
+    /* In the registry set of serial ports with buffered bytes */
+    bool rx_tracked;
+
+    /* Framing of read_frame() and write_frame() */
+    lua_serial_framing_t framing;
+    size_t max_frame_len;
+    /* Discarding a partial frame until the next frame delimiter */
+    bool rx_discarding;
+
+    /* GPIO-assisted RS-485 driver enable, for drivers without TIOCSRS485 */
+    lua_serial_rs485_mode_t rs485_mode;
+    gpio_t *rs485_gpio;
+    int rs485_gpio_ref;
+    bool rs485_rts_on_send;
+    bool rs485_rts_after_send;
+    unsigned int rs485_delay_before_send_ms;
+    unsigned int rs485_delay_after_send_ms;
+} lua_serial_t;
+
+/* Serial byte buffer userdata, for read_into() */
+typedef struct lua_serial_buffer {
+    size_t size;
+    uint8_t data[];
+} lua_serial_buffer_t;
+
+/* Serial poll set userdata */
+typedef struct lua_serial_pollset {
+    lua_periphery_epoll_set_t set;
+    /* Registry reference to table of ready serial ports, reused across waits */
+    int ready_ref;
+} lua_serial_pollset_t;
+
+#define SERIAL_RX_CHUNK_SIZE    4096
+/* Size an empty receive buffer is shrunk back to once reads are no longer
+ * larger, so that the buffer of a large read is not kept */
+#define SERIAL_RX_RETAIN_SIZE   65536
+#define SERIAL_WRITEV_MAX_IOV   64
+#define SERIAL_FILE_CHUNK_SIZE  65536
+
 static int lua_serial_error(lua_State *L, enum serial_error_code code, int c_errno, const char *fmt, ...) {
     char message[128];
     va_list ap;
@@ -91,6 +234,277 @@ static void lua_serial_checktype(lua_State *L, int index, int type) {
         lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid argument #%d (%s expected, got %s)", index, lua_typename(L, type), lua_typename(L, lua_type(L, index)));
 }
 
+static int lua_serial_rx_reserve(lua_serial_t *handle, size_t len) {
+    uint8_t *rx_buf;
+    size_t rx_size;
+
+    /* Shrink an empty receive buffer grown by earlier large reads, once a
+     * read fits in the retained size, so repeated large reads keep the
+     * buffer and do not allocate on every call */
+    if (handle->rx_len == 0 && handle->rx_size > SERIAL_RX_RETAIN_SIZE && len <= SERIAL_RX_RETAIN_SIZE) {
+        if ((rx_buf = realloc(handle->rx_buf, SERIAL_RX_RETAIN_SIZE)) != NULL) {
+            handle->rx_buf = rx_buf;
+            handle->rx_size = SERIAL_RX_RETAIN_SIZE;
+        }
+        handle->rx_start = 0;
+    }
+
+    if (handle->rx_size - handle->rx_start - handle->rx_len >= len)
+        return 0;
+
+    /* Move buffered bytes to the front, if that makes enough room */
+    if (handle->rx_size - handle->rx_len >= len) {
+        memmove(handle->rx_buf, handle->rx_buf + handle->rx_start, handle->rx_len);
+        handle->rx_start = 0;
+        return 0;
+    }
+
+    rx_size = (handle->rx_size > 0) ? handle->rx_size * 2 : SERIAL_RX_CHUNK_SIZE;
+    if (rx_size < handle->rx_len + len)
+        rx_size = handle->rx_len + len;
+
+    if ((rx_buf = malloc(rx_size)) == NULL)
+        return -1;
+
+    if (handle->rx_len > 0)
+        memcpy(rx_buf, handle->rx_buf + handle->rx_start, handle->rx_len);
+    free(handle->rx_buf);
+
+    handle->rx_buf = rx_buf;
+    handle->rx_start = 0;
+    handle->rx_size = rx_size;
+
+    return 0;
+}
+
+static void lua_serial_rx_consume(lua_serial_t *handle, size_t len) {
+    handle->rx_start += len;
+    handle->rx_len -= len;
+    handle->rx_scanned = 0;
+
+    if (handle->rx_len == 0)
+        handle->rx_start = 0;
+}
+
+/* Add the serial port to the registry set of serial ports with buffered
+ * bytes, so that poll sets find them without visiting every port. Called by
+ * the methods after appending to the receive buffer, with the serial port at
+ * stack index 1. Entries are removed lazily by lua_periphery_serial_ready(). */
+static void lua_serial_rx_track(lua_State *L, lua_serial_t *handle) {
+    if (handle->rx_len == 0 || handle->rx_tracked)
+        return;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, "periphery.Serial.buffered");
+    lua_pushvalue(L, 1);
+    lua_pushboolean(L, 1);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    handle->rx_tracked = true;
+}
+
+/* Wait up to timeout_ms for data, and append the bytes available to the
+ * receive buffer. Returns the number of bytes appended, or zero on timeout. */
+static size_t lua_serial_rx_fill(lua_State *L, lua_serial_t *handle, int timeout_ms) {
+    int ret;
+
+    if (lua_serial_rx_reserve(handle, SERIAL_RX_CHUNK_SIZE) < 0)
+        return lua_serial_error(L, SERIAL_ERROR_ALLOC, errno, "Error: allocating memory");
+
+    if ((ret = serial_poll(handle->serial, timeout_ms)) < 0)
+        return lua_serial_error(L, ret, serial_errno(handle->serial), "Error: %s", serial_errmsg(handle->serial));
+    else if (ret == 0)
+        return 0;
+
+    if ((ret = serial_read(handle->serial, handle->rx_buf + handle->rx_start + handle->rx_len, SERIAL_RX_CHUNK_SIZE, 0)) < 0)
+        return lua_serial_error(L, ret, serial_errno(handle->serial), "Error: %s", serial_errmsg(handle->serial));
+
+    handle->rx_len += ret;
+    lua_serial_rx_track(L, handle);
+
+    return ret;
+}
+
+static uint64_t lua_serial_monotonic_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static int lua_serial_remaining_ms(int timeout_ms, uint64_t deadline_ms) {
+    uint64_t now_ms;
+
+    if (timeout_ms < 0)
+        return -1;
+
+    now_ms = lua_serial_monotonic_ms();
+
+    return (now_ms < deadline_ms) ? (int)(deadline_ms - now_ms) : 0;
+}
+
+static bool lua_serial_find(const uint8_t *data, size_t len, const uint8_t *delim, size_t delim_len, size_t start, size_t *pos) {
+    const uint8_t *p = data + start;
+    const uint8_t *end = data + len;
+
+    while (p < end && (size_t)(end - p) >= delim_len) {
+        if ((p = memchr(p, delim[0], (end - p) - delim_len + 1)) == NULL)
+            return false;
+
+        if (memcmp(p, delim, delim_len) == 0) {
+            *pos = p - data;
+            return true;
+        }
+
+        p++;
+    }
+
+    return false;
+}
+
+/* Fill the receive buffer until it contains the delimiter within max_len
+ * bytes, max_len bytes are buffered, or the timeout expires. Returns the
+ * number of bytes at the head of the receive buffer to be returned, which
+ * include the delimiter if found. */
+static size_t lua_serial_rx_until(lua_State *L, lua_serial_t *handle, const uint8_t *delim, size_t delim_len, size_t max_len, int timeout_ms, bool *found) {
+    uint64_t deadline_ms = lua_serial_monotonic_ms() + ((timeout_ms > 0) ? timeout_ms : 0);
+    size_t searched = 0;
+
+    while (true) {
+        size_t limit = (max_len > 0 && handle->rx_len > max_len) ? max_len : handle->rx_len;
+        size_t pos;
+
+        if (lua_serial_find(handle->rx_buf + handle->rx_start, limit, delim, delim_len, searched, &pos)) {
+            *found = true;
+            return pos + delim_len;
+        }
+
+        if (max_len > 0 && limit == max_len)
+            break;
+
+        /* Resume search where a delimiter could still start */
+        searched = (limit >= delim_len) ? limit - delim_len + 1 : 0;
+
+        if (lua_serial_rx_fill(L, handle, lua_serial_remaining_ms(timeout_ms, deadline_ms)) == 0)
+            break;
+    }
+
+    *found = false;
+
+    return (max_len > 0 && handle->rx_len > max_len) ? max_len : handle->rx_len;
+}
+
+static const uint32_t lua_serial_standard_baudrates[] = {
+    50, 75, 110, 134, 150, 200, 300, 600, 1200, 1800, 2400, 4800, 9600, 19200,
+    38400, 57600, 115200, 230400, 460800, 500000, 576000, 921600, 1000000,
+    1152000, 1500000, 2000000, 2500000, 3000000, 3500000, 4000000,
+};
+
+static bool lua_serial_is_standard_baudrate(uint32_t baudrate) {
+    unsigned int i;
+
+    for (i = 0; i < sizeof(lua_serial_standard_baudrates)/sizeof(lua_serial_standard_baudrates[0]); i++) {
+        if (lua_serial_standard_baudrates[i] == baudrate)
+            return true;
+    }
+
+    return false;
+}
+
+/* Set an arbitrary baudrate with the termios2 BOTHER interface, for
+ * baudrates not supported by the standard termios interface */
+static int lua_serial_set_custom_baudrate(serial_t *serial, uint32_t baudrate) {
+#if defined(TCGETS2) && defined(BOTHER)
+    struct termios2 termios2_settings;
+
+    if (ioctl(serial_fd(serial), TCGETS2, &termios2_settings) < 0)
+        return SERIAL_ERROR_QUERY;
+
+    /* Output speed, with input speed equal to output speed */
+    termios2_settings.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    termios2_settings.c_cflag |= BOTHER;
+    termios2_settings.c_ospeed = baudrate;
+    termios2_settings.c_ispeed = baudrate;
+
+    if (ioctl(serial_fd(serial), TCSETS2, &termios2_settings) < 0)
+        return SERIAL_ERROR_CONFIGURE;
+
+    return 0;
+#else
+    errno = EINVAL;
+    return SERIAL_ERROR_ARG;
+#endif
+}
+
+/* Get the output baudrate in effect, which for arbitrary baudrates is the
+ * rate achieved by the driver */
+static int lua_serial_get_baudrate(serial_t *serial, uint32_t *baudrate) {
+#if defined(TCGETS2) && defined(BOTHER)
+    struct termios2 termios2_settings;
+
+    if (ioctl(serial_fd(serial), TCGETS2, &termios2_settings) == 0) {
+        *baudrate = termios2_settings.c_ospeed;
+        return 0;
+    }
+#endif
+
+    return serial_get_baudrate(serial, baudrate);
+}
+
+static int lua_serial_set_baudrate(lua_State *L, serial_t *serial, uint32_t baudrate) {
+    int ret;
+
+    if (lua_serial_is_standard_baudrate(baudrate)) {
+        if ((ret = serial_set_baudrate(serial, baudrate)) < 0)
+            return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+    } else {
+        if ((ret = lua_serial_set_custom_baudrate(serial, baudrate)) < 0)
+            return lua_serial_error(L, ret, errno, "Error: setting baudrate %u: %s [errno %d]", (unsigned int)baudrate, strerror(errno), errno);
+    }
+
+    return 0;
+}
+
+static int lua_serial_get_low_latency(serial_t *serial, bool *low_latency) {
+    struct serial_struct ss;
+
+    /* Drivers without TIOCGSERIAL support have no low latency mode */
+    if (ioctl(serial_fd(serial), TIOCGSERIAL, &ss) < 0) {
+        if (errno != ENOTTY && errno != EINVAL)
+            return SERIAL_ERROR_QUERY;
+
+        *low_latency = false;
+        return 0;
+    }
+
+    *low_latency = (ss.flags & ASYNC_LOW_LATENCY) != 0;
+
+    return 0;
+}
+
+static int lua_serial_set_low_latency(serial_t *serial, bool low_latency) {
+    struct serial_struct ss;
+
+    if (ioctl(serial_fd(serial), TIOCGSERIAL, &ss) < 0) {
+        /* Disabling low latency on a driver without support is a no-op */
+        if (!low_latency && (errno == ENOTTY || errno == EINVAL))
+            return 0;
+
+        return SERIAL_ERROR_CONFIGURE;
+    }
+
+    if (low_latency)
+        ss.flags |= ASYNC_LOW_LATENCY;
+    else
+        ss.flags &= ~ASYNC_LOW_LATENCY;
+
+    if (ioctl(serial_fd(serial), TIOCSSERIAL, &ss) < 0)
+        return SERIAL_ERROR_CONFIGURE;
+
+    return 0;
+}
+
 static int lua_serial_open(lua_State *L) {
     serial_t *serial;
     const char *device;
@@ -100,6 +514,9 @@ static int lua_serial_open(lua_State *L) {
     int stopbits;
     bool xonxoff;
     bool rtscts;
+    unsigned int vmin;
+    float vtime;
+    bool low_latency;
     int ret;
 
     serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
@@ -110,6 +527,9 @@ static int lua_serial_open(lua_State *L) {
     stopbits = 1;
     xonxoff = false;
     rtscts = false;
+    vmin = 0;
+    vtime = 0;
+    low_latency = false;
 
     /* Arguments passed in table form */
     if (lua_istable(L, 2)) {
@@ -166,6 +586,27 @@ static int lua_serial_open(lua_State *L) {
         else if (!lua_isnil(L, -1))
             return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'rtscts', should be boolean");
 
+        /* Optional vmin */
+        lua_getfield(L, 2, "vmin");
+        if (lua_isnumber(L, -1))
+            vmin = lua_tounsigned(L, -1);
+        else if (!lua_isnil(L, -1))
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'vmin', should be number");
+
+        /* Optional vtime */
+        lua_getfield(L, 2, "vtime");
+        if (lua_isnumber(L, -1))
+            vtime = lua_tonumber(L, -1);
+        else if (!lua_isnil(L, -1))
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'vtime', should be number");
+
+        /* Optional low_latency */
+        lua_getfield(L, 2, "low_latency");
+        if (lua_isboolean(L, -1))
+            low_latency = lua_toboolean(L, -1);
+        else if (!lua_isnil(L, -1))
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'low_latency', should be boolean");
+
     /* Arguments passed normally */
     } else {
         lua_serial_checktype(L, 2, LUA_TSTRING);
@@ -175,9 +616,32 @@ static int lua_serial_open(lua_State *L) {
         baudrate = lua_tounsigned(L, 3);
     }
 
-    if ((ret = serial_open_advanced(serial, device, baudrate, databits, parity, stopbits, xonxoff, rtscts)) < 0)
+    if (baudrate == 0)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid baudrate, should be positive");
+
+    /* Open with a placeholder standard baudrate for arbitrary baudrates */
+    if ((ret = serial_open_advanced(serial, device, lua_serial_is_standard_baudrate(baudrate) ? baudrate : 9600, databits, parity, stopbits, xonxoff, rtscts)) < 0)
         return lua_serial_error(L, ret, serial_errno(serial), serial_errmsg(serial));
 
+    if (!lua_serial_is_standard_baudrate(baudrate) && (ret = lua_serial_set_custom_baudrate(serial, baudrate)) < 0) {
+        int errsv = errno;
+        serial_close(serial);
+        return lua_serial_error(L, ret, errsv, "Error: setting baudrate %u: %s [errno %d]", (unsigned int)baudrate, strerror(errsv), errsv);
+    }
+
+    if ((vmin != 0 && (ret = serial_set_vmin(serial, vmin)) < 0) || (vtime != 0 && (ret = serial_set_vtime(serial, vtime)) < 0)) {
+        /* serial_close() leaves the error message of a failed call intact */
+        int errsv = serial_errno(serial);
+        serial_close(serial);
+        return lua_serial_error(L, ret, errsv, "Error: %s", serial_errmsg(serial));
+    }
+
+    if (low_latency && (ret = lua_serial_set_low_latency(serial, true)) < 0) {
+        int errsv = errno;
+        serial_close(serial);
+        return lua_serial_error(L, ret, errsv, "Error: setting low latency: %s [errno %d]", strerror(errsv), errsv);
+    }
+
     return 0;
 }
 
@@ -186,8 +650,20 @@ static int lua_serial_new(lua_State *L) {
     lua_remove(L, 1);
 
     /* Create handle userdata */
-    serial_t **serial = lua_newuserdata(L, sizeof(serial_t *));
-    *serial = serial_new();
+    lua_serial_t *handle = lua_newuserdata(L, sizeof(lua_serial_t));
+    handle->serial = serial_new();
+    handle->rx_buf = NULL;
+    handle->rx_start = 0;
+    handle->rx_len = 0;
+    handle->rx_size = 0;
+    handle->rx_scanned = 0;
+    handle->rx_tracked = false;
+    handle->framing = SERIAL_FRAMING_NONE;
+    handle->max_frame_len = SERIAL_FRAMING_DEFAULT_MAX_FRAME_LEN;
+    handle->rx_discarding = false;
+    handle->rs485_mode = SERIAL_RS485_NONE;
+    handle->rs485_gpio = NULL;
+    handle->rs485_gpio_ref = LUA_NOREF;
     /* Set SERIAL metatable on it */
     luaL_getmetatable(L, "periphery.Serial");
     lua_setmetatable(L, -2);
@@ -203,17 +679,146 @@ static int lua_serial_new(lua_State *L) {
     return 1;
 }
 
+/* Read up to len bytes with serial_read() semantics, appending them to the
+ * receive buffer after any bytes already buffered, so reads need no allocation
+ * once the receive buffer has grown to the read size. Returns the number of
+ * bytes available at the front of the receive buffer, up to len. */
+static size_t lua_serial_rx_read(lua_State *L, lua_serial_t *handle, size_t len, int timeout_ms) {
+    int ret;
+
+    /* Serve the read from the receive buffer first */
+    if (handle->rx_len >= len)
+        return len;
+
+    if (lua_serial_rx_reserve(handle, len - handle->rx_len) < 0)
+        return lua_serial_error(L, SERIAL_ERROR_ALLOC, errno, "Error: allocating memory");
+
+    if ((ret = serial_read(handle->serial, handle->rx_buf + handle->rx_start + handle->rx_len, len - handle->rx_len, timeout_ms)) < 0)
+        return lua_serial_error(L, ret, serial_errno(handle->serial), "Error: %s", serial_errmsg(handle->serial));
+
+    handle->rx_len += ret;
+    lua_serial_rx_track(L, handle);
+
+    return handle->rx_len;
+}
+
+static uint64_t lua_serial_monotonic_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* Read up to len bytes into the receive buffer, as with lua_serial_rx_read(),
+ * until the total timeout expires, or the interbyte timeout expires after the
+ * last bytes received. A negative timeout is disabled. Returns the number of
+ * bytes available at the front of the receive buffer, up to len. */
+static size_t lua_serial_rx_read_interbyte(lua_State *L, lua_serial_t *handle, size_t len, int total_timeout_ms, int64_t interbyte_timeout_us) {
+    int fd = serial_fd(handle->serial);
+    uint64_t now_us, deadline_us, last_us;
+    bool received;
+
+    /* Serve the read from the receive buffer first */
+    if (handle->rx_len >= len)
+        return len;
+
+    if (lua_serial_rx_reserve(handle, len - handle->rx_len) < 0)
+        return lua_serial_error(L, SERIAL_ERROR_ALLOC, errno, "Error: allocating memory");
+
+    now_us = lua_serial_monotonic_us();
+    deadline_us = now_us + ((total_timeout_ms > 0) ? (uint64_t)total_timeout_ms * 1000 : 0);
+    /* Buffered bytes count as received at the start of the read */
+    received = handle->rx_len > 0;
+    last_us = now_us;
+
+    while (handle->rx_len < len) {
+        int64_t wait_us = -1;
+        struct timespec ts;
+        struct pollfd fds[1];
+        int ret;
+
+        if (total_timeout_ms >= 0)
+            wait_us = (now_us < deadline_us) ? (int64_t)(deadline_us - now_us) : 0;
+
+        if (received && interbyte_timeout_us >= 0) {
+            int64_t interbyte_wait_us = (int64_t)(last_us + interbyte_timeout_us) - (int64_t)now_us;
+
+            if (interbyte_wait_us < 0)
+                interbyte_wait_us = 0;
+            if (wait_us < 0 || interbyte_wait_us < wait_us)
+                wait_us = interbyte_wait_us;
+        }
+
+        ts.tv_sec = wait_us / 1000000;
+        ts.tv_nsec = (wait_us % 1000000) * 1000;
+
+        fds[0].fd = fd;
+        fds[0].events = POLLIN | POLLPRI;
+
+        if ((ret = ppoll(fds, 1, (wait_us < 0) ? NULL : &ts, NULL)) < 0) {
+            if (errno == EINTR) {
+                now_us = lua_serial_monotonic_us();
+                continue;
+            }
+
+            return lua_serial_error(L, SERIAL_ERROR_IO, errno, "Error: polling serial port: %s [errno %d]", strerror(errno), errno);
+        } else if (ret == 0) {
+            break;
+        }
+
+        if ((ret = serial_read(handle->serial, handle->rx_buf + handle->rx_start + handle->rx_len, len - handle->rx_len, 0)) < 0)
+            return lua_serial_error(L, ret, serial_errno(handle->serial), "Error: %s", serial_errmsg(handle->serial));
+
+        now_us = lua_serial_monotonic_us();
+
+        if (ret > 0) {
+            handle->rx_len += ret;
+            lua_serial_rx_track(L, handle);
+            received = true;
+            last_us = now_us;
+        }
+
+        if (total_timeout_ms >= 0 && now_us >= deadline_us)
+            break;
+    }
+
+    return (handle->rx_len < len) ? handle->rx_len : len;
+}
+
+/* Continuation of read() in a periphery.loop task, with the length at index
+ * 2 and the deadline at index 3 */
+static int lua_serial_read_k(lua_State *L) {
+    lua_serial_t *handle;
+    size_t len, avail;
+    int remaining_ms;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    len = lua_tounsigned(L, 2);
+
+    avail = lua_serial_rx_read(L, handle, len, 0);
+    remaining_ms = lua_periphery_loop_remaining(lua_tonumber(L, 3));
+
+    if (avail >= len || remaining_ms == 0) {
+        lua_pushlstring(L, (avail > 0) ? (char *)handle->rx_buf + handle->rx_start : "", avail);
+        lua_serial_rx_consume(handle, avail);
+        return 1;
+    }
+
+    return lua_periphery_loop_wait(L, serial_fd(handle->serial), POLLIN, remaining_ms, lua_serial_read_k);
+}
+
 static int lua_serial_read(lua_State *L) {
-    serial_t *serial;
-    uint8_t *buf;
+    lua_serial_t *handle;
     size_t len;
     int timeout_ms;
-    int ret;
+    int64_t interbyte_timeout_us;
 
-    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
 
-    /* Default timeout */
+    /* Default timeouts */
     timeout_ms = -1;
+    interbyte_timeout_us = -1;
 
     /* Arguments passed in table form */
     if (lua_istable(L, 2)) {
@@ -223,8 +828,12 @@ static int lua_serial_read(lua_State *L) {
 
         len = lua_tounsigned(L, -1);
 
-        /* Optional timeout argument */
-        lua_getfield(L, 2, "timeout");
+        /* Optional timeout argument, also accepted as 'timeout' */
+        lua_getfield(L, 2, "timeout_ms");
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            lua_getfield(L, 2, "timeout");
+        }
         if (lua_isnil(L, -1))
             ;
         else if (lua_isnumber(L, -1))
@@ -232,6 +841,24 @@ static int lua_serial_read(lua_State *L) {
         else
             return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'timeout_ms', should be nil or number");
 
+        /* Optional total timeout argument */
+        lua_getfield(L, 2, "total_timeout_ms");
+        if (lua_isnil(L, -1))
+            ;
+        else if (lua_isnumber(L, -1))
+            timeout_ms = lua_tointeger(L, -1);
+        else
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'total_timeout_ms', should be nil or number");
+
+        /* Optional interbyte timeout argument */
+        lua_getfield(L, 2, "interbyte_timeout_us");
+        if (lua_isnil(L, -1))
+            ;
+        else if (lua_isnumber(L, -1))
+            interbyte_timeout_us = lua_tointeger(L, -1);
+        else
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'interbyte_timeout_us', should be nil or number");
+
     /* Arguments passed normally */
     } else {
         lua_serial_checktype(L, 2, LUA_TNUMBER);
@@ -247,87 +874,1418 @@ static int lua_serial_read(lua_State *L) {
             return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
     }
 
-    if ((buf = malloc(len)) == NULL)
-        return lua_serial_error(L, SERIAL_ERROR_ALLOC, errno, "Error: allocating memory");
-
-    if ((ret = serial_read(serial, buf, len, timeout_ms)) < 0) {
-        free(buf);
-        return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+    /* Yield to the scheduler instead of blocking, in a periphery.loop task */
+    if (interbyte_timeout_us < 0 && timeout_ms != 0 && lua_periphery_loop_can_yield(L)) {
+        lua_settop(L, 1);
+        lua_pushunsigned(L, len);
+        lua_pushnumber(L, lua_periphery_loop_deadline(timeout_ms));
+        return lua_serial_read_k(L);
     }
 
-    lua_pushlstring(L, (char *)buf, ret);
+    if (interbyte_timeout_us >= 0)
+        len = lua_serial_rx_read_interbyte(L, handle, len, timeout_ms, interbyte_timeout_us);
+    else
+        len = lua_serial_rx_read(L, handle, len, timeout_ms);
 
-    free(buf);
+    lua_pushlstring(L, (len > 0) ? (char *)handle->rx_buf + handle->rx_start : "", len);
+    lua_serial_rx_consume(handle, len);
 
     return 1;
 }
 
-static int lua_serial_write(lua_State *L) {
-    serial_t *serial;
-    const uint8_t *buf;
-    size_t len;
+static int lua_serial_read_into(lua_State *L) {
+    lua_serial_t *handle;
+    lua_serial_buffer_t *buffer;
+    lua_Integer offset;
+    size_t len, copied;
+    uint8_t *dst;
+    int timeout_ms;
     int ret;
 
-    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
-    lua_serial_checktype(L, 2, LUA_TSTRING);
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    buffer = (lua_serial_buffer_t *)luaL_checkudata(L, 2, "periphery.Serial.Buffer");
+    lua_serial_checktype(L, 3, LUA_TNUMBER);
+    lua_serial_checktype(L, 4, LUA_TNUMBER);
 
-    buf = (const uint8_t *)lua_tolstring(L, 2, &len);
+    offset = lua_tointeger(L, 3);
+    len = lua_tounsigned(L, 4);
 
-    if ((ret = serial_write(serial, buf, len)) < 0)
-        return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+    if (offset < 1 || (size_t)(offset - 1) > buffer->size || len > buffer->size - (size_t)(offset - 1))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid offset or length, exceeds buffer size");
 
-    lua_pushinteger(L, ret);
-    return 1;
-}
+    /* Optional timeout argument */
+    if (lua_isnone(L, 5) || lua_isnil(L, 5))
+        timeout_ms = -1;
+    else if (lua_isnumber(L, 5))
+        timeout_ms = lua_tointeger(L, 5);
+    else
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
 
-static int lua_serial_flush(lua_State *L) {
-    serial_t *serial;
-    int ret;
+    dst = buffer->data + (offset - 1);
 
-    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
+    /* Serve the read from the receive buffer first */
+    copied = (handle->rx_len < len) ? handle->rx_len : len;
+    if (copied > 0) {
+        memcpy(dst, handle->rx_buf + handle->rx_start, copied);
+        lua_serial_rx_consume(handle, copied);
+    }
 
-    if ((ret = serial_flush(serial)) < 0)
-        return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+    /* Read the rest directly into the byte buffer */
+    if (copied < len) {
+        if ((ret = serial_read(handle->serial, dst + copied, len - copied, timeout_ms)) < 0)
+            return lua_serial_error(L, ret, serial_errno(handle->serial), "Error: %s", serial_errmsg(handle->serial));
 
-    return 0;
-}
+        copied += ret;
+    }
 
-static int lua_serial_input_waiting(lua_State *L) {
-    serial_t *serial;
-    unsigned int count;
-    int ret;
+    lua_pushunsigned(L, copied);
 
-    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
+    return 1;
+}
 
-    if ((ret = serial_input_waiting(serial, &count)) < 0)
-        return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+static void lua_serial_check_read_until_args(lua_State *L, int index, size_t *max_len, int *timeout_ms) {
+    /* Optional max_len argument */
+    if (lua_isnone(L, index) || lua_isnil(L, index))
+        *max_len = 0;
+    else if (lua_isnumber(L, index))
+        *max_len = lua_tounsigned(L, index);
+    else
+        lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'max_len', should be number or nil");
 
-    lua_pushinteger(L, count);
-    return 1;
+    /* Optional timeout argument */
+    if (lua_isnone(L, index+1) || lua_isnil(L, index+1))
+        *timeout_ms = -1;
+    else if (lua_isnumber(L, index+1))
+        *timeout_ms = lua_tointeger(L, index+1);
+    else
+        lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
 }
 
-static int lua_serial_output_waiting(lua_State *L) {
-    serial_t *serial;
-    unsigned int count;
-    int ret;
+static int lua_serial_read_until(lua_State *L) {
+    lua_serial_t *handle;
+    const uint8_t *delim;
+    size_t delim_len;
+    size_t max_len;
+    int timeout_ms;
+    size_t len;
+    bool found;
 
-    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    lua_serial_checktype(L, 2, LUA_TSTRING);
 
-    if ((ret = serial_output_waiting(serial, &count)) < 0)
-        return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+    delim = (const uint8_t *)lua_tolstring(L, 2, &delim_len);
+    if (delim_len == 0)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid delimiter, should be non-empty");
 
-    lua_pushinteger(L, count);
+    lua_serial_check_read_until_args(L, 3, &max_len, &timeout_ms);
+
+    len = lua_serial_rx_until(L, handle, delim, delim_len, max_len, timeout_ms, &found);
+
+    lua_pushlstring(L, (char *)handle->rx_buf + handle->rx_start, len);
+    lua_serial_rx_consume(handle, len);
 
     return 1;
 }
 
-static int lua_serial_poll(lua_State *L) {
+static int lua_serial_read_line(lua_State *L) {
+    lua_serial_t *handle;
+    size_t max_len;
+    int timeout_ms;
+    size_t len, line_len;
+    bool found;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+
+    lua_serial_check_read_until_args(L, 2, &max_len, &timeout_ms);
+
+    len = lua_serial_rx_until(L, handle, (const uint8_t *)"\n", 1, max_len, timeout_ms, &found);
+
+    /* Strip the line terminator */
+    line_len = len;
+    if (found) {
+        line_len--;
+        if (line_len > 0 && handle->rx_buf[handle->rx_start + line_len - 1] == '\r')
+            line_len--;
+    }
+
+    lua_pushlstring(L, (char *)handle->rx_buf + handle->rx_start, line_len);
+    lua_serial_rx_consume(handle, len);
+
+    return 1;
+}
+
+int lua_periphery_serial_buffered(lua_State *L, int index) {
+    bool isserial;
+
+    if (!lua_isuserdata(L, index) || !lua_getmetatable(L, index))
+        return -1;
+
+    luaL_getmetatable(L, "periphery.Serial");
+    isserial = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);
+
+    if (!isserial)
+        return -1;
+
+    return ((lua_serial_t *)lua_touserdata(L, index))->rx_len;
+}
+
+unsigned int lua_periphery_serial_ready(lua_State *L, int handles_index, int ready_index, int revents_index, unsigned int count) {
+    lua_getfield(L, LUA_REGISTRYINDEX, "periphery.Serial.buffered");
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        return count;
+    }
+
+    lua_pushnil(L);
+    while (lua_next(L, -2) != 0) {
+        lua_serial_t *handle = (lua_serial_t *)lua_touserdata(L, -2);
+
+        lua_pop(L, 1);
+
+        /* Drop serial ports whose receive buffer was emptied */
+        if (handle->rx_len == 0) {
+            handle->rx_tracked = false;
+            lua_pushvalue(L, -1);
+            lua_pushnil(L);
+            lua_rawset(L, -4);
+            continue;
+        }
+
+        lua_pushvalue(L, -1);
+        lua_rawget(L, handles_index);
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            continue;
+        }
+        lua_pop(L, 1);
+
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, ready_index, ++count);
+        if (revents_index != 0) {
+            lua_pushunsigned(L, POLLIN);
+            lua_rawseti(L, revents_index, count);
+        }
+    }
+
+    lua_pop(L, 1);
+
+    return count;
+}
+
+static bool lua_serial_isgpio(lua_State *L, int index) {
+    bool ret;
+
+    if (!lua_isuserdata(L, index) || !lua_getmetatable(L, index))
+        return false;
+
+    luaL_getmetatable(L, "periphery.GPIO");
+    ret = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);
+
+    return ret;
+}
+
+static void lua_serial_sleep_ms(unsigned int ms) {
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+/* Assert the driver enable GPIO before a transmit in GPIO-assisted RS-485
+ * mode */
+static void lua_serial_rs485_begin(lua_State *L, lua_serial_t *handle) {
+    int ret;
+
+    if (handle->rs485_mode != SERIAL_RS485_GPIO)
+        return;
+
+    if ((ret = gpio_write(handle->rs485_gpio, handle->rs485_rts_on_send)) < 0)
+        lua_serial_error(L, SERIAL_ERROR_IO, gpio_errno(handle->rs485_gpio), "Error: writing RS-485 GPIO: %s", gpio_errmsg(handle->rs485_gpio));
+
+    if (handle->rs485_delay_before_send_ms > 0)
+        lua_serial_sleep_ms(handle->rs485_delay_before_send_ms);
+}
+
+/* Wait for the transmit to drain and release the driver enable GPIO in
+ * GPIO-assisted RS-485 mode. Errors are raised only if raise is true, so that
+ * the GPIO is released before raising an error of the transmit itself. */
+static void lua_serial_rs485_end(lua_State *L, lua_serial_t *handle, bool raise) {
+    int ret;
+
+    if (handle->rs485_mode != SERIAL_RS485_GPIO)
+        return;
+
+    /* tcdrain() */
+    if ((ret = serial_flush(handle->serial)) < 0 && raise) {
+        gpio_write(handle->rs485_gpio, handle->rs485_rts_after_send);
+        lua_serial_error(L, ret, serial_errno(handle->serial), "Error: %s", serial_errmsg(handle->serial));
+    }
+
+    if (handle->rs485_delay_after_send_ms > 0)
+        lua_serial_sleep_ms(handle->rs485_delay_after_send_ms);
+
+    if ((ret = gpio_write(handle->rs485_gpio, handle->rs485_rts_after_send)) < 0 && raise)
+        lua_serial_error(L, SERIAL_ERROR_IO, gpio_errno(handle->rs485_gpio), "Error: writing RS-485 GPIO: %s", gpio_errmsg(handle->rs485_gpio));
+}
+
+int lua_periphery_serial_transmit(lua_State *L, int index, const uint8_t *buf, size_t len, int *c_errno, char *errmsg, size_t errmsg_len) {
+    lua_serial_t *handle = (lua_serial_t *)lua_touserdata(L, index);
+    bool rs485_gpio = handle->rs485_mode == SERIAL_RS485_GPIO;
+    int ret;
+
+    if (rs485_gpio) {
+        if (gpio_write(handle->rs485_gpio, handle->rs485_rts_on_send) < 0) {
+            *c_errno = gpio_errno(handle->rs485_gpio);
+            snprintf(errmsg, errmsg_len, "Error: writing RS-485 GPIO: %s", gpio_errmsg(handle->rs485_gpio));
+            return SERIAL_ERROR_IO;
+        }
+
+        if (handle->rs485_delay_before_send_ms > 0)
+            lua_serial_sleep_ms(handle->rs485_delay_before_send_ms);
+    }
+
+    /* Write, and wait for the write to be transmitted */
+    if ((ret = serial_write(handle->serial, buf, len)) >= 0)
+        ret = serial_flush(handle->serial);
+
+    if (ret < 0) {
+        *c_errno = serial_errno(handle->serial);
+        snprintf(errmsg, errmsg_len, "Error: %s", serial_errmsg(handle->serial));
+    }
+
+    if (rs485_gpio) {
+        if (ret == 0 && handle->rs485_delay_after_send_ms > 0)
+            lua_serial_sleep_ms(handle->rs485_delay_after_send_ms);
+
+        if (gpio_write(handle->rs485_gpio, handle->rs485_rts_after_send) < 0 && ret == 0) {
+            *c_errno = gpio_errno(handle->rs485_gpio);
+            snprintf(errmsg, errmsg_len, "Error: writing RS-485 GPIO: %s", gpio_errmsg(handle->rs485_gpio));
+            return SERIAL_ERROR_IO;
+        }
+    }
+
+    return ret < 0 ? ret : 0;
+}
+
+int lua_periphery_serial_discard(lua_State *L, int index, int *c_errno, char *errmsg, size_t errmsg_len) {
+    lua_serial_t *handle = (lua_serial_t *)lua_touserdata(L, index);
+
+    /* Discard buffered bytes and any partial frame */
+    handle->rx_start = 0;
+    handle->rx_len = 0;
+    handle->rx_scanned = 0;
+    handle->rx_discarding = false;
+
+    /* Discard bytes received by the kernel but not yet read */
+    if (ioctl(serial_fd(handle->serial), TCFLSH, TCIFLUSH) < 0) {
+        *c_errno = errno;
+        snprintf(errmsg, errmsg_len, "Error: flushing input: %s [errno %d]", strerror(errno), errno);
+        return SERIAL_ERROR_IO;
+    }
+
+    return 0;
+}
+
+static void lua_serial_rs485_release_gpio(lua_State *L, lua_serial_t *handle) {
+    if (handle->rs485_gpio_ref != LUA_NOREF) {
+        luaL_unref(L, LUA_REGISTRYINDEX, handle->rs485_gpio_ref);
+        handle->rs485_gpio_ref = LUA_NOREF;
+    }
+
+    handle->rs485_gpio = NULL;
+}
+
+static int lua_serial_set_rs485(lua_State *L) {
+    lua_serial_t *handle;
+    serial_t *serial;
+    struct serial_rs485 rs485;
+    bool enabled;
+    const char *mode;
+    bool rts_on_send;
+    bool rts_after_send;
+    unsigned int delay_before_send_ms;
+    unsigned int delay_after_send_ms;
+    bool rx_during_tx;
+    bool has_gpio;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
+
+    lua_serial_checktype(L, 2, LUA_TTABLE);
+
+    /* Default settings of optional arguments */
+    enabled = true;
+    mode = "auto";
+    rts_on_send = true;
+    rts_after_send = false;
+    delay_before_send_ms = 0;
+    delay_after_send_ms = 0;
+    rx_during_tx = false;
+
+    lua_getfield(L, 2, "enabled");
+    if (lua_isboolean(L, -1))
+        enabled = lua_toboolean(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'enabled', should be boolean");
+
+    lua_getfield(L, 2, "mode");
+    if (lua_isstring(L, -1)) {
+        mode = lua_tostring(L, -1);
+        if (strcmp(mode, "auto") != 0 && strcmp(mode, "kernel") != 0 && strcmp(mode, "gpio") != 0)
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid mode, should be 'auto', 'kernel', or 'gpio'");
+    } else if (!lua_isnil(L, -1))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'mode', should be string");
+
+    lua_getfield(L, 2, "rts_on_send");
+    if (lua_isboolean(L, -1))
+        rts_on_send = lua_toboolean(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'rts_on_send', should be boolean");
+
+    lua_getfield(L, 2, "rts_after_send");
+    if (lua_isboolean(L, -1))
+        rts_after_send = lua_toboolean(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'rts_after_send', should be boolean");
+
+    lua_getfield(L, 2, "delay_before_send_ms");
+    if (lua_isnumber(L, -1))
+        delay_before_send_ms = lua_tounsigned(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'delay_before_send_ms', should be number");
+
+    lua_getfield(L, 2, "delay_after_send_ms");
+    if (lua_isnumber(L, -1))
+        delay_after_send_ms = lua_tounsigned(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'delay_after_send_ms', should be number");
+
+    lua_getfield(L, 2, "rx_during_tx");
+    if (lua_isboolean(L, -1))
+        rx_during_tx = lua_toboolean(L, -1);
+    else if (!lua_isnil(L, -1))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'rx_during_tx', should be boolean");
+
+    lua_getfield(L, 2, "gpio");
+    if (lua_isnil(L, -1))
+        has_gpio = false;
+    else if (lua_serial_isgpio(L, -1))
+        has_gpio = true;
+    else
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of table argument 'gpio', should be GPIO object");
+
+    if (enabled && strcmp(mode, "gpio") == 0 && !has_gpio)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: missing table argument 'gpio' for gpio mode");
+
+    /* Disable */
+    if (!enabled) {
+        if (handle->rs485_mode == SERIAL_RS485_GPIO) {
+            lua_serial_rs485_release_gpio(L, handle);
+        } else if (ioctl(serial_fd(serial), TIOCGRS485, &rs485) == 0) {
+            rs485.flags &= ~SER_RS485_ENABLED;
+            if (ioctl(serial_fd(serial), TIOCSRS485, &rs485) < 0)
+                return lua_serial_error(L, SERIAL_ERROR_CONFIGURE, errno, "Error: disabling RS-485: %s [errno %d]", strerror(errno), errno);
+        }
+
+        handle->rs485_mode = SERIAL_RS485_NONE;
+        return 0;
+    }
+
+    /* Kernel RS-485 mode */
+    if (strcmp(mode, "gpio") != 0) {
+        memset(&rs485, 0, sizeof(rs485));
+        rs485.flags = SER_RS485_ENABLED;
+        if (rts_on_send)
+            rs485.flags |= SER_RS485_RTS_ON_SEND;
+        if (rts_after_send)
+            rs485.flags |= SER_RS485_RTS_AFTER_SEND;
+        if (rx_during_tx)
+            rs485.flags |= SER_RS485_RX_DURING_TX;
+        rs485.delay_rts_before_send = delay_before_send_ms;
+        rs485.delay_rts_after_send = delay_after_send_ms;
+
+        if (ioctl(serial_fd(serial), TIOCSRS485, &rs485) == 0) {
+            lua_serial_rs485_release_gpio(L, handle);
+            handle->rs485_mode = SERIAL_RS485_KERNEL;
+            return 0;
+        }
+
+        /* Fall back to GPIO-assisted mode if the driver lacks RS-485 support */
+        if (strcmp(mode, "kernel") == 0 || !has_gpio || (errno != ENOTTY && errno != EINVAL))
+            return lua_serial_error(L, SERIAL_ERROR_CONFIGURE, errno, "Error: enabling RS-485: %s [errno %d]", strerror(errno), errno);
+    }
+
+    /* GPIO-assisted RS-485 mode */
+    lua_serial_rs485_release_gpio(L, handle);
+
+    lua_getfield(L, 2, "gpio");
+    handle->rs485_gpio = *((gpio_t **)lua_touserdata(L, -1));
+    handle->rs485_gpio_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    handle->rs485_rts_on_send = rts_on_send;
+    handle->rs485_rts_after_send = rts_after_send;
+    handle->rs485_delay_before_send_ms = delay_before_send_ms;
+    handle->rs485_delay_after_send_ms = delay_after_send_ms;
+    handle->rs485_mode = SERIAL_RS485_GPIO;
+
+    /* Release the bus */
+    lua_serial_rs485_end(L, handle, true);
+
+    return 0;
+}
+
+static int lua_serial_get_rs485(lua_State *L) {
+    lua_serial_t *handle;
+    struct serial_rs485 rs485;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+
+    lua_newtable(L);
+
+    if (handle->rs485_mode == SERIAL_RS485_GPIO) {
+        lua_pushboolean(L, true);
+        lua_setfield(L, -2, "enabled");
+        lua_pushstring(L, "gpio");
+        lua_setfield(L, -2, "mode");
+        lua_pushboolean(L, handle->rs485_rts_on_send);
+        lua_setfield(L, -2, "rts_on_send");
+        lua_pushboolean(L, handle->rs485_rts_after_send);
+        lua_setfield(L, -2, "rts_after_send");
+        lua_pushunsigned(L, handle->rs485_delay_before_send_ms);
+        lua_setfield(L, -2, "delay_before_send_ms");
+        lua_pushunsigned(L, handle->rs485_delay_after_send_ms);
+        lua_setfield(L, -2, "delay_after_send_ms");
+        lua_pushboolean(L, false);
+        lua_setfield(L, -2, "rx_during_tx");
+        lua_rawgeti(L, LUA_REGISTRYINDEX, handle->rs485_gpio_ref);
+        lua_setfield(L, -2, "gpio");
+        return 1;
+    }
+
+    /* Drivers without RS-485 support report it disabled */
+    if (ioctl(serial_fd(handle->serial), TIOCGRS485, &rs485) < 0) {
+        if (errno != ENOTTY && errno != EINVAL)
+            return lua_serial_error(L, SERIAL_ERROR_QUERY, errno, "Error: getting RS-485 settings: %s [errno %d]", strerror(errno), errno);
+
+        memset(&rs485, 0, sizeof(rs485));
+    }
+
+    lua_pushboolean(L, (rs485.flags & SER_RS485_ENABLED) != 0);
+    lua_setfield(L, -2, "enabled");
+    lua_pushstring(L, (rs485.flags & SER_RS485_ENABLED) ? "kernel" : "none");
+    lua_setfield(L, -2, "mode");
+    lua_pushboolean(L, (rs485.flags & SER_RS485_RTS_ON_SEND) != 0);
+    lua_setfield(L, -2, "rts_on_send");
+    lua_pushboolean(L, (rs485.flags & SER_RS485_RTS_AFTER_SEND) != 0);
+    lua_setfield(L, -2, "rts_after_send");
+    lua_pushunsigned(L, rs485.delay_rts_before_send);
+    lua_setfield(L, -2, "delay_before_send_ms");
+    lua_pushunsigned(L, rs485.delay_rts_after_send);
+    lua_setfield(L, -2, "delay_after_send_ms");
+    lua_pushboolean(L, (rs485.flags & SER_RS485_RX_DURING_TX) != 0);
+    lua_setfield(L, -2, "rx_during_tx");
+
+    return 1;
+}
+
+/* Write the array of strings at index with writev(), in batches of up to
+ * SERIAL_WRITEV_MAX_IOV strings, resuming partial writes. Returns the number
+ * of bytes written. */
+static size_t lua_serial_writev(lua_State *L, lua_serial_t *handle, int index) {
+    serial_t *serial = handle->serial;
+    struct iovec iov[SERIAL_WRITEV_MAX_IOV];
+    size_t count;
+    size_t total;
+    size_t i, j;
+
+    count = luaL_len(L, index);
+
+    /* Validate all elements before writing anything */
+    for (i = 1; i <= count; i++) {
+        lua_rawgeti(L, index, i);
+        if (lua_type(L, -1) != LUA_TSTRING)
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of data element %u, should be string", (unsigned int)i);
+        lua_pop(L, 1);
+    }
+
+    total = 0;
+
+    lua_serial_rs485_begin(L, handle);
+
+    for (i = 1; i <= count; i += SERIAL_WRITEV_MAX_IOV) {
+        size_t iovcnt = 0;
+        size_t first = 0;
+
+        /* Strings stay referenced by the data table for the duration of the write */
+        for (j = i; j <= count && iovcnt < SERIAL_WRITEV_MAX_IOV; j++, iovcnt++) {
+            lua_rawgeti(L, index, j);
+            iov[iovcnt].iov_base = (void *)lua_tolstring(L, -1, &iov[iovcnt].iov_len);
+            lua_pop(L, 1);
+        }
+
+        while (first < iovcnt) {
+            ssize_t ret;
+
+            /* Skip empty or completed iovecs */
+            if (iov[first].iov_len == 0) {
+                first++;
+                continue;
+            }
+
+            if ((ret = writev(serial_fd(serial), iov + first, iovcnt - first)) < 0) {
+                int errsv = errno;
+
+                if (errsv == EINTR)
+                    continue;
+
+                lua_serial_rs485_end(L, handle, false);
+                return lua_serial_error(L, SERIAL_ERROR_IO, errsv, "Error: writing serial port: %s [errno %d]", strerror(errsv), errsv);
+            }
+
+            total += ret;
+
+            /* Advance past the bytes written */
+            while (ret > 0) {
+                size_t n = ((size_t)ret < iov[first].iov_len) ? (size_t)ret : iov[first].iov_len;
+
+                iov[first].iov_base = (uint8_t *)iov[first].iov_base + n;
+                iov[first].iov_len -= n;
+                ret -= n;
+
+                if (iov[first].iov_len == 0)
+                    first++;
+            }
+        }
+    }
+
+    lua_serial_rs485_end(L, handle, true);
+
+    return total;
+}
+
+static int lua_serial_write(lua_State *L) {
+    lua_serial_t *handle;
     serial_t *serial;
+    const uint8_t *buf;
+    size_t len;
+    int ret;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
+
+    /* Array of strings written with a single writev() */
+    if (lua_istable(L, 2)) {
+        lua_pushunsigned(L, lua_serial_writev(L, handle, 2));
+        return 1;
+    }
+
+    lua_serial_checktype(L, 2, LUA_TSTRING);
+
+    buf = (const uint8_t *)lua_tolstring(L, 2, &len);
+
+    lua_serial_rs485_begin(L, handle);
+
+    if ((ret = serial_write(serial, buf, len)) < 0) {
+        lua_serial_rs485_end(L, handle, false);
+        return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+    }
+
+    lua_serial_rs485_end(L, handle, true);
+
+    lua_pushinteger(L, ret);
+    return 1;
+}
+
+static size_t lua_serial_cobs_encode(const uint8_t *src, size_t len, uint8_t *dst) {
+    size_t code_pos = 0;
+    size_t out = 1;
+    uint8_t code = 1;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if (src[i] != 0x00) {
+            dst[out++] = src[i];
+            code++;
+        }
+
+        if (src[i] == 0x00 || code == 0xff) {
+            dst[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+        }
+    }
+
+    dst[code_pos] = code;
+    dst[out++] = 0x00;
+
+    return out;
+}
+
+static bool lua_serial_cobs_decode(uint8_t *buf, size_t len, size_t *decoded_len) {
+    size_t in = 0;
+    size_t out = 0;
+
+    /* Decode in place, as the output is always shorter than the input */
+    while (in < len) {
+        uint8_t code = buf[in++];
+
+        if (code == 0x00 || (size_t)(code - 1) > len - in)
+            return false;
+
+        memmove(buf + out, buf + in, code - 1);
+        out += code - 1;
+        in += code - 1;
+
+        if (code != 0xff && in < len)
+            buf[out++] = 0x00;
+    }
+
+    *decoded_len = out;
+
+    return true;
+}
+
+static size_t lua_serial_slip_encode(const uint8_t *src, size_t len, uint8_t *dst) {
+    size_t out = 0;
+    size_t i;
+
+    /* Leading END flushes any line noise received before the frame */
+    dst[out++] = SLIP_END;
+
+    for (i = 0; i < len; i++) {
+        if (src[i] == SLIP_END) {
+            dst[out++] = SLIP_ESC;
+            dst[out++] = SLIP_ESC_END;
+        } else if (src[i] == SLIP_ESC) {
+            dst[out++] = SLIP_ESC;
+            dst[out++] = SLIP_ESC_ESC;
+        } else {
+            dst[out++] = src[i];
+        }
+    }
+
+    dst[out++] = SLIP_END;
+
+    return out;
+}
+
+static bool lua_serial_slip_decode(uint8_t *buf, size_t len, size_t *decoded_len) {
+    size_t in = 0;
+    size_t out = 0;
+
+    /* Decode in place, as the output is never longer than the input */
+    while (in < len) {
+        uint8_t c = buf[in++];
+
+        if (c == SLIP_ESC) {
+            if (in == len)
+                return false;
+
+            c = buf[in++];
+            if (c == SLIP_ESC_END)
+                c = SLIP_END;
+            else if (c == SLIP_ESC_ESC)
+                c = SLIP_ESC;
+            else
+                return false;
+        }
+
+        buf[out++] = c;
+    }
+
+    *decoded_len = out;
+
+    return true;
+}
+
+static size_t lua_serial_length_header_size(lua_serial_framing_t framing) {
+    switch (framing) {
+        case SERIAL_FRAMING_U8: return 1;
+        case SERIAL_FRAMING_U16LE: case SERIAL_FRAMING_U16BE: return 2;
+        case SERIAL_FRAMING_U32LE: case SERIAL_FRAMING_U32BE: return 4;
+        default: return 0;
+    }
+}
+
+static uint32_t lua_serial_length_header_decode(lua_serial_framing_t framing, const uint8_t *hdr) {
+    switch (framing) {
+        case SERIAL_FRAMING_U8: return hdr[0];
+        case SERIAL_FRAMING_U16LE: return (uint32_t)hdr[0] | ((uint32_t)hdr[1] << 8);
+        case SERIAL_FRAMING_U16BE: return ((uint32_t)hdr[0] << 8) | (uint32_t)hdr[1];
+        case SERIAL_FRAMING_U32LE: return (uint32_t)hdr[0] | ((uint32_t)hdr[1] << 8) | ((uint32_t)hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+        case SERIAL_FRAMING_U32BE: return ((uint32_t)hdr[0] << 24) | ((uint32_t)hdr[1] << 16) | ((uint32_t)hdr[2] << 8) | (uint32_t)hdr[3];
+        default: return 0;
+    }
+}
+
+static void lua_serial_length_header_encode(lua_serial_framing_t framing, uint32_t len, uint8_t *hdr) {
+    switch (framing) {
+        case SERIAL_FRAMING_U8:
+            hdr[0] = len;
+            break;
+        case SERIAL_FRAMING_U16LE:
+            hdr[0] = len; hdr[1] = len >> 8;
+            break;
+        case SERIAL_FRAMING_U16BE:
+            hdr[0] = len >> 8; hdr[1] = len;
+            break;
+        case SERIAL_FRAMING_U32LE:
+            hdr[0] = len; hdr[1] = len >> 8; hdr[2] = len >> 16; hdr[3] = len >> 24;
+            break;
+        case SERIAL_FRAMING_U32BE:
+            hdr[0] = len >> 24; hdr[1] = len >> 16; hdr[2] = len >> 8; hdr[3] = len;
+            break;
+        default:
+            break;
+    }
+}
+
+/* Largest frame length representable in the length header */
+static size_t lua_serial_length_header_capacity(lua_serial_framing_t framing) {
+    switch (framing) {
+        case SERIAL_FRAMING_U8: return 0xff;
+        case SERIAL_FRAMING_U16LE: case SERIAL_FRAMING_U16BE: return 0xffff;
+        case SERIAL_FRAMING_U32LE: case SERIAL_FRAMING_U32BE: return 0xffffffff;
+        default: return SIZE_MAX;
+    }
+}
+
+/* Max frame length, limited to the capacity of the length header, as the
+ * framing may be changed without changing the max frame length */
+static size_t lua_serial_max_frame_len(lua_serial_t *handle) {
+    size_t capacity = lua_serial_length_header_capacity(handle->framing);
+
+    return (handle->max_frame_len < capacity) ? handle->max_frame_len : capacity;
+}
+
+/* Worst case encoded size of a frame, including delimiters or header */
+static size_t lua_serial_max_encoded_len(lua_serial_framing_t framing, size_t len) {
+    if (framing == SERIAL_FRAMING_COBS)
+        return len + len/254 + 2;
+    else if (framing == SERIAL_FRAMING_SLIP)
+        return 2*len + 2;
+    else
+        return lua_serial_length_header_size(framing) + len;
+}
+
+/* Extract the next complete frame from the receive buffer, discarding
+ * malformed and oversized frames to resynchronize. Returns true if a frame is
+ * complete, in which case the decoded frame is left in the receive buffer at
+ * frame, and consume bytes should be consumed after it is returned. */
+static bool lua_serial_rx_frame(lua_serial_t *handle, uint8_t **frame, size_t *frame_len, size_t *consume) {
+    while (handle->rx_len > 0) {
+        uint8_t *data = handle->rx_buf + handle->rx_start;
+
+        if (handle->framing == SERIAL_FRAMING_COBS || handle->framing == SERIAL_FRAMING_SLIP) {
+            uint8_t delim = (handle->framing == SERIAL_FRAMING_COBS) ? 0x00 : SLIP_END;
+            uint8_t *end;
+            size_t len, decoded_len;
+            bool valid;
+
+            if ((end = memchr(data + handle->rx_scanned, delim, handle->rx_len - handle->rx_scanned)) == NULL) {
+                handle->rx_scanned = handle->rx_len;
+
+                /* Discard an oversized partial frame */
+                if (handle->rx_len > lua_serial_max_encoded_len(handle->framing, lua_serial_max_frame_len(handle))) {
+                    lua_serial_rx_consume(handle, handle->rx_len);
+                    handle->rx_discarding = true;
+                }
+
+                return false;
+            }
+
+            len = end - data;
+
+            /* Skip empty frames and the tail of a discarded frame */
+            if (len == 0 || handle->rx_discarding) {
+                handle->rx_discarding = false;
+                lua_serial_rx_consume(handle, len + 1);
+                continue;
+            }
+
+            if (handle->framing == SERIAL_FRAMING_COBS)
+                valid = lua_serial_cobs_decode(data, len, &decoded_len);
+            else
+                valid = lua_serial_slip_decode(data, len, &decoded_len);
+
+            /* Discard invalid and oversized frames, and empty frames, which
+             * are not delivered with delimited framing */
+            if (!valid || decoded_len == 0 || decoded_len > lua_serial_max_frame_len(handle)) {
+                lua_serial_rx_consume(handle, len + 1);
+                continue;
+            }
+
+            *frame = data;
+            *frame_len = decoded_len;
+            *consume = len + 1;
+            return true;
+        } else {
+            size_t header_size = lua_serial_length_header_size(handle->framing);
+            uint32_t len;
+
+            if (handle->rx_len < header_size)
+                return false;
+
+            len = lua_serial_length_header_decode(handle->framing, data);
+
+            /* Slip one byte on an invalid length */
+            if (len > lua_serial_max_frame_len(handle)) {
+                lua_serial_rx_consume(handle, 1);
+                continue;
+            }
+
+            if (handle->rx_len < header_size + len)
+                return false;
+
+            *frame = data + header_size;
+            *frame_len = len;
+            *consume = header_size + len;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static lua_serial_framing_t lua_serial_parse_framing(lua_State *L, const char *s) {
+    unsigned int i;
+
+    for (i = 0; i < sizeof(lua_serial_framing_strings)/sizeof(lua_serial_framing_strings[0]); i++) {
+        if (strcmp(s, lua_serial_framing_strings[i]) == 0)
+            break;
+    }
+
+    if (i == sizeof(lua_serial_framing_strings)/sizeof(lua_serial_framing_strings[0]))
+        lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid framing, should be 'none', 'cobs', 'slip', 'u8', 'u16le', 'u16be', 'u32le', or 'u32be'");
+
+    return (lua_serial_framing_t)i;
+}
+
+static void lua_serial_set_framing_str(lua_State *L, lua_serial_t *handle, const char *s) {
+    handle->framing = lua_serial_parse_framing(L, s);
+    handle->rx_scanned = 0;
+    handle->rx_discarding = false;
+}
+
+static int lua_serial_set_framing(lua_State *L) {
+    lua_serial_t *handle;
+    lua_serial_framing_t framing;
+    size_t max_frame_len = SERIAL_FRAMING_DEFAULT_MAX_FRAME_LEN;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    lua_serial_checktype(L, 2, LUA_TSTRING);
+
+    framing = lua_serial_parse_framing(L, lua_tostring(L, 2));
+
+    /* Optional max_frame_len argument, defaulting to the lesser of 4096 bytes
+     * and the capacity of the length header */
+    if (lua_isnumber(L, 3)) {
+        if (lua_tonumber(L, 3) < 1)
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid max frame length, should be positive");
+        else if (lua_tonumber(L, 3) > lua_serial_length_header_capacity(framing))
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid max frame length, exceeds capacity of length header");
+
+        max_frame_len = lua_tounsigned(L, 3);
+    } else if (!lua_isnone(L, 3) && !lua_isnil(L, 3)) {
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'max_frame_len', should be number or nil");
+    } else if (max_frame_len > lua_serial_length_header_capacity(framing)) {
+        max_frame_len = lua_serial_length_header_capacity(framing);
+    }
+
+    lua_serial_set_framing_str(L, handle, lua_tostring(L, 2));
+    handle->max_frame_len = max_frame_len;
+
+    return 0;
+}
+
+static int lua_serial_read_frame(lua_State *L) {
+    lua_serial_t *handle;
     int timeout_ms;
+    uint64_t deadline_ms;
+    uint8_t *frame;
+    size_t frame_len, consume;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+
+    /* Optional timeout argument */
+    if (lua_isnone(L, 2) || lua_isnil(L, 2))
+        timeout_ms = -1;
+    else if (lua_isnumber(L, 2))
+        timeout_ms = lua_tointeger(L, 2);
+    else
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
+
+    if (handle->framing == SERIAL_FRAMING_NONE)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: framing is not configured");
+
+    deadline_ms = lua_serial_monotonic_ms() + ((timeout_ms > 0) ? timeout_ms : 0);
+
+    while (!lua_serial_rx_frame(handle, &frame, &frame_len, &consume)) {
+        if (lua_serial_rx_fill(L, handle, lua_serial_remaining_ms(timeout_ms, deadline_ms)) == 0) {
+            lua_pushnil(L);
+            return 1;
+        }
+    }
+
+    lua_pushlstring(L, (char *)frame, frame_len);
+    lua_serial_rx_consume(handle, consume);
+
+    return 1;
+}
+
+static int lua_serial_write_frame(lua_State *L) {
+    lua_serial_t *handle;
+    const uint8_t *data;
+    uint8_t *buf;
+    size_t len, buf_len;
+    int ret;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    lua_serial_checktype(L, 2, LUA_TSTRING);
+
+    data = (const uint8_t *)lua_tolstring(L, 2, &len);
+
+    if (handle->framing == SERIAL_FRAMING_NONE)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: framing is not configured");
+    else if (len > lua_serial_length_header_capacity(handle->framing))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: frame length exceeds capacity of length header");
+    else if (len > handle->max_frame_len)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: frame length exceeds max frame length");
+
+    lua_serial_rs485_begin(L, handle);
+
+    if ((buf = malloc(lua_serial_max_encoded_len(handle->framing, len))) == NULL) {
+        lua_serial_rs485_end(L, handle, false);
+        return lua_serial_error(L, SERIAL_ERROR_ALLOC, errno, "Error: allocating memory");
+    }
+
+    if (handle->framing == SERIAL_FRAMING_COBS) {
+        buf_len = lua_serial_cobs_encode(data, len, buf);
+    } else if (handle->framing == SERIAL_FRAMING_SLIP) {
+        buf_len = lua_serial_slip_encode(data, len, buf);
+    } else {
+        size_t header_size = lua_serial_length_header_size(handle->framing);
+
+        lua_serial_length_header_encode(handle->framing, len, buf);
+        memcpy(buf + header_size, data, len);
+        buf_len = header_size + len;
+    }
+
+    ret = serial_write(handle->serial, buf, buf_len);
+
+    free(buf);
+
+    if (ret < 0) {
+        lua_serial_rs485_end(L, handle, false);
+        return lua_serial_error(L, ret, serial_errno(handle->serial), "Error: %s", serial_errmsg(handle->serial));
+    }
+
+    lua_serial_rs485_end(L, handle, true);
+
+    lua_pushinteger(L, ret);
+    return 1;
+}
+
+static int lua_serial_flush(lua_State *L) {
+    serial_t *serial;
     int ret;
 
     serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
 
+    if ((ret = serial_flush(serial)) < 0)
+        return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+
+    return 0;
+}
+
+static int lua_serial_input_waiting(lua_State *L) {
+    lua_serial_t *handle;
+    serial_t *serial;
+    unsigned int count;
+    int ret;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
+
+    if ((ret = serial_input_waiting(serial, &count)) < 0)
+        return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+
+    /* Include bytes held in the receive buffer */
+    lua_pushinteger(L, count + handle->rx_len);
+    return 1;
+}
+
+static int lua_serial_output_waiting(lua_State *L) {
+    serial_t *serial;
+    unsigned int count;
+    int ret;
+
+    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
+
+    if ((ret = serial_output_waiting(serial, &count)) < 0)
+        return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+
+    lua_pushinteger(L, count);
+
+    return 1;
+}
+
+/* Report the progress of a file transfer to the optional callback at index.
+ * Returns non-zero with the callback's error on the stack if it raised one. */
+static int lua_serial_file_progress(lua_State *L, int index, uint64_t done, uint64_t total, bool has_total) {
+    if (lua_isnone(L, index) || lua_isnil(L, index))
+        return 0;
+
+    lua_pushvalue(L, index);
+    lua_pushnumber(L, (lua_Number)done);
+    if (has_total)
+        lua_pushnumber(L, (lua_Number)total);
+    else
+        lua_pushnil(L);
+
+    return lua_pcall(L, 2, 0, 0);
+}
+
+static int lua_serial_file_write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t ret;
+
+        if ((ret = write(fd, buf, len)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        buf += ret;
+        len -= ret;
+    }
+
+    return 0;
+}
+
+static void lua_serial_check_progress_arg(lua_State *L, int index) {
+    if (!lua_isnone(L, index) && !lua_isnil(L, index) && !lua_isfunction(L, index))
+        lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'progress', should be function or nil");
+}
+
+static int lua_serial_send_file(lua_State *L) {
+    lua_serial_t *handle;
+    serial_t *serial;
+    uint8_t buf[SERIAL_RX_CHUNK_SIZE];
+    int fd;
+    bool owned;
+    off_t offset;
+    bool has_offset;
+    uint64_t total;
+    bool has_total;
+    uint64_t sent;
+    bool use_sendfile;
+    int code;
+    int errsv;
+    char errmsg[96];
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
+
+    if (!lua_isstring(L, 2) && !lua_isnumber(L, 2))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'path_or_fd', should be string or number");
+
+    /* Optional offset argument */
+    has_offset = false;
+    offset = 0;
+    if (lua_isnone(L, 3) || lua_isnil(L, 3))
+        ;
+    else if (lua_isnumber(L, 3) && lua_tonumber(L, 3) >= 0) {
+        offset = (off_t)lua_tonumber(L, 3);
+        has_offset = true;
+    } else
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid argument 'offset', should be non-negative number or nil");
+
+    /* Optional length argument */
+    has_total = false;
+    total = 0;
+    if (lua_isnone(L, 4) || lua_isnil(L, 4))
+        ;
+    else if (lua_isnumber(L, 4) && lua_tonumber(L, 4) >= 0) {
+        total = (uint64_t)lua_tonumber(L, 4);
+        has_total = true;
+    } else
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid argument 'len', should be non-negative number or nil");
+
+    lua_serial_check_progress_arg(L, 5);
+
+    /* Assert the RS-485 driver enable for the whole transfer */
+    lua_serial_rs485_begin(L, handle);
+
+    /* Open path, or use file descriptor */
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        fd = lua_tointeger(L, 2);
+        owned = false;
+    } else {
+        if ((fd = open(lua_tostring(L, 2), O_RDONLY)) < 0) {
+            int errsv = errno;
+
+            lua_serial_rs485_end(L, handle, false);
+            return lua_serial_error(L, SERIAL_ERROR_IO, errsv, "Error: opening file: %s [errno %d]", strerror(errsv), errsv);
+        }
+        owned = true;
+        has_offset = true;
+    }
+
+    /* Default length of a regular file is the remainder from the offset */
+    if (!has_total) {
+        struct stat st;
+        off_t start = has_offset ? offset : lseek(fd, 0, SEEK_CUR);
+
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && start >= 0) {
+            total = (st.st_size > start) ? (uint64_t)(st.st_size - start) : 0;
+            has_total = true;
+        }
+    }
+
+    sent = 0;
+    use_sendfile = true;
+    code = 0;
+    errsv = 0;
+
+    while (!has_total || sent < total) {
+        size_t chunk = SERIAL_FILE_CHUNK_SIZE;
+        ssize_t ret;
+
+        if (has_total && total - sent < chunk)
+            chunk = total - sent;
+
+        if (use_sendfile) {
+            /* Move data in the kernel, from the file to the tty */
+            if ((ret = sendfile(serial_fd(serial), fd, has_offset ? &offset : NULL, chunk)) < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                /* Fall back to a native loop if unsupported by the file or tty */
+                if (sent == 0 && (errno == EINVAL || errno == ENOSYS)) {
+                    use_sendfile = false;
+                    continue;
+                }
+
+                code = SERIAL_ERROR_IO;
+                errsv = errno;
+                snprintf(errmsg, sizeof(errmsg), "sending file: %s [errno %d]", strerror(errsv), errsv);
+                break;
+            }
+        } else {
+            if (chunk > sizeof(buf))
+                chunk = sizeof(buf);
+
+            if ((ret = has_offset ? pread(fd, buf, chunk, offset) : read(fd, buf, chunk)) < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                code = SERIAL_ERROR_IO;
+                errsv = errno;
+                snprintf(errmsg, sizeof(errmsg), "reading file: %s [errno %d]", strerror(errsv), errsv);
+                break;
+            }
+
+            if (ret > 0) {
+                int err;
+
+                if ((err = serial_write(serial, buf, ret)) < 0) {
+                    code = err;
+                    errsv = serial_errno(serial);
+                    snprintf(errmsg, sizeof(errmsg), "%s", serial_errmsg(serial));
+                    break;
+                }
+
+                if (has_offset)
+                    offset += ret;
+            }
+        }
+
+        /* End of file */
+        if (ret == 0)
+            break;
+
+        sent += ret;
+
+        if (lua_serial_file_progress(L, 5, sent, total, has_total) != 0) {
+            if (owned)
+                close(fd);
+            lua_serial_rs485_end(L, handle, false);
+            return lua_error(L);
+        }
+    }
+
+    if (owned)
+        close(fd);
+
+    if (code < 0) {
+        lua_serial_rs485_end(L, handle, false);
+        return lua_serial_error(L, code, errsv, "Error: %s", errmsg);
+    }
+
+    lua_serial_rs485_end(L, handle, true);
+
+    lua_pushnumber(L, (lua_Number)sent);
+
+    return 1;
+}
+
+static int lua_serial_capture_to_file(lua_State *L) {
+    lua_serial_t *handle;
+    serial_t *serial;
+    uint8_t buf[SERIAL_RX_CHUNK_SIZE];
+    int fd;
+    uint64_t limit;
+    bool has_limit;
+    int duration_ms;
+    uint64_t deadline_ms;
+    uint64_t captured;
+    int code;
+    int errsv;
+    char errmsg[96];
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
+
+    lua_serial_checktype(L, 2, LUA_TSTRING);
+
+    /* Optional byte limit argument */
+    has_limit = false;
+    limit = 0;
+    if (lua_isnone(L, 3) || lua_isnil(L, 3))
+        ;
+    else if (lua_isnumber(L, 3) && lua_tonumber(L, 3) >= 0) {
+        limit = (uint64_t)lua_tonumber(L, 3);
+        has_limit = true;
+    } else
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid argument 'bytes', should be non-negative number or nil");
+
+    /* Optional duration argument */
+    if (lua_isnone(L, 4) || lua_isnil(L, 4))
+        duration_ms = -1;
+    else if (lua_isnumber(L, 4) && lua_tointeger(L, 4) >= 0)
+        duration_ms = lua_tointeger(L, 4);
+    else
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid argument 'duration_ms', should be non-negative number or nil");
+
+    if (!has_limit && duration_ms < 0)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid arguments, should specify bytes or duration_ms");
+
+    lua_serial_check_progress_arg(L, 5);
+
+    if ((fd = open(lua_tostring(L, 2), O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        return lua_serial_error(L, SERIAL_ERROR_IO, errno, "Error: opening file: %s [errno %d]", strerror(errno), errno);
+
+    deadline_ms = lua_serial_monotonic_ms() + ((duration_ms > 0) ? duration_ms : 0);
+    captured = 0;
+    code = 0;
+    errsv = 0;
+
+    /* Bytes held in the receive buffer are captured first */
+    if (handle->rx_len > 0) {
+        size_t len = (has_limit && limit < handle->rx_len) ? limit : handle->rx_len;
+
+        if (lua_serial_file_write_all(fd, handle->rx_buf + handle->rx_start, len) < 0) {
+            errsv = errno;
+            close(fd);
+            return lua_serial_error(L, SERIAL_ERROR_IO, errsv, "Error: writing file: %s [errno %d]", strerror(errsv), errsv);
+        }
+
+        lua_serial_rx_consume(handle, len);
+        captured = len;
+    }
+
+    while (!has_limit || captured < limit) {
+        int timeout_ms = lua_serial_remaining_ms(duration_ms, deadline_ms);
+        size_t chunk = sizeof(buf);
+        int ret;
+
+        if (duration_ms >= 0 && timeout_ms == 0)
+            break;
+
+        if ((ret = serial_poll(serial, timeout_ms)) < 0) {
+            code = ret;
+            errsv = serial_errno(serial);
+            snprintf(errmsg, sizeof(errmsg), "%s", serial_errmsg(serial));
+            break;
+        } else if (ret == 0) {
+            continue;
+        }
+
+        if (has_limit && limit - captured < chunk)
+            chunk = limit - captured;
+
+        if ((ret = serial_read(serial, buf, chunk, 0)) < 0) {
+            code = ret;
+            errsv = serial_errno(serial);
+            snprintf(errmsg, sizeof(errmsg), "%s", serial_errmsg(serial));
+            break;
+        }
+
+        if (lua_serial_file_write_all(fd, buf, ret) < 0) {
+            code = SERIAL_ERROR_IO;
+            errsv = errno;
+            snprintf(errmsg, sizeof(errmsg), "writing file: %s [errno %d]", strerror(errsv), errsv);
+            break;
+        }
+
+        captured += ret;
+
+        if (lua_serial_file_progress(L, 5, captured, limit, has_limit) != 0) {
+            close(fd);
+            return lua_error(L);
+        }
+    }
+
+    if (close(fd) < 0 && code == 0) {
+        code = SERIAL_ERROR_IO;
+        errsv = errno;
+        snprintf(errmsg, sizeof(errmsg), "closing file: %s [errno %d]", strerror(errsv), errsv);
+    }
+
+    if (code < 0)
+        return lua_serial_error(L, code, errsv, "Error: %s", errmsg);
+
+    lua_pushnumber(L, (lua_Number)captured);
+
+    return 1;
+}
+
+/* Continuation of poll() in a periphery.loop task, with the deadline at
+ * index 2 */
+static int lua_serial_poll_k(lua_State *L) {
+    lua_serial_t *handle;
+    int remaining_ms;
+    int ret;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+
+    if ((ret = serial_poll(handle->serial, 0)) < 0)
+        return lua_serial_error(L, ret, serial_errno(handle->serial), "Error: %s", serial_errmsg(handle->serial));
+
+    remaining_ms = lua_periphery_loop_remaining(lua_tonumber(L, 2));
+
+    if (ret > 0 || remaining_ms == 0) {
+        lua_pushboolean(L, ret > 0);
+        return 1;
+    }
+
+    return lua_periphery_loop_wait(L, serial_fd(handle->serial), POLLIN, remaining_ms, lua_serial_poll_k);
+}
+
+static int lua_serial_poll(lua_State *L) {
+    lua_serial_t *handle;
+    serial_t *serial;
+    int timeout_ms;
+    int ret;
+
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
+
     /* Optional timeout argument */
     if (lua_isnone(L, 2) || lua_isnil(L, 2))
         timeout_ms = -1;
@@ -336,6 +2294,19 @@ static int lua_serial_poll(lua_State *L) {
     else
         return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
 
+    /* Bytes held in the receive buffer are immediately available */
+    if (handle->rx_len > 0) {
+        lua_pushboolean(L, true);
+        return 1;
+    }
+
+    /* Yield to the scheduler instead of blocking, in a periphery.loop task */
+    if (timeout_ms != 0 && lua_periphery_loop_can_yield(L)) {
+        lua_settop(L, 1);
+        lua_pushnumber(L, lua_periphery_loop_deadline(timeout_ms));
+        return lua_serial_poll_k(L);
+    }
+
     if ((ret = serial_poll(serial, timeout_ms)) < 0)
         return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
 
@@ -345,10 +2316,20 @@ static int lua_serial_poll(lua_State *L) {
 }
 
 static int lua_serial_close(lua_State *L) {
+    lua_serial_t *handle;
     serial_t *serial;
     int ret;
 
-    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
+
+    /* Discard buffered bytes */
+    handle->rx_start = 0;
+    handle->rx_len = 0;
+
+    /* Release RS-485 GPIO */
+    lua_serial_rs485_release_gpio(L, handle);
+    handle->rs485_mode = SERIAL_RS485_NONE;
 
     if ((ret = serial_close(serial)) < 0)
         return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
@@ -357,14 +2338,21 @@ static int lua_serial_close(lua_State *L) {
 }
 
 static int lua_serial_gc(lua_State *L) {
+    lua_serial_t *handle;
     serial_t *serial;
 
-    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
 
     serial_close(serial);
 
     serial_free(serial);
 
+    free(handle->rx_buf);
+    handle->rx_buf = NULL;
+
+    lua_serial_rs485_release_gpio(L, handle);
+
     return 0;
 }
 
@@ -382,6 +2370,7 @@ static int lua_serial_tostring(lua_State *L) {
 }
 
 static int lua_serial_index(lua_State *L) {
+    lua_serial_t *handle;
     serial_t *serial;
     const char *field;
 
@@ -396,16 +2385,20 @@ static int lua_serial_index(lua_State *L) {
     if (!lua_isnil(L, -1))
         return 1;
 
-    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
 
     if (strcmp(field, "fd") == 0) {
         lua_pushinteger(L, serial_fd(serial));
         return 1;
+    } else if (strcmp(field, "framing") == 0) {
+        lua_pushstring(L, lua_serial_framing_strings[handle->framing]);
+        return 1;
     } else if (strcmp(field, "baudrate") == 0) {
         uint32_t baudrate;
         int ret;
 
-        if ((ret = serial_get_baudrate(serial, &baudrate)) < 0)
+        if ((ret = lua_serial_get_baudrate(serial, &baudrate)) < 0)
             return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
 
         lua_pushunsigned(L, baudrate);
@@ -478,16 +2471,27 @@ static int lua_serial_index(lua_State *L) {
 
         lua_pushnumber(L, vtime);
         return 1;
+    } else if (strcmp(field, "low_latency") == 0) {
+        bool low_latency;
+        int ret;
+
+        if ((ret = lua_serial_get_low_latency(serial, &low_latency)) < 0)
+            return lua_serial_error(L, ret, errno, "Error: getting low latency: %s [errno %d]", strerror(errno), errno);
+
+        lua_pushboolean(L, low_latency);
+        return 1;
     }
 
     return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: unknown property");
 }
 
 static int lua_serial_newindex(lua_State *L) {
+    lua_serial_t *handle;
     serial_t *serial;
     const char *field;
 
-    serial = *((serial_t **)luaL_checkudata(L, 1, "periphery.Serial"));
+    handle = (lua_serial_t *)luaL_checkudata(L, 1, "periphery.Serial");
+    serial = handle->serial;
 
     if (!lua_isstring(L, 2))
         return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: unknown property");
@@ -498,13 +2502,14 @@ static int lua_serial_newindex(lua_State *L) {
         return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: immutable property");
     else if (strcmp(field, "baudrate") == 0) {
         uint32_t baudrate;
-        int ret;
 
         lua_serial_checktype(L, 3, LUA_TNUMBER);
         baudrate = lua_tounsigned(L, 3);
 
-        if ((ret = serial_set_baudrate(serial, baudrate)) < 0)
-            return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
+        if (baudrate == 0)
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid baudrate, should be positive");
+
+        lua_serial_set_baudrate(L, serial, baudrate);
 
         return 0;
     } else if (strcmp(field, "databits") == 0) {
@@ -571,6 +2576,12 @@ static int lua_serial_newindex(lua_State *L) {
         if ((ret = serial_set_rtscts(serial, rtscts)) < 0)
             return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
 
+        return 0;
+    } else if (strcmp(field, "framing") == 0) {
+        lua_serial_checktype(L, 3, LUA_TSTRING);
+
+        lua_serial_set_framing_str(L, handle, lua_tostring(L, 3));
+
         return 0;
     } else if (strcmp(field, "vmin") == 0) {
         unsigned int vmin;
@@ -594,20 +2605,439 @@ static int lua_serial_newindex(lua_State *L) {
             return lua_serial_error(L, ret, serial_errno(serial), "Error: %s", serial_errmsg(serial));
 
         return 0;
+    } else if (strcmp(field, "low_latency") == 0) {
+        bool low_latency;
+        int ret;
+
+        lua_serial_checktype(L, 3, LUA_TBOOLEAN);
+        low_latency = lua_toboolean(L, 3);
+
+        if ((ret = lua_serial_set_low_latency(serial, low_latency)) < 0)
+            return lua_serial_error(L, ret, errno, "Error: setting low latency: %s [errno %d]", strerror(errno), errno);
+
+        return 0;
+    }
+
+    return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static int lua_serial_poll_multiple(lua_State *L) {
+    lua_serial_t **handles;
+    struct pollfd *fds;
+    unsigned int count;
+    int timeout_ms;
+    int ret;
+
+    lua_serial_checktype(L, 1, LUA_TTABLE);
+
+    count = luaL_len(L, 1);
+
+    /* Optional timeout argument */
+    if (lua_isnone(L, 2) || lua_isnil(L, 2))
+        timeout_ms = -1;
+    else if (lua_isnumber(L, 2))
+        timeout_ms = lua_tointeger(L, 2);
+    else
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
+
+    lua_settop(L, 2);
+
+    /* Allocate the pollfd and handle arrays in a userdata rather than on the
+     * stack, as the number of serial ports is unbounded */
+    fds = lua_newuserdata(L, (count > 0 ? count : 1) * (sizeof(struct pollfd) + sizeof(lua_serial_t *)));
+    handles = (lua_serial_t **)(fds + (count > 0 ? count : 1));
+
+    /* Extract the handles from the input table of userdatas */
+    for (unsigned int i = 0; i < count; i++) {
+        lua_rawgeti(L, 1, i+1);
+        handles[i] = (lua_serial_t *)luaL_checkudata(L, -1, "periphery.Serial");
+        lua_pop(L, 1);
+
+        fds[i].fd = serial_fd(handles[i]->serial);
+        fds[i].events = POLLIN | POLLPRI;
+        fds[i].revents = 0;
+
+        /* Bytes held in the receive buffer are immediately available */
+        if (handles[i]->rx_len > 0)
+            timeout_ms = 0;
+    }
+
+    /* Poll */
+    if ((ret = poll(fds, count, timeout_ms)) < 0)
+        return lua_serial_error(L, SERIAL_ERROR_IO, errno, "Error: polling multiple serial ports: %s [errno %d]", strerror(errno), errno);
+
+    /* Create a new output table with serial ports that have data available */
+    lua_newtable(L);
+
+    for (unsigned int i = 0, j = 1; i < count; i++) {
+        if (handles[i]->rx_len > 0 || fds[i].revents != 0) {
+            lua_rawgeti(L, 1, i+1);
+            lua_rawseti(L, -2, j++);
+        }
+    }
+
+    return 1;
+}
+
+static lua_serial_pollset_t *lua_serial_pollset_checkopen(lua_State *L, int index) {
+    lua_serial_pollset_t *pollset = luaL_checkudata(L, index, "periphery.Serial.PollSet");
+
+    if (pollset->set.epfd < 0)
+        lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: poll set is closed");
+
+    return pollset;
+}
+
+static int lua_serial_pollset_add(lua_State *L) {
+    lua_serial_pollset_t *pollset;
+    lua_serial_t *handle;
+
+    pollset = lua_serial_pollset_checkopen(L, 1);
+    handle = (lua_serial_t *)luaL_checkudata(L, 2, "periphery.Serial");
+
+    if (lua_periphery_epoll_set_add(L, &pollset->set, 2, serial_fd(handle->serial), EPOLLIN | EPOLLPRI) < 0)
+        return lua_serial_error(L, SERIAL_ERROR_IO, errno, "Error: adding serial port to poll set: %s [errno %d]", strerror(errno), errno);
+
+    return 0;
+}
+
+static int lua_serial_pollset_remove(lua_State *L) {
+    lua_serial_pollset_t *pollset;
+
+    pollset = lua_serial_pollset_checkopen(L, 1);
+    luaL_checkudata(L, 2, "periphery.Serial");
+
+    lua_periphery_epoll_set_remove(L, &pollset->set, 2);
+
+    return 0;
+}
+
+static int lua_serial_pollset_new(lua_State *L) {
+    lua_serial_pollset_t *pollset;
+
+    /* Remove self table object */
+    lua_remove(L, 1);
+
+    /* Create handle userdata */
+    pollset = lua_newuserdata(L, sizeof(lua_serial_pollset_t));
+    pollset->set.epfd = -1;
+    pollset->set.fds_ref = LUA_NOREF;
+    pollset->set.handles_ref = LUA_NOREF;
+    pollset->set.events = NULL;
+    pollset->ready_ref = LUA_NOREF;
+    /* Set Serial PollSet metatable on it */
+    luaL_getmetatable(L, "periphery.Serial.PollSet");
+    lua_setmetatable(L, -2);
+    /* Move userdata to the beginning of the stack */
+    lua_insert(L, 1);
+
+    if (lua_periphery_epoll_set_open(L, &pollset->set) < 0)
+        return lua_serial_error(L, SERIAL_ERROR_OPEN, errno, "Error: creating epoll instance: %s [errno %d]", strerror(errno), errno);
+
+    lua_newtable(L);
+    pollset->ready_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    /* Optional initial serial ports */
+    if (lua_istable(L, 2)) {
+        unsigned int count = luaL_len(L, 2);
+
+        for (unsigned int i = 0; i < count; i++) {
+            lua_pushcclosure(L, lua_serial_pollset_add, 0);
+            lua_pushvalue(L, 1);
+            lua_rawgeti(L, 2, i+1);
+            lua_call(L, 2, 0);
+        }
+    } else if (!lua_isnone(L, 2) && !lua_isnil(L, 2))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'ports', should be table or nil");
+
+    /* Leave only userdata on the stack */
+    lua_settop(L, 1);
+
+    return 1;
+}
+
+static int lua_serial_pollset_wait(lua_State *L) {
+    lua_serial_pollset_t *pollset;
+    int timeout_ms;
+
+    pollset = lua_serial_pollset_checkopen(L, 1);
+
+    /* Optional timeout argument */
+    if (lua_isnone(L, 2) || lua_isnil(L, 2))
+        timeout_ms = -1;
+    else if (lua_isnumber(L, 2))
+        timeout_ms = lua_tointeger(L, 2);
+    else
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid type of argument 'timeout_ms', should be number or nil");
+
+    /* Fill ready table with serial ports that have data available, including
+     * bytes held in their receive buffer */
+    lua_settop(L, 1);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, pollset->ready_ref);
+
+    if (lua_periphery_epoll_set_wait(L, &pollset->set, timeout_ms, 2, 0) < 0) {
+        if (errno == ENOMEM)
+            return lua_serial_error(L, SERIAL_ERROR_ALLOC, errno, "Error: allocating memory");
+        return lua_serial_error(L, SERIAL_ERROR_IO, errno, "Error: polling serial poll set: %s [errno %d]", strerror(errno), errno);
+    }
+
+    return 1;
+}
+
+static void lua_serial_pollset_release(lua_State *L, lua_serial_pollset_t *pollset) {
+    lua_periphery_epoll_set_close(L, &pollset->set);
+
+    luaL_unref(L, LUA_REGISTRYINDEX, pollset->ready_ref);
+    pollset->ready_ref = LUA_NOREF;
+}
+
+static int lua_serial_pollset_close(lua_State *L) {
+    lua_serial_pollset_t *pollset;
+
+    pollset = luaL_checkudata(L, 1, "periphery.Serial.PollSet");
+
+    lua_serial_pollset_release(L, pollset);
+
+    return 0;
+}
+
+static int lua_serial_pollset_gc(lua_State *L) {
+    lua_serial_pollset_t *pollset;
+
+    pollset = luaL_checkudata(L, 1, "periphery.Serial.PollSet");
+
+    lua_serial_pollset_release(L, pollset);
+
+    return 0;
+}
+
+static int lua_serial_pollset_tostring(lua_State *L) {
+    lua_serial_pollset_t *pollset;
+
+    pollset = luaL_checkudata(L, 1, "periphery.Serial.PollSet");
+
+    lua_pushfstring(L, "Serial PollSet (fd=%d, count=%d)", pollset->set.epfd, (int)pollset->set.count);
+
+    return 1;
+}
+
+static int lua_serial_pollset_index(lua_State *L) {
+    lua_serial_pollset_t *pollset;
+    const char *field;
+
+    if (!lua_isstring(L, 2))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: unknown method or property");
+
+    field = lua_tostring(L, 2);
+
+    /* Look up method in metatable */
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, field);
+    if (!lua_isnil(L, -1))
+        return 1;
+
+    pollset = luaL_checkudata(L, 1, "periphery.Serial.PollSet");
+
+    if (strcmp(field, "fd") == 0) {
+        lua_pushinteger(L, pollset->set.epfd);
+        return 1;
+    } else if (strcmp(field, "count") == 0) {
+        lua_pushunsigned(L, pollset->set.count);
+        return 1;
+    }
+
+    return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static int lua_serial_pollset_newindex(lua_State *L) {
+    return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: immutable property");
+}
+
+static int lua_serial_buffer_new(lua_State *L) {
+    lua_serial_buffer_t *buffer;
+    size_t size;
+
+    /* Remove self table object */
+    lua_remove(L, 1);
+
+    lua_serial_checktype(L, 1, LUA_TNUMBER);
+
+    if (lua_tonumber(L, 1) < 1)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid buffer size, should be positive");
+
+    size = lua_tounsigned(L, 1);
+
+    /* Create byte buffer userdata */
+    buffer = lua_newuserdata(L, sizeof(lua_serial_buffer_t) + size);
+    buffer->size = size;
+    memset(buffer->data, 0, size);
+    /* Set Serial Buffer metatable on it */
+    luaL_getmetatable(L, "periphery.Serial.Buffer");
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
+
+/* Translate a 1-based index into the byte buffer, where negative indices
+ * count from the end as with string.sub(), to a 0-based offset, or -1 if it is
+ * out of range */
+static lua_Integer lua_serial_buffer_offset(lua_serial_buffer_t *buffer, lua_Integer index) {
+    if (index < 0)
+        index += (lua_Integer)buffer->size + 1;
+
+    if (index < 1 || (size_t)index > buffer->size)
+        return -1;
+
+    return index - 1;
+}
+
+static int lua_serial_buffer_sub(lua_State *L) {
+    lua_serial_buffer_t *buffer;
+    lua_Integer i, j;
+
+    buffer = (lua_serial_buffer_t *)luaL_checkudata(L, 1, "periphery.Serial.Buffer");
+
+    /* Optional start and end arguments, with the semantics of string.sub() */
+    i = (lua_isnone(L, 2) || lua_isnil(L, 2)) ? 1 : lua_tointeger(L, 2);
+    j = (lua_isnone(L, 3) || lua_isnil(L, 3)) ? -1 : lua_tointeger(L, 3);
+
+    if (i < 0)
+        i += (lua_Integer)buffer->size + 1;
+    if (j < 0)
+        j += (lua_Integer)buffer->size + 1;
+    if (i < 1)
+        i = 1;
+    if (j > (lua_Integer)buffer->size)
+        j = buffer->size;
+
+    if (i > j)
+        lua_pushstring(L, "");
+    else
+        lua_pushlstring(L, (char *)buffer->data + (i - 1), j - i + 1);
+
+    return 1;
+}
+
+static int lua_serial_buffer_len(lua_State *L) {
+    lua_serial_buffer_t *buffer;
+
+    buffer = (lua_serial_buffer_t *)luaL_checkudata(L, 1, "periphery.Serial.Buffer");
+
+    lua_pushunsigned(L, buffer->size);
+
+    return 1;
+}
+
+static int lua_serial_buffer_tostring(lua_State *L) {
+    lua_serial_buffer_t *buffer;
+
+    buffer = (lua_serial_buffer_t *)luaL_checkudata(L, 1, "periphery.Serial.Buffer");
+
+    lua_pushfstring(L, "Serial Buffer (size=%d)", (int)buffer->size);
+
+    return 1;
+}
+
+static int lua_serial_buffer_index(lua_State *L) {
+    lua_serial_buffer_t *buffer;
+    const char *field;
+
+    buffer = (lua_serial_buffer_t *)luaL_checkudata(L, 1, "periphery.Serial.Buffer");
+
+    /* Byte at index */
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        lua_Integer offset = lua_serial_buffer_offset(buffer, lua_tointeger(L, 2));
+
+        if (offset < 0)
+            return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: index out of range");
+
+        lua_pushinteger(L, buffer->data[offset]);
+        return 1;
+    }
+
+    if (!lua_isstring(L, 2))
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: unknown method or property");
+
+    field = lua_tostring(L, 2);
+
+    /* Look up method in metatable */
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, field);
+    if (!lua_isnil(L, -1))
+        return 1;
+
+    if (strcmp(field, "size") == 0) {
+        lua_pushunsigned(L, buffer->size);
+        return 1;
     }
 
     return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: unknown property");
 }
 
+static int lua_serial_buffer_newindex(lua_State *L) {
+    lua_serial_buffer_t *buffer;
+    lua_Integer offset, value;
+
+    buffer = (lua_serial_buffer_t *)luaL_checkudata(L, 1, "periphery.Serial.Buffer");
+
+    if (lua_type(L, 2) != LUA_TNUMBER)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: immutable property");
+
+    if ((offset = lua_serial_buffer_offset(buffer, lua_tointeger(L, 2))) < 0)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: index out of range");
+
+    lua_serial_checktype(L, 3, LUA_TNUMBER);
+
+    value = lua_tointeger(L, 3);
+    if (value < 0 || value > 255)
+        return lua_serial_error(L, SERIAL_ERROR_ARG, 0, "Error: invalid byte value, should be between 0 and 255");
+
+    buffer->data[offset] = (uint8_t)value;
+
+    return 0;
+}
+
+static const struct luaL_Reg periphery_serial_buffer_m[] = {
+    {"sub", lua_serial_buffer_sub},
+    {"__len", lua_serial_buffer_len},
+    {"__tostring", lua_serial_buffer_tostring},
+    {"__index", lua_serial_buffer_index},
+    {"__newindex", lua_serial_buffer_newindex},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg periphery_serial_pollset_m[] = {
+    {"close", lua_serial_pollset_close},
+    {"add", lua_serial_pollset_add},
+    {"remove", lua_serial_pollset_remove},
+    {"wait", lua_serial_pollset_wait},
+    {"__gc", lua_serial_pollset_gc},
+    {"__tostring", lua_serial_pollset_tostring},
+    {"__index", lua_serial_pollset_index},
+    {"__newindex", lua_serial_pollset_newindex},
+    {NULL, NULL}
+};
+
 static const struct luaL_Reg periphery_serial_m[] = {
     {"close", lua_serial_close},
     {"read", lua_serial_read},
+    {"read_into", lua_serial_read_into},
+    {"read_until", lua_serial_read_until},
+    {"read_line", lua_serial_read_line},
     {"write", lua_serial_write},
+    {"set_framing", lua_serial_set_framing},
+    {"read_frame", lua_serial_read_frame},
+    {"write_frame", lua_serial_write_frame},
+    {"set_rs485", lua_serial_set_rs485},
+    {"get_rs485", lua_serial_get_rs485},
+    {"send_file", lua_serial_send_file},
+    {"capture_to_file", lua_serial_capture_to_file},
     {"flush", lua_serial_flush},
     {"input_waiting", lua_serial_input_waiting},
     {"output_waiting", lua_serial_output_waiting},
     {"poll", lua_serial_poll},
     {"__gc", lua_serial_gc},
+    {"poll_multiple", lua_serial_poll_multiple},
     {"__tostring", lua_serial_tostring},
     {"__index", lua_serial_index},
     {"__newindex", lua_serial_newindex},
@@ -615,6 +3045,14 @@ static const struct luaL_Reg periphery_serial_m[] = {
 };
 
 LUALIB_API int luaopen_periphery_serial(lua_State *L) {
+    /* Create weak-keyed set of serial ports with buffered bytes */
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushstring(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, LUA_REGISTRYINDEX, "periphery.Serial.buffered");
+
     /* Create periphery.Serial metatable */
     luaL_newmetatable(L, "periphery.Serial");
     /* Set metatable functions */
@@ -627,6 +3065,52 @@ LUALIB_API int luaopen_periphery_serial(lua_State *L) {
     lua_pushstring(L, "protected metatable");
     lua_setfield(L, -2, "__metatable");
 
+    /* Create periphery.Serial.PollSet metatable */
+    luaL_newmetatable(L, "periphery.Serial.PollSet");
+    /* Set metatable functions */
+    funcs = (const struct luaL_Reg *)periphery_serial_pollset_m;
+    for (; funcs->name != NULL; funcs++) {
+        lua_pushcclosure(L, funcs->func, 0);
+        lua_setfield(L, -2, funcs->name);
+    }
+    /* Set metatable properties */
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+
+    /* Create {__call = lua_serial_pollset_new, __metatable = "protected metatable"} table */
+    lua_newtable(L);
+    lua_pushcclosure(L, lua_serial_pollset_new, 0);
+    lua_setfield(L, -2, "__call");
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+    /* Set it as the metatable for the periphery.Serial.PollSet metatable */
+    lua_setmetatable(L, -2);
+    /* Set it as the PollSet field of the periphery.Serial metatable */
+    lua_setfield(L, -2, "PollSet");
+
+    /* Create periphery.Serial.Buffer metatable */
+    luaL_newmetatable(L, "periphery.Serial.Buffer");
+    /* Set metatable functions */
+    funcs = (const struct luaL_Reg *)periphery_serial_buffer_m;
+    for (; funcs->name != NULL; funcs++) {
+        lua_pushcclosure(L, funcs->func, 0);
+        lua_setfield(L, -2, funcs->name);
+    }
+    /* Set metatable properties */
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+
+    /* Create {__call = lua_serial_buffer_new, __metatable = "protected metatable"} table */
+    lua_newtable(L);
+    lua_pushcclosure(L, lua_serial_buffer_new, 0);
+    lua_setfield(L, -2, "__call");
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+    /* Set it as the metatable for the periphery.Serial.Buffer metatable */
+    lua_setmetatable(L, -2);
+    /* Set it as the Buffer field of the periphery.Serial metatable */
+    lua_setfield(L, -2, "Buffer");
+
     /* Create {__call = lua_serial_new, __metatable = "protected metatable"} table */
     lua_newtable(L);
     lua_pushcclosure(L, lua_serial_new, 0);
@@ -0,0 +1,454 @@
+/*
+ * lua-periphery by vsergeev
+ * https://github.com/vsergeev/lua-periphery
+ * License: MIT
+ */
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "lua_periphery.h"
+#include "lua_compat.h"
+
+/*
+local periphery = require('periphery')
+local Timer = periphery.Timer
+
+-- Constructor
+timer = Timer(interval_us <number>)
+timer = Timer{interval_us=<number>, absolute=false, clock="monotonic"}
+
+-- Methods
+timer:wait() --> <number>
+timer:start()
+timer:stop()
+timer:close()
+
+-- Properties
+timer.interval_us   mutable <number>
+timer.absolute      immutable <boolean>
+timer.clock         immutable <string>
+timer.overruns      immutable <number>
+timer.running       immutable <boolean>
+timer.fd            immutable <number>
+*/
+
+enum timer_error_code {
+    TIMER_ERROR_ARG         = -1, /* Invalid arguments */
+    TIMER_ERROR_OPEN        = -2, /* Creating timer */
+    TIMER_ERROR_IO          = -3, /* Arming or reading timer */
+};
+
+static const char *timer_error_code_strings[] = {
+    [-TIMER_ERROR_ARG]      = "TIMER_ERROR_ARG",
+    [-TIMER_ERROR_OPEN]     = "TIMER_ERROR_OPEN",
+    [-TIMER_ERROR_IO]       = "TIMER_ERROR_IO",
+};
+
+static const struct {
+    const char *name;
+    clockid_t clock;
+} timer_clocks[] = {
+    {"monotonic", CLOCK_MONOTONIC},
+    {"realtime", CLOCK_REALTIME},
+    {"boottime", CLOCK_BOOTTIME},
+    {NULL, 0}
+};
+
+/* Timer userdata */
+typedef struct lua_timer {
+    int fd;
+    unsigned int clock_index;
+    uint64_t interval_ns;
+    bool absolute;
+    bool running;
+    /* Total number of missed expirations */
+    uint64_t overruns;
+} lua_timer_t;
+
+static int lua_timer_error(lua_State *L, enum timer_error_code code, int c_errno, const char *fmt, ...) {
+    char message[128];
+    va_list ap;
+
+    va_start(ap, fmt);
+
+    /* Create error table */
+    lua_newtable(L);
+    /* .code string */
+    lua_pushstring(L, timer_error_code_strings[-code]);
+    lua_setfield(L, -2, "code");
+    /* .c_errno number */
+    lua_pushinteger(L, c_errno);
+    lua_setfield(L, -2, "c_errno");
+    /* .message string */
+    vsnprintf(message, sizeof(message), fmt, ap);
+    lua_pushstring(L, message);
+    lua_setfield(L, -2, "message");
+
+    va_end(ap);
+
+    /* Set error metatable on it */
+    luaL_getmetatable(L, "periphery.error");
+    lua_setmetatable(L, -2);
+
+    return lua_error(L);
+}
+
+static lua_timer_t *lua_timer_checkopen(lua_State *L, int index) {
+    lua_timer_t *timer = luaL_checkudata(L, index, "periphery.Timer");
+
+    if (timer->fd < 0)
+        lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: timer is closed");
+
+    return timer;
+}
+
+static void lua_timer_ns_to_timespec(uint64_t ns, struct timespec *ts) {
+    ts->tv_sec = ns / 1000000000;
+    ts->tv_nsec = ns % 1000000000;
+}
+
+static void lua_timer_arm(lua_State *L, lua_timer_t *timer) {
+    struct itimerspec its;
+    int flags = 0;
+
+    lua_timer_ns_to_timespec(timer->interval_ns, &its.it_interval);
+
+    if (timer->absolute) {
+        struct timespec ts;
+        uint64_t now_ns;
+
+        /* Align expirations to multiples of the interval on the clock */
+        if (clock_gettime(timer_clocks[timer->clock_index].clock, &ts) < 0)
+            lua_timer_error(L, TIMER_ERROR_IO, errno, "Error: reading clock: %s [errno %d]", strerror(errno), errno);
+
+        now_ns = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+        lua_timer_ns_to_timespec((now_ns / timer->interval_ns + 1) * timer->interval_ns, &its.it_value);
+        flags = TFD_TIMER_ABSTIME;
+    } else {
+        lua_timer_ns_to_timespec(timer->interval_ns, &its.it_value);
+    }
+
+    if (timerfd_settime(timer->fd, flags, &its, NULL) < 0)
+        lua_timer_error(L, TIMER_ERROR_IO, errno, "Error: arming timer: %s [errno %d]", strerror(errno), errno);
+
+    timer->running = true;
+}
+
+static void lua_timer_disarm(lua_State *L, lua_timer_t *timer) {
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+
+    if (timerfd_settime(timer->fd, 0, &its, NULL) < 0)
+        lua_timer_error(L, TIMER_ERROR_IO, errno, "Error: disarming timer: %s [errno %d]", strerror(errno), errno);
+
+    timer->running = false;
+}
+
+static uint64_t lua_timer_check_interval(lua_State *L, int index) {
+    if (!lua_isnumber(L, index) || lua_tonumber(L, index) < 1)
+        lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: invalid interval_us, should be a positive number");
+
+    return (uint64_t)lua_tonumber(L, index) * 1000;
+}
+
+static int lua_timer_new(lua_State *L) {
+    lua_timer_t *timer;
+    uint64_t interval_ns;
+    unsigned int clock_index = 0;
+    bool absolute = false;
+
+    /* Remove self table object */
+    lua_remove(L, 1);
+
+    /* Arguments passed in table form */
+    if (lua_istable(L, 1)) {
+        lua_getfield(L, 1, "interval_us");
+        if (!lua_isnumber(L, -1))
+            return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: invalid type of table argument 'interval_us', should be number");
+        interval_ns = lua_timer_check_interval(L, -1);
+        lua_pop(L, 1);
+
+        /* Optional absolute */
+        lua_getfield(L, 1, "absolute");
+        if (lua_isboolean(L, -1))
+            absolute = lua_toboolean(L, -1);
+        else if (!lua_isnil(L, -1))
+            return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: invalid type of table argument 'absolute', should be boolean");
+        lua_pop(L, 1);
+
+        /* Optional clock */
+        lua_getfield(L, 1, "clock");
+        if (lua_isstring(L, -1)) {
+            const char *clock = lua_tostring(L, -1);
+
+            for (clock_index = 0; timer_clocks[clock_index].name != NULL; clock_index++) {
+                if (strcmp(clock, timer_clocks[clock_index].name) == 0)
+                    break;
+            }
+
+            if (timer_clocks[clock_index].name == NULL)
+                return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: invalid table argument 'clock', should be 'monotonic', 'realtime', 'boottime'");
+        } else if (!lua_isnil(L, -1))
+            return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: invalid type of table argument 'clock', should be string");
+        lua_pop(L, 1);
+    } else {
+        interval_ns = lua_timer_check_interval(L, 1);
+    }
+
+    /* Create handle userdata */
+    timer = lua_newuserdata(L, sizeof(lua_timer_t));
+    timer->fd = -1;
+    timer->clock_index = clock_index;
+    timer->interval_ns = interval_ns;
+    timer->absolute = absolute;
+    timer->running = false;
+    timer->overruns = 0;
+    /* Set Timer metatable on it */
+    luaL_getmetatable(L, "periphery.Timer");
+    lua_setmetatable(L, -2);
+
+    if ((timer->fd = timerfd_create(timer_clocks[clock_index].clock, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+        return lua_timer_error(L, TIMER_ERROR_OPEN, errno, "Error: creating timer: %s [errno %d]", strerror(errno), errno);
+
+    lua_timer_arm(L, timer);
+
+    return 1;
+}
+
+/* Read the expirations since the last read, or 0 if the timer has not expired
+ * yet */
+static uint64_t lua_timer_read(lua_State *L, lua_timer_t *timer) {
+    uint64_t expirations;
+
+    if (read(timer->fd, &expirations, sizeof(expirations)) < 0) {
+        if (errno == EAGAIN)
+            return 0;
+
+        lua_timer_error(L, TIMER_ERROR_IO, errno, "Error: reading timer: %s [errno %d]", strerror(errno), errno);
+    }
+
+    return expirations;
+}
+
+static int lua_timer_wait_k(lua_State *L) {
+    lua_timer_t *timer;
+    uint64_t expirations;
+
+    timer = lua_timer_checkopen(L, 1);
+
+    if (!timer->running)
+        return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: timer is stopped");
+
+    while ((expirations = lua_timer_read(L, timer)) == 0) {
+        struct pollfd fds[1];
+
+        if (lua_periphery_loop_can_yield(L))
+            return lua_periphery_loop_wait(L, timer->fd, POLLIN, -1, lua_timer_wait_k);
+
+        fds[0].fd = timer->fd;
+        fds[0].events = POLLIN;
+
+        if (poll(fds, 1, -1) < 0 && errno != EINTR)
+            return lua_timer_error(L, TIMER_ERROR_IO, errno, "Error: polling timer: %s [errno %d]", strerror(errno), errno);
+    }
+
+    timer->overruns += expirations - 1;
+
+    lua_pushnumber(L, (lua_Number)(expirations - 1));
+
+    return 1;
+}
+
+static int lua_timer_wait(lua_State *L) {
+    lua_settop(L, 1);
+
+    return lua_timer_wait_k(L);
+}
+
+static int lua_timer_start(lua_State *L) {
+    lua_timer_t *timer;
+
+    timer = lua_timer_checkopen(L, 1);
+
+    lua_timer_arm(L, timer);
+
+    return 0;
+}
+
+static int lua_timer_stop(lua_State *L) {
+    lua_timer_t *timer;
+
+    timer = lua_timer_checkopen(L, 1);
+
+    lua_timer_disarm(L, timer);
+
+    return 0;
+}
+
+static int lua_timer_close(lua_State *L) {
+    lua_timer_t *timer;
+
+    timer = luaL_checkudata(L, 1, "periphery.Timer");
+
+    if (timer->fd >= 0) {
+        if (close(timer->fd) < 0) {
+            timer->fd = -1;
+            return lua_timer_error(L, TIMER_ERROR_IO, errno, "Error: closing timer: %s [errno %d]", strerror(errno), errno);
+        }
+        timer->fd = -1;
+    }
+
+    timer->running = false;
+
+    return 0;
+}
+
+static int lua_timer_gc(lua_State *L) {
+    lua_timer_t *timer;
+
+    timer = luaL_checkudata(L, 1, "periphery.Timer");
+
+    if (timer->fd >= 0) {
+        close(timer->fd);
+        timer->fd = -1;
+    }
+
+    return 0;
+}
+
+static int lua_timer_tostring(lua_State *L) {
+    lua_timer_t *timer;
+    char interval_str[24];
+
+    timer = luaL_checkudata(L, 1, "periphery.Timer");
+
+    if (timer->fd < 0) {
+        lua_pushstring(L, "Timer (closed)");
+        return 1;
+    }
+
+    snprintf(interval_str, sizeof(interval_str), "%llu", (unsigned long long)(timer->interval_ns / 1000));
+
+    lua_pushfstring(L, "Timer (fd=%d, interval_us=%s, absolute=%s, clock=%s, running=%s)",
+                    timer->fd, interval_str, timer->absolute ? "true" : "false",
+                    timer_clocks[timer->clock_index].name, timer->running ? "true" : "false");
+
+    return 1;
+}
+
+static int lua_timer_index(lua_State *L) {
+    lua_timer_t *timer;
+    const char *field;
+
+    if (!lua_isstring(L, 2))
+        return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: unknown method or property");
+
+    field = lua_tostring(L, 2);
+
+    /* Look up method in metatable */
+    lua_getmetatable(L, 1);
+    lua_getfield(L, -1, field);
+    if (!lua_isnil(L, -1))
+        return 1;
+
+    timer = luaL_checkudata(L, 1, "periphery.Timer");
+
+    if (strcmp(field, "fd") == 0) {
+        lua_pushinteger(L, timer->fd);
+        return 1;
+    } else if (strcmp(field, "interval_us") == 0) {
+        lua_pushnumber(L, (lua_Number)(timer->interval_ns / 1000));
+        return 1;
+    } else if (strcmp(field, "absolute") == 0) {
+        lua_pushboolean(L, timer->absolute);
+        return 1;
+    } else if (strcmp(field, "clock") == 0) {
+        lua_pushstring(L, timer_clocks[timer->clock_index].name);
+        return 1;
+    } else if (strcmp(field, "overruns") == 0) {
+        lua_pushnumber(L, (lua_Number)timer->overruns);
+        return 1;
+    } else if (strcmp(field, "running") == 0) {
+        lua_pushboolean(L, timer->running);
+        return 1;
+    }
+
+    return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static int lua_timer_newindex(lua_State *L) {
+    lua_timer_t *timer;
+    const char *field;
+
+    timer = lua_timer_checkopen(L, 1);
+
+    if (!lua_isstring(L, 2))
+        return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: unknown property");
+
+    field = lua_tostring(L, 2);
+
+    if (strcmp(field, "interval_us") == 0) {
+        timer->interval_ns = lua_timer_check_interval(L, 3);
+
+        /* Restart a running timer with the new interval */
+        if (timer->running)
+            lua_timer_arm(L, timer);
+
+        return 0;
+    } else if (strcmp(field, "fd") == 0 || strcmp(field, "absolute") == 0 || strcmp(field, "clock") == 0 ||
+               strcmp(field, "overruns") == 0 || strcmp(field, "running") == 0) {
+        return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: immutable property");
+    }
+
+    return lua_timer_error(L, TIMER_ERROR_ARG, 0, "Error: unknown property");
+}
+
+static const struct luaL_Reg periphery_timer_m[] = {
+    {"close", lua_timer_close},
+    {"wait", lua_timer_wait},
+    {"start", lua_timer_start},
+    {"stop", lua_timer_stop},
+    {"__gc", lua_timer_gc},
+    {"__tostring", lua_timer_tostring},
+    {"__index", lua_timer_index},
+    {"__newindex", lua_timer_newindex},
+    {NULL, NULL}
+};
+
+LUALIB_API int luaopen_periphery_timer(lua_State *L) {
+    /* Create periphery.Timer metatable */
+    luaL_newmetatable(L, "periphery.Timer");
+    /* Set metatable functions */
+    const struct luaL_Reg *funcs = (const struct luaL_Reg *)periphery_timer_m;
+    for (; funcs->name != NULL; funcs++) {
+        lua_pushcclosure(L, funcs->func, 0);
+        lua_setfield(L, -2, funcs->name);
+    }
+    /* Set metatable properties */
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+
+    /* Create {__call = lua_timer_new, __metatable = "protected metatable"} table */
+    lua_newtable(L);
+    lua_pushcclosure(L, lua_timer_new, 0);
+    lua_setfield(L, -2, "__call");
+    lua_pushstring(L, "protected metatable");
+    lua_setfield(L, -2, "__metatable");
+    /* Set it as the metatable for the periphery.Timer metatable */
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
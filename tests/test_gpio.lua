@@ -31,6 +31,9 @@ function test_arguments()
     -- Invalid direction
     passert_periphery_error("invalid direction", function () gpio = GPIO("abc", 1, "blah") end, "GPIO_ERROR_ARG")
     passert_periphery_error("invalid direction", function () gpio = GPIO{path="abc", line=1, direction="blah"} end, "GPIO_ERROR_ARG")
+    -- Invalid debounce and event clock
+    passert_periphery_error("invalid debounce", function () gpio = GPIO{path="abc", line=1, direction="in", debounce_us="blah"} end, "GPIO_ERROR_ARG")
+    passert_periphery_error("invalid event clock", function () gpio = GPIO{path="abc", line=1, direction="in", event_clock="blah"} end, "GPIO_ERROR_ARG")
 end
 
 function test_open_config_close()
@@ -96,6 +99,10 @@ function test_open_config_close()
     passert_periphery_error("set interrupt edge on output GPIO", function () gpio.edge = "rising" end, "GPIO_ERROR_INVALID_OPERATION")
     -- Attempt to read event on output GPIO
     passert_periphery_error("read event on output GPIO", function () gpio:read_event() end, "GPIO_ERROR_INVALID_OPERATION")
+    -- Attempt to start capture on output GPIO
+    passert_periphery_error("start capture on output GPIO", function () gpio:capture_start{mode="count"} end, "GPIO_ERROR_INVALID_OPERATION")
+    -- Attempt to start capture with invalid mode
+    passert_periphery_error("start capture with invalid mode", function () gpio:capture_start{mode="foo"} end, "GPIO_ERROR_ARG")
 
     -- Set direction in, check direction in
     passert_periphery_success("set direction", function () gpio.direction = "in" end)
@@ -133,6 +140,25 @@ function test_open_config_close()
     -- Attempt to set drive on input GPIO
     passert_periphery_error("set drive on input GPIO", function () gpio.drive = "open_drain" end, "GPIO_ERROR_INVALID_OPERATION")
 
+    -- Set invalid event clock
+    passert_periphery_error("set invalid event clock", function () gpio.event_clock = "blah" end, "GPIO_ERROR_ARG")
+    -- Set debounce 1000 us, check debounce 1000 us
+    passert_periphery_success("set debounce 1000 us", function () gpio.debounce_us = 1000 end)
+    passert("debounce is 1000 us", gpio.debounce_us == 1000)
+    -- Set event clock monotonic, check event clock monotonic
+    passert_periphery_success("set event clock monotonic", function () gpio.event_clock = "monotonic" end)
+    passert("event clock is monotonic", gpio.event_clock == "monotonic")
+    -- Set event clock realtime, check event clock realtime
+    passert_periphery_success("set event clock realtime", function () gpio.event_clock = "realtime" end)
+    passert("event clock is realtime", gpio.event_clock == "realtime")
+    -- Set edge both, check debounce is retained
+    passert_periphery_success("set edge both", function () gpio.edge = "both" end)
+    passert("debounce is 1000 us", gpio.debounce_us == 1000)
+    passert_periphery_success("set edge none", function () gpio.edge = "none" end)
+    -- Set debounce 0 us, check debounce 0 us
+    passert_periphery_success("set debounce 0 us", function () gpio.debounce_us = 0 end)
+    passert("debounce is 0 us", gpio.debounce_us == 0)
+
     -- Close gpio
     passert_periphery_success("close gpio", function () gpio:close() end)
 
@@ -157,6 +183,12 @@ function test_open_config_close()
     passert("inverted is false", gpio.inverted == false)
     passert("label is test123", gpio.label == "test123")
     passert_periphery_success("close gpio", function () gpio:close() end)
+
+    -- Open with debounce and event clock table arguments
+    passert_periphery_success("real GPIO", function () gpio = GPIO{path=path, line=line_input, direction="in", edge="both", debounce_us=500, event_clock="monotonic"} end)
+    passert("debounce is 500 us", gpio.debounce_us == 500)
+    passert("event clock is monotonic", gpio.event_clock == "monotonic")
+    passert_periphery_success("close gpio", function () gpio:close() end)
 end
 
 function test_loopback()
@@ -251,6 +283,93 @@ function test_loopback()
     local gpios_ready = GPIO.poll_multiple({gpio_in}, 1000)
     passert("poll_multiple timed out", #gpios_ready == 0)
 
+    -- Test PollSet API with one GPIO
+
+    local pollset = nil
+    passert_periphery_success("create poll set", function () pollset = GPIO.PollSet({gpio_in}) end)
+    passert("poll set count is 1", pollset.count == 1)
+    passert("poll set fd >= 0", pollset.fd >= 0)
+
+    -- Check poll falling 1 -> 0 interrupt
+    print("Check poll falling 1 -> 0 interrupt with PollSet")
+    passert_periphery_success("write gpio out low", function () gpio_out:write(false) end)
+    local gpios_ready = pollset:wait(1000)
+    passert("gpios_ready length is 1", #gpios_ready == 1)
+    passert("gpios_ready[1] is gpio in", gpios_ready[1] == gpio_in)
+    local event = gpio_in:read_event()
+    passert("event edge is falling", event.edge == "falling")
+
+    -- Check poll rising 0 -> 1 interrupt, and result table reuse
+    print("Check poll rising 0 -> 1 interrupt with PollSet")
+    passert_periphery_success("write gpio out high", function () gpio_out:write(true) end)
+    passert("gpios_ready table is reused", pollset:wait(1000) == gpios_ready)
+    passert("gpios_ready length is 1", #gpios_ready == 1)
+    local event = gpio_in:read_event()
+    passert("event edge is rising", event.edge == "rising")
+
+    -- Check poll timeout
+    passert("pollset timed out", #pollset:wait(1000) == 0)
+
+    -- Check removal
+    passert_periphery_success("remove gpio in", function () pollset:remove(gpio_in) end)
+    passert("poll set count is 0", pollset.count == 0)
+    passert_periphery_success("write gpio out low", function () gpio_out:write(false) end)
+    passert("pollset timed out", #pollset:wait(100) == 0)
+    gpio_in:read_event()
+
+    passert_periphery_success("close poll set", function () pollset:close() end)
+
+    -- Test native capture
+
+    print("Check pulse capture")
+    passert_periphery_success("start capture", function () gpio_in:capture_start{mode="pulse"} end)
+    passert_periphery_error("start capture again", function () gpio_in:capture_start{mode="pulse"} end, "GPIO_ERROR_INVALID_OPERATION")
+    passert_periphery_error("poll during capture", function () gpio_in:poll(0) end, "GPIO_ERROR_INVALID_OPERATION")
+    passert_periphery_error("set edge during capture", function () gpio_in.edge = "rising" end, "GPIO_ERROR_INVALID_OPERATION")
+    passert_periphery_error("set bias during capture", function () gpio_in.bias = "pull_up" end, "GPIO_ERROR_INVALID_OPERATION")
+    passert("get edge during capture", gpio_in.edge == "both")
+    passert("get bias during capture", type(gpio_in.bias) == "string")
+    passert("get drive during capture", type(gpio_in.drive) == "string")
+    for i = 1, 10 do
+        gpio_out:write(true)
+        periphery.sleep_ms(2)
+        gpio_out:write(false)
+        periphery.sleep_ms(2)
+    end
+    periphery.sleep_ms(10)
+    local stats = gpio_in:capture_read()
+    passert("capture count is 10", stats.count == 10)
+    passert("capture period is measured", stats.period_mean_ns ~= nil and stats.period_min_ns <= stats.period_max_ns)
+    passert("capture pulse is measured", stats.pulse_mean_ns ~= nil and stats.pulse_mean_ns < stats.period_mean_ns)
+    passert("capture duty cycle is in range", stats.duty_cycle > 0 and stats.duty_cycle < 1)
+    passert_periphery_success("stop capture", function () gpio_in:capture_stop() end)
+    passert_periphery_error("read stopped capture", function () gpio_in:capture_read() end, "GPIO_ERROR_INVALID_OPERATION")
+
+    -- Test native event buffer
+
+    print("Check buffered events with drain()")
+    passert_periphery_success("start event buffer", function () gpio_in:buffer_start(4) end)
+    passert_periphery_error("start capture during buffering", function () gpio_in:capture_start{mode="count"} end, "GPIO_ERROR_INVALID_OPERATION")
+    local events, dropped = gpio_in:drain()
+    passert("no events buffered", #events == 0 and dropped == 0)
+    passert_periphery_success("write gpio out high", function () gpio_out:write(true) end)
+    passert_periphery_success("write gpio out low", function () gpio_out:write(false) end)
+    periphery.sleep_ms(10)
+    local events, dropped = gpio_in:drain()
+    passert("two events buffered", #events == 2 and dropped == 0)
+    passert("event edges are rising, falling", events[1].edge == "rising" and events[2].edge == "falling")
+    passert("event timestamps are ordered", events[1].timestamp <= events[2].timestamp)
+    for i = 1, 4 do
+        gpio_out:write(true)
+        gpio_out:write(false)
+        periphery.sleep_ms(1)
+    end
+    periphery.sleep_ms(10)
+    local events, dropped = gpio_in:drain()
+    passert("buffer overflowed", #events == 4 and dropped == 4)
+    passert_periphery_success("stop event buffer", function () gpio_in:buffer_stop() end)
+    passert_periphery_error("drain stopped buffer", function () gpio_in:drain() end, "GPIO_ERROR_INVALID_OPERATION")
+
     passert_periphery_success("close gpio in", function () gpio_in:close() end)
     passert_periphery_success("close gpio out", function () gpio_out:close() end)
 
@@ -187,6 +187,29 @@ function test_loopback()
     local gpios_ready = GPIO.poll_multiple({gpio_in}, 1000)
     passert("poll_multiple timed out", #gpios_ready == 0)
 
+    -- Test poll() in a periphery.loop task, which yields to the scheduler
+
+    if _VERSION:match("%d.%d") ~= "5.1" then
+        local polled = {}
+
+        -- Check poll falling 1 -> 0 interrupt
+        print("Check poll falling 1 -> 0 interrupt in loop task")
+        periphery.loop.spawn(function () polled[#polled+1] = gpio_in:poll(1000) end)
+        periphery.loop.spawn(function ()
+            periphery.loop.sleep_ms(100)
+            gpio_out:write(false)
+        end)
+        passert_periphery_success("run loop", function () periphery.loop.run() end)
+        passert("gpio in polled 1", polled[1] == true)
+        passert("gpio in value is low", gpio_in:read() == false)
+
+        -- Check poll timeout
+        print("Check poll timeout in loop task")
+        periphery.loop.spawn(function () polled[#polled+1] = gpio_in:poll(100) end)
+        passert_periphery_success("run loop", function () periphery.loop.run() end)
+        passert("poll timed out", polled[2] == false)
+    end
+
     passert_periphery_success("close gpio in", function () gpio_in:close() end)
     passert_periphery_success("close gpio out", function () gpio_out:close() end)
 end
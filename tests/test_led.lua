@@ -73,6 +73,47 @@ function test_open_config_close()
     periphery.sleep_ms(10)
     passert("brightness is zero", led.brightness == 0)
 
+    -- Check triggers
+    passert("triggers is table", type(led.triggers) == "table")
+    passert_periphery_error("set immutable triggers", function () led.triggers = {} end, "LED_ERROR_ARG")
+    passert_periphery_success("set trigger none", function () led.trigger = "none" end)
+    passert("trigger is none", led.trigger == "none")
+    passert_periphery_error("set invalid trigger", function () led.trigger = "nonexistent" end, "LED_ERROR_IO", 22)
+    passert_periphery_error("invalid blink type", function () led:blink("foo", 100) end, "LED_ERROR_ARG")
+    passert_periphery_error("invalid pattern", function () led:pattern({}) end, "LED_ERROR_ARG")
+
+    -- Blink with timer trigger, if available
+    local has_timer = false
+    for _, trigger in ipairs(led.triggers) do
+        has_timer = has_timer or trigger == "timer"
+    end
+    if has_timer then
+        passert_periphery_success("blink", function () led:blink(100, 200) end)
+        passert("trigger is timer", led.trigger == "timer")
+        passert("delay_on is 100", led.delay_on == 100)
+        passert("delay_off is 200", led.delay_off == 200)
+        led.delay_on = 50
+        passert("delay_on is 50", led.delay_on == 50)
+        passert_periphery_success("set trigger none", function () led.trigger = "none" end)
+    end
+
+    -- Group
+    local group = nil
+    passert_periphery_error("empty group", function () group = LED.group({}) end, "LED_ERROR_ARG")
+    passert_periphery_error("invalid group member", function () group = LED.group({123}) end, "LED_ERROR_ARG")
+    passert_periphery_error("non-existent group member", function () group = LED.group({"nonexistent"}) end, "LED_ERROR_OPEN", 2)
+    passert_periphery_success("group", function () group = LED.group({led_name, led}) end)
+    passert("group count", group.count == 2)
+    passert_periphery_error("invalid number of values", function () group:write_all({true}) end, "LED_ERROR_ARG")
+    passert_periphery_success("write all", function () group:write_all({true, true}) end)
+    passert("brightness is max", led.brightness == led.max_brightness)
+    passert("unchanged values are skipped", group:write_all({true, true}) == 0)
+    passert("changed values are written", group:write_all({0, true}) == 1)
+    passert("brightness is zero", led.brightness == 0)
+    passert("read all", group:read_all()[1] == 0)
+    passert_periphery_success("close group", function () group:close() end)
+    passert_periphery_error("write all on closed group", function () group:write_all({0, 0}) end, "LED_ERROR_ARG")
+
     -- Close LED
     passert_periphery_success("close LED", function () led:close() end)
 
@@ -0,0 +1,120 @@
+--
+-- lua-periphery by vsergeev
+-- https://github.com/vsergeev/lua-periphery
+-- License: MIT
+--
+
+require('test')
+local periphery = require('periphery')
+local loop = periphery.loop
+
+--------------------------------------------------------------------------------
+
+local yieldable = _VERSION:match("%d.%d") ~= "5.1"
+
+--------------------------------------------------------------------------------
+
+function test_arguments()
+    ptest()
+
+    -- Invalid task function
+    passert_periphery_error("invalid function", function () loop.spawn(nil) end, "LOOP_ERROR_ARG")
+    passert_periphery_error("invalid function", function () loop.spawn("foo") end, "LOOP_ERROR_ARG")
+
+    -- Run while running
+    loop.spawn(function () loop.run() end)
+    passert_periphery_error("run while running", function () loop.run() end, "LOOP_ERROR_ARG")
+    passert("no tasks", loop.count() == 0)
+end
+
+function test_scheduling()
+    local trace = {}
+
+    ptest()
+
+    -- Spawn with arguments
+    passert("spawn returns thread", type(loop.spawn(function (a, b) trace[#trace+1] = a + b end, 1, 2)) == "thread")
+    passert("one task", loop.count() == 1)
+    passert_periphery_success("run", function () loop.run() end)
+    passert("task ran with arguments", #trace == 1 and trace[1] == 3)
+    passert("no tasks", loop.count() == 0)
+
+    -- Interleave on coroutine.yield()
+    trace = {}
+    for _, name in ipairs({"a", "b"}) do
+        loop.spawn(function ()
+            for i = 1, 3 do
+                trace[#trace+1] = name .. i
+                coroutine.yield()
+            end
+        end)
+    end
+    passert("two tasks", loop.count() == 2)
+    passert_periphery_success("run", function () loop.run() end)
+    passert("tasks interleaved", table.concat(trace, ",") == "a1,b1,a2,b2,a3,b3")
+
+    -- Spawn from task
+    trace = {}
+    loop.spawn(function ()
+        loop.spawn(function () trace[#trace+1] = "child" end)
+        trace[#trace+1] = "parent"
+    end)
+    passert_periphery_success("run", function () loop.run() end)
+    passert("child task ran", table.concat(trace, ",") == "parent,child")
+end
+
+function test_sleep()
+    local trace = {}
+
+    ptest()
+
+    -- Sleeping tasks wake up in deadline order
+    for _, duration in ipairs({60, 20, 40}) do
+        loop.spawn(function ()
+            loop.sleep_ms(duration)
+            trace[#trace+1] = duration
+        end)
+    end
+
+    passert_periphery_success("run", function () loop.run() end)
+
+    if yieldable then
+        passert("tasks woke up in order", table.concat(trace, ",") == "20,40,60")
+    else
+        passert("tasks ran in order", table.concat(trace, ",") == "60,20,40")
+    end
+    passert("no tasks", loop.count() == 0)
+
+    -- Sleep outside of task
+    passert_periphery_success("sleep outside of task", function () loop.sleep_ms(1) end)
+end
+
+function test_errors()
+    local trace = {}
+
+    ptest()
+
+    -- Task error propagates from run()
+    loop.spawn(function () error("task failed") end)
+    loop.spawn(function () trace[#trace+1] = "other" end)
+
+    local status, err = pcall(loop.run)
+    passert("run failed", status == false)
+    passert("task error propagated", type(err) == "string" and err:find("task failed") ~= nil)
+
+    -- Other tasks remain scheduled
+    passert_periphery_success("run", function () loop.run() end)
+    passert("other task ran", #trace == 1 and trace[1] == "other")
+    passert("no tasks", loop.count() == 0)
+end
+
+test_arguments()
+pokay("Arguments test passed.")
+test_scheduling()
+pokay("Scheduling test passed.")
+test_sleep()
+pokay("Sleep test passed.")
+test_errors()
+pokay("Errors test passed.")
+
+pokay("All tests passed!")
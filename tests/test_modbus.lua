@@ -0,0 +1,118 @@
+--
+-- lua-periphery by vsergeev
+-- https://github.com/vsergeev/lua-periphery
+-- License: MIT
+--
+
+require('test')
+local periphery = require('periphery')
+local Serial = periphery.Serial
+local ModbusRTU = periphery.ModbusRTU
+
+--------------------------------------------------------------------------------
+
+local device = nil
+
+--------------------------------------------------------------------------------
+
+function test_arguments()
+    local modbus = nil
+
+    ptest()
+
+    -- Invalid serial object
+    passert_periphery_error("invalid serial", function () modbus = ModbusRTU("/dev/ttyUSB0") end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("invalid serial", function () modbus = ModbusRTU{serial="/dev/ttyUSB0"} end, "MODBUS_ERROR_ARG")
+end
+
+function test_open_config_close()
+    local serial = nil
+    local modbus = nil
+
+    ptest()
+
+    passert_periphery_success("open serial", function () serial = Serial(device, 19200) end)
+    passert_periphery_success("open modbus", function () modbus = ModbusRTU(serial) end)
+    passert("serial is serial", modbus.serial == serial)
+    passert("timeout_ms is 1000", modbus.timeout_ms == 1000)
+    passert("retries is 0", modbus.retries == 0)
+
+    -- Set timeout and retries
+    passert_periphery_success("set timeout_ms to 200", function () modbus.timeout_ms = 200 end)
+    passert("timeout_ms is 200", modbus.timeout_ms == 200)
+    passert_periphery_success("set retries to 2", function () modbus.retries = 2 end)
+    passert("retries is 2", modbus.retries == 2)
+    passert_periphery_error("set invalid timeout_ms", function () modbus.timeout_ms = -1 end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("set negative retries", function () modbus.retries = -1 end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("set excessive retries", function () modbus.retries = 101 end, "MODBUS_ERROR_ARG")
+    passert("retries is 2", modbus.retries == 2)
+    passert_periphery_error("set immutable serial", function () modbus.serial = serial end, "MODBUS_ERROR_ARG")
+
+    -- Invalid request arguments
+    passert_periphery_error("invalid slave", function () modbus:read_holding_registers(248, 0, 1) end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("broadcast read", function () modbus:read_holding_registers(0, 0, 1) end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("invalid count", function () modbus:read_holding_registers(1, 0, 126) end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("invalid address", function () modbus:read_input_registers(1, 0x10000, 1) end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("invalid value", function () modbus:write_single_register(1, 0, 0x10000) end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("invalid values", function () modbus:write_multiple_registers(1, 0, {}) end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("invalid batch request", function () modbus:read_holding_registers_batch({{slave=1, address=0}}) end, "MODBUS_ERROR_ARG")
+
+    -- Check table constructor
+    passert_periphery_success("close modbus", function () modbus:close() end)
+    passert_periphery_success("open modbus", function () modbus = ModbusRTU{serial=serial, timeout_ms=100, retries=1} end)
+    passert("timeout_ms is 100", modbus.timeout_ms == 100)
+    passert("retries is 1", modbus.retries == 1)
+    passert_periphery_success("close modbus", function () modbus:close() end)
+    passert_periphery_error("open with negative retries", function () modbus = ModbusRTU{serial=serial, retries=-1} end, "MODBUS_ERROR_ARG")
+    passert_periphery_error("open with excessive retries", function () modbus = ModbusRTU{serial=serial, retries=1000} end, "MODBUS_ERROR_ARG")
+    passert_periphery_success("open modbus", function () modbus = ModbusRTU(serial) end)
+
+    passert_periphery_success("close modbus", function () modbus:close() end)
+    passert_periphery_success("close serial", function () serial:close() end)
+end
+
+function test_loopback()
+    local serial = nil
+    local modbus = nil
+
+    ptest()
+
+    passert_periphery_success("open serial", function () serial = Serial(device, 19200) end)
+    passert_periphery_success("open modbus", function () modbus = ModbusRTU{serial=serial, timeout_ms=200} end)
+
+    -- Write single register response echoes the request
+    print("Check write single register with echoed response")
+    passert_periphery_success("write single register", function () modbus:write_single_register(1, 0x100, 0x1234) end)
+
+    -- Read response is corrupted by the echoed request
+    print("Check read holding registers with echoed request")
+    passert_periphery_error("read holding registers", function () modbus:read_holding_registers(1, 0x100, 1) end, "MODBUS_ERROR_CRC")
+
+    -- Batch continues after failed requests
+    print("Check batch read with echoed requests")
+    local values, errors = modbus:read_holding_registers_batch({{slave=1, address=0x100, count=1}, {slave=2, address=0x100, count=1}})
+    passert("batch results failed", values[1] == false and values[2] == false)
+    passert("batch errors", errors[1].code == "MODBUS_ERROR_CRC" and errors[2].code == "MODBUS_ERROR_CRC")
+
+    passert_periphery_success("close modbus", function () modbus:close() end)
+    passert_periphery_success("close serial", function () serial:close() end)
+end
+
+if #arg < 1 then
+    io.stderr:write(string.format("Usage: lua %s <serial port device>\n\n", arg[0]))
+    io.stderr:write("[1/3] Arguments test: No requirements.\n")
+    io.stderr:write("[2/3] Open/close test: Serial port device should be real.\n")
+    io.stderr:write("[3/3] Loopback test: Serial TX and RX should be connected with a wire.\n\n")
+    os.exit(1)
+end
+
+device = arg[1]
+
+test_arguments()
+pokay("Arguments test passed.")
+test_open_config_close()
+pokay("Open/close test passed.")
+test_loopback()
+pokay("Loopback test passed.")
+
+pokay("All tests passed!")
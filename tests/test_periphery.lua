@@ -0,0 +1,60 @@
+--
+-- lua-periphery by vsergeev
+-- https://github.com/vsergeev/lua-periphery
+-- License: MIT
+--
+
+require('test')
+local periphery = require('periphery')
+
+--------------------------------------------------------------------------------
+
+function test_arguments()
+    ptest()
+
+    -- Invalid clock
+    passert("clock_ns invalid clock", pcall(periphery.clock_ns, "foo") == false)
+    passert("sleep_until_ns invalid clock", pcall(periphery.sleep_until_ns, 0, "foo") == false)
+    -- Invalid spin
+    passert("sleep_until_ns invalid spin", pcall(periphery.sleep_until_ns, 0, "monotonic", -1) == false)
+end
+
+function test_clock()
+    ptest()
+
+    -- Monotonic clock
+    local t1 = periphery.clock_ns()
+    local t2 = periphery.clock_ns("monotonic")
+    passert("clock_ns is a number", type(t1) == "number")
+    passert("clock_ns is monotonic", t2 >= t1)
+
+    -- Other clocks
+    passert("realtime clock_ns", periphery.clock_ns("realtime") > 0)
+    passert("boottime clock_ns", periphery.clock_ns("boottime") > 0)
+end
+
+function test_sleep_until()
+    ptest()
+
+    -- Deadline in the past returns immediately
+    passert_periphery_success("sleep until past deadline", function () periphery.sleep_until_ns(0) end)
+
+    -- Sleep
+    local deadline = periphery.clock_ns() + 20000000
+    periphery.sleep_until_ns(deadline, "monotonic")
+    passert("sleep does not return early", periphery.clock_ns() >= deadline)
+
+    -- Sleep with spin
+    deadline = periphery.clock_ns() + 20000000
+    periphery.sleep_until_ns(deadline, "monotonic", 5000)
+    passert("spin does not return early", periphery.clock_ns() >= deadline)
+end
+
+test_arguments()
+pokay("Arguments test passed.")
+test_clock()
+pokay("Clock test passed.")
+test_sleep_until()
+pokay("Sleep until test passed.")
+
+pokay("All tests passed!")
@@ -0,0 +1,137 @@
+--
+-- lua-periphery by vsergeev
+-- https://github.com/vsergeev/lua-periphery
+-- License: MIT
+--
+
+require('test')
+local periphery = require('periphery')
+local Serial = periphery.Serial
+local Poller = periphery.Poller
+
+--------------------------------------------------------------------------------
+
+local device = nil
+
+--------------------------------------------------------------------------------
+
+function test_arguments()
+    local poller = nil
+
+    ptest()
+
+    -- Invalid handles
+    passert_periphery_error("invalid handles", function () poller = Poller("foo") end, "POLLER_ERROR_ARG")
+    passert_periphery_success("create poller", function () poller = Poller() end)
+    passert_periphery_error("invalid handle", function () poller:add("foo") end, "POLLER_ERROR_ARG")
+    passert_periphery_error("handle without fd", function () poller:add({}) end, "POLLER_ERROR_ARG")
+    passert_periphery_error("closed handle", function () poller:add({fd=-1}) end, "POLLER_ERROR_ARG")
+
+    -- Invalid events and callback
+    local inner = Poller()
+    passert_periphery_error("invalid events", function () poller:add(inner, "in") end, "POLLER_ERROR_ARG")
+    passert_periphery_error("invalid callback", function () poller:add(inner, nil, "foo") end, "POLLER_ERROR_ARG")
+    passert_periphery_error("invalid timeout", function () poller:wait("foo") end, "POLLER_ERROR_ARG")
+
+    -- Add and remove another poller as a handle
+    passert_periphery_success("add poller", function () poller:add(inner) end)
+    passert_periphery_success("re-add poller", function () poller:add(inner, Poller.IN) end)
+    passert("count is 1", poller.count == 1)
+    local ready, events = poller:wait(0)
+    passert("nothing ready", #ready == 0 and #events == 0)
+    passert_periphery_success("remove poller", function () poller:remove(inner) end)
+    passert_periphery_success("remove poller again", function () poller:remove(inner) end)
+    passert("count is 0", poller.count == 0)
+
+    -- Adding a handle with the fd of another handle replaces it
+    local stale = {fd=inner.fd}
+    passert_periphery_success("add handle", function () poller:add(stale) end)
+    passert_periphery_success("add handle with same fd", function () poller:add(inner) end)
+    passert("count is 1", poller.count == 1)
+    passert_periphery_success("remove replaced handle", function () poller:remove(stale) end)
+    passert("count is 1", poller.count == 1)
+    passert_periphery_success("remove poller", function () poller:remove(inner) end)
+    passert("count is 0", poller.count == 0)
+
+    -- Callbacks may wait on the poller again
+    local timer = periphery.Timer(1000)
+    local depth = 0
+    local nested = nil
+    passert_periphery_success("add timer", function ()
+        poller:add(timer, nil, function ()
+            depth = depth + 1
+            if depth == 1 then
+                nested = poller:wait(0)
+            end
+        end)
+    end)
+    local ready = poller:wait(1000)
+    passert("timer ready", #ready == 1 and ready[1] == timer)
+    passert("nested wait returned new table", nested ~= ready and #nested == 1 and nested[1] == timer)
+    passert("ready table unchanged", #ready == 1 and ready[1] == timer)
+    passert_periphery_success("remove timer", function () poller:remove(timer) end)
+    timer:close()
+
+    -- Immutable properties
+    passert("fd >= 0", poller.fd >= 0)
+    passert_periphery_error("set immutable count", function () poller.count = 1 end, "POLLER_ERROR_ARG")
+
+    passert_periphery_success("close poller", function () poller:close() end)
+    passert_periphery_error("wait on closed poller", function () poller:wait(0) end, "POLLER_ERROR_ARG")
+    inner:close()
+end
+
+function test_loopback()
+    local serial = nil
+    local poller = nil
+    local calls = {}
+
+    ptest()
+
+    passert_periphery_success("open serial", function () serial = Serial(device, 115200) end)
+    passert_periphery_success("create poller", function () poller = Poller() end)
+    passert_periphery_success("add serial", function () poller:add(serial, Poller.IN, function (handle, events) calls[#calls+1] = {handle, events} end) end)
+
+    -- Wait times out
+    print("Check wait timeout")
+    local ready, events = poller:wait(100)
+    passert("wait timed out", #ready == 0)
+    passert("callback not called", #calls == 0)
+
+    -- Wait reports written bytes
+    print("Check wait on received bytes")
+    serial:write("abcd")
+    serial:flush()
+    ready, events = poller:wait(1000)
+    passert("serial ready", #ready == 1 and ready[1] == serial)
+    passert("events has IN", events[1] % (2*Poller.IN) >= Poller.IN)
+    passert("callback called", #calls == 1 and calls[1][1] == serial and calls[1][2] == events[1])
+
+    -- Bytes held in the receive buffer are reported ready
+    periphery.sleep_ms(100)
+    passert("read until delimiter", serial:read_until("b", nil, 100) == "ab")
+    ready, events = poller:wait(0)
+    passert("serial ready with buffered bytes", #ready == 1 and ready[1] == serial and events[1] == Poller.IN)
+    passert("read remaining bytes", serial:read(2, 100) == "cd")
+    ready, events = poller:wait(0)
+    passert("nothing ready", #ready == 0)
+
+    passert_periphery_success("close poller", function () poller:close() end)
+    passert_periphery_success("close serial", function () serial:close() end)
+end
+
+if #arg < 1 then
+    io.stderr:write(string.format("Usage: lua %s <serial port device>\n\n", arg[0]))
+    io.stderr:write("[1/2] Arguments test: No requirements.\n")
+    io.stderr:write("[2/2] Loopback test: Serial TX and RX should be connected with a wire.\n\n")
+    os.exit(1)
+end
+
+device = arg[1]
+
+test_arguments()
+pokay("Arguments test passed.")
+test_loopback()
+pokay("Loopback test passed.")
+
+pokay("All tests passed!")
@@ -119,8 +119,70 @@ function test_open_config_close()
     pwm:disable()
     passert("pwm is disabled", pwm.enabled == false)
 
+    -- Configure period and duty cycle at once, with a period shorter than
+    -- the current duty cycle
+    pwm.period_ns = 1000000
+    pwm.duty_cycle_ns = 750000
+    passert_periphery_success("configure", function () pwm:configure{period_ns=500000, duty_cycle_ns=250000, polarity="normal", enabled=true} end)
+    passert("period_ns is correct", math.abs(pwm.period_ns - 500000) < 1e4)
+    passert("duty_cycle_ns is correct", math.abs(pwm.duty_cycle_ns - 250000) < 1e4)
+    passert("polarity is correct", pwm.polarity == "normal")
+    passert("pwm is enabled", pwm.enabled == true)
+    passert_periphery_success("configure", function () pwm:configure{period_ns=1000000, enabled=false} end)
+    passert("period_ns is correct", math.abs(pwm.period_ns - 1000000) < 1e5)
+    passert("duty_cycle_ns is unchanged", math.abs(pwm.duty_cycle_ns - 250000) < 1e4)
+    passert("pwm is disabled", pwm.enabled == false)
+    passert_periphery_error("configure invalid duty cycle", function () pwm:configure{duty_cycle_ns=2000000} end, "PWM_ERROR_ARG")
+
     -- Set invalid polarity
     passert_periphery_error("set invalid polarity", function () pwm.polarity = "blah" end, "PWM_ERROR_ARG")
+    -- Set invalid duty cycle
+    passert_periphery_error("set invalid duty cycle", function () pwm.duty_cycle = 1.5 end, "PWM_ERROR_ARG")
+
+    -- Ramp duty cycle
+    pwm.duty_cycle_ns = 0
+    passert_periphery_error("ramp without target", function () pwm:ramp{duration_ms=10} end, "PWM_ERROR_ARG")
+    passert_periphery_error("ramp invalid target", function () pwm:ramp{to=1.5, duration_ms=10} end, "PWM_ERROR_ARG")
+    passert_periphery_error("ramp invalid curve", function () pwm:ramp{to=0.5, duration_ms=10, curve="foo"} end, "PWM_ERROR_ARG")
+    passert_periphery_success("ramp", function () pwm:ramp{to=0.5, duration_ms=100, step_us=5000} end)
+    passert_periphery_error("write during ramp", function () pwm.duty_cycle = 0.25 end, "PWM_ERROR_ARG")
+    passert("wait", pwm:wait() == true)
+    passert("duty_cycle_ns is correct", pwm.duty_cycle_ns == 500000)
+    passert_periphery_success("ramp exp", function () pwm:ramp{to_ns=0, duration_ms=50, curve="exp"} end)
+    passert("wait", pwm:wait() == true)
+    passert("duty_cycle_ns is correct", pwm.duty_cycle_ns == 0)
+    passert_periphery_success("ramp table", function () pwm:ramp{to=1.0, duration_ms=50, curve={0, 0.8, 1}} end)
+    passert("wait", pwm:wait() == true)
+    passert("duty_cycle_ns is correct", pwm.duty_cycle_ns == 1000000)
+
+    -- Play sequence
+    passert_periphery_error("play empty sequence", function () pwm:play({}) end, "PWM_ERROR_ARG")
+    passert_periphery_error("play zero duration loop", function () pwm:play({{duty_cycle=0.5, duration_ms=0}}, true) end, "PWM_ERROR_ARG")
+    passert_periphery_success("play", function () pwm:play({{duty_cycle=0.25, duration_ms=20}, {duty_cycle_ns=750000, duration_ms=20}}) end)
+    passert("wait", pwm:wait() == true)
+    passert("duty_cycle_ns is correct", pwm.duty_cycle_ns == 750000)
+    passert_periphery_success("play loop", function () pwm:play({{duty_cycle=0.25, duration_ms=10}, {duty_cycle=0.75, duration_ms=10}}, true) end)
+    passert("wait times out", pwm:wait(50) == false)
+    passert_periphery_success("stop", function () pwm:stop() end)
+    passert("wait after stop", pwm:wait() == true)
+    passert_periphery_success("write after stop", function () pwm.duty_cycle = 0.25 end)
+
+    -- Group
+    local group = nil
+    passert_periphery_error("empty group", function () group = PWM.group({}) end, "PWM_ERROR_ARG")
+    passert_periphery_error("invalid group member", function () group = PWM.group({pwm, "foo"}) end, "PWM_ERROR_ARG")
+    passert_periphery_success("group", function () group = PWM.group({pwm}) end)
+    passert("group count", group.count == 1)
+    passert("group pwms", group.pwms[1] == pwm)
+    passert_periphery_error("set immutable count", function () group.count = 2 end, "PWM_ERROR_ARG")
+    passert_periphery_error("invalid number of duty cycles", function () group:set_duty_cycles({0.5, 0.5}) end, "PWM_ERROR_ARG")
+    passert_periphery_error("invalid duty cycle", function () group:set_duty_cycles({1.5}) end, "PWM_ERROR_ARG")
+    passert_periphery_success("set duty cycles", function () passert("skew", group:set_duty_cycles({0.5}) >= 0) end)
+    passert("duty_cycle_ns is correct", pwm.duty_cycle_ns == 500000)
+    passert_periphery_success("set duty cycles ns", function () group:set_duty_cycles_ns({250000}) end)
+    passert("duty_cycle_ns is correct", pwm.duty_cycle_ns == 250000)
+    passert_periphery_success("close group", function () group:close() end)
+    passert_periphery_error("set duty cycles on closed group", function () group:set_duty_cycles({0.5}) end, "PWM_ERROR_ARG")
 
     -- Close PWM
     passert_periphery_success("close PWM", function () pwm:close() end)
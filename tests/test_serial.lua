@@ -55,6 +55,11 @@ function test_open_config_close()
     passert("baudrate is 4800", serial.baudrate == 4800)
     passert_periphery_success("set baudrate to 9600", function () serial.baudrate = 9600 end)
     passert("baudrate is 9600", serial.baudrate == 9600)
+    passert_periphery_success("set baudrate to 250000", function () serial.baudrate = 250000 end)
+    passert("baudrate is near 250000", math.abs(serial.baudrate - 250000) < 250000*0.05)
+    passert_periphery_success("set baudrate to 115200", function () serial.baudrate = 115200 end)
+    passert("baudrate is 115200", serial.baudrate == 115200)
+    passert_periphery_error("set baudrate to 0", function () serial.baudrate = 0 end, "SERIAL_ERROR_ARG")
     passert_periphery_success("set databits to 7", function () serial.databits = 7 end)
     passert("databits is 7", serial.databits == 7)
     passert_periphery_success("set parity to odd", function () serial.parity = "odd" end)
@@ -72,8 +77,30 @@ function test_open_config_close()
     passert("vmin is 50", serial.vmin == 50)
     passert_periphery_success("set vtime to 15.3", function () serial.vtime = 15.3 end)
     passert("vtime is 15.3", math.abs(serial.vtime - 15.3) < 0.1)
+    passert("low_latency is boolean", type(serial.low_latency) == "boolean")
+    passert_periphery_success("set low_latency to false", function () serial.low_latency = false end)
+    passert("low_latency is false", serial.low_latency == false)
+    passert("rs485 is table", type(serial:get_rs485()) == "table")
+    passert_periphery_success("disable rs485", function () serial:set_rs485{enabled=false} end)
+    passert("rs485 is disabled", serial:get_rs485().enabled == false)
+    passert_periphery_error("set rs485 invalid mode", function () serial:set_rs485{mode="foo"} end, "SERIAL_ERROR_ARG")
+    passert_periphery_error("set rs485 gpio mode without gpio", function () serial:set_rs485{mode="gpio"} end, "SERIAL_ERROR_ARG")
+    passert_periphery_error("set invalid low_latency", function () serial.low_latency = 1 end, "SERIAL_ERROR_ARG")
+    passert("framing is none", serial.framing == "none")
+    passert_periphery_success("set framing to cobs", function () serial:set_framing("cobs") end)
+    passert("framing is cobs", serial.framing == "cobs")
+    passert_periphery_success("set framing to u16be", function () serial.framing = "u16be" end)
+    passert("framing is u16be", serial.framing == "u16be")
+    passert_periphery_error("set invalid framing", function () serial.framing = "foo" end, "SERIAL_ERROR_ARG")
+
+    passert_periphery_success("close serial", function () serial:close() end)
 
+    -- Check table constructor with vmin and vtime
+    passert_periphery_success("open serial", function () serial = Serial{device=device, baudrate=115200, vmin=10, vtime=1.5} end)
+    passert("vmin is 10", serial.vmin == 10)
+    passert("vtime is 1.5", math.abs(serial.vtime - 1.5) < 0.1)
     passert_periphery_success("close serial", function () serial:close() end)
+    passert_periphery_error("invalid vmin", function () serial = Serial{device=device, baudrate=115200, vmin=256} end, "SERIAL_ERROR_ARG")
 end
 
 function test_loopback()
@@ -127,6 +154,127 @@ function test_loopback()
     -- thin time boundary ;)
     passert("almost no time elapsed", (toc-tic) == 0)
 
+    -- Test read_until/read_line
+    print("Check read_until() and read_line()")
+    passert("write lines", serial:write("$GPGGA,1*00\r\n$GPRMC,2*00\r\nAT") == 28)
+    passert_periphery_success("flush", function () serial:flush() end)
+    passert("read_until first sentence", serial:read_until("\r\n", nil, 1000) == "$GPGGA,1*00\r\n")
+    passert("read_line second sentence", serial:read_line(nil, 1000) == "$GPRMC,2*00")
+    passert("input waiting is leftover size", serial:input_waiting() == 2)
+    passert("poll leftover", serial:poll(0) == true)
+    passert("read_until max_len", serial:read_until("\n", 1, 1000) == "A")
+    passert("read_until timed out with partial", serial:read_until("\n", nil, 500) == "T")
+    passert("read_until timed out", serial:read_until("\n", nil, 0) == "")
+
+    -- Test write of string array
+    print("Check write() of string array")
+    passert("write array", serial:write({"Hello", "", " ", "World"}) == 11)
+    passert_periphery_success("flush", function () serial:flush() end)
+    passert("read array", serial:read(11, 1000) == "Hello World")
+    passert_periphery_error("write invalid array", function () serial:write({"Hello", 1}) end, "SERIAL_ERROR_ARG")
+
+    -- Test send_file and capture_to_file
+    print("Check send_file() and capture_to_file()")
+    local path = os.tmpname()
+    local f = io.open(path, "wb")
+    f:write("0123456789")
+    f:close()
+    local progress = 0
+    passert("send_file", serial:send_file(path, nil, nil, function (sent, total) progress = sent; assert(total == 10) end) == 10)
+    passert("send_file progress", progress == 10)
+    passert("send_file offset and len", serial:send_file(path, 2, 3) == 3)
+    passert_periphery_success("flush", function () serial:flush() end)
+    passert("read file", serial:read(13, 1000) == "0123456789234")
+    passert("write capture", serial:write("capture") == 7)
+    passert_periphery_success("flush", function () serial:flush() end)
+    passert("capture_to_file bytes", serial:capture_to_file(path, 7, 1000) == 7)
+    f = io.open(path, "rb")
+    passert("captured file", f:read("*a") == "capture")
+    f:close()
+    passert("capture_to_file timed out", serial:capture_to_file(path, nil, 100) == 0)
+    passert_periphery_error("capture_to_file without limit", function () serial:capture_to_file(path) end, "SERIAL_ERROR_ARG")
+    os.remove(path)
+
+    -- Test read with interbyte timeout
+    print("Check read() with interbyte timeout")
+    passert("write", serial:write("interbyte") == 9)
+    passert_periphery_success("flush", function () serial:flush() end)
+    tic = os.time()
+    passert("read interbyte", serial:read{length=4096, total_timeout_ms=5000, interbyte_timeout_us=100000} == "interbyte")
+    passert("returned before total timeout", os.time() - tic < 3)
+    passert("read interbyte timed out", serial:read{length=1, total_timeout_ms=100, interbyte_timeout_us=1000} == "")
+
+    -- Test poll_multiple() and PollSet
+    print("Check poll_multiple() and PollSet")
+    passert("poll_multiple timed out", #Serial.poll_multiple({serial}, 100) == 0)
+    local pollset = nil
+    passert_periphery_success("create poll set", function () pollset = Serial.PollSet({serial}) end)
+    passert("poll set count is 1", pollset.count == 1)
+    passert("poll set fd >= 0", pollset.fd >= 0)
+    passert("pollset timed out", #pollset:wait(100) == 0)
+    passert("write", serial:write("abc") == 3)
+    passert_periphery_success("flush", function () serial:flush() end)
+    local ready = Serial.poll_multiple({serial}, 1000)
+    passert("poll_multiple ready", #ready == 1 and ready[1] == serial)
+    ready = pollset:wait(1000)
+    passert("pollset ready", #ready == 1 and ready[1] == serial)
+    passert("read_until partial", serial:read_until("\n", 1, 1000) == "a")
+    passert("pollset ready with buffered data", #pollset:wait(0) == 1)
+    passert("read", serial:read(2, 1000) == "bc")
+    passert("pollset table is reused", pollset:wait(0) == ready and #ready == 0)
+    passert_periphery_success("remove serial", function () pollset:remove(serial) end)
+    passert("poll set count is 0", pollset.count == 0)
+    passert_periphery_success("close poll set", function () pollset:close() end)
+
+    -- Test read_into
+    print("Check read_into()")
+    local buf = Serial.Buffer(5)
+    passert("buffer size", buf.size == 5 and #buf == 5)
+    passert_periphery_success("fill buffer", function () for i = 1, 5 do buf[i] = 0xff end end)
+    passert("write", serial:write("\xaa\xbb\xcc") == 3)
+    passert_periphery_success("flush", function () serial:flush() end)
+    passert("read_into with offset", serial:read_into(buf, 2, 3, 1000) == 3)
+    passert("read_into data", buf:sub() == "\xff\xaa\xbb\xcc\xff" and buf[2] == 0xaa and buf[-1] == 0xff)
+    passert("read_into timed out", serial:read_into(buf, 1, 3, 0) == 0)
+    passert_periphery_error("read_into invalid offset", function () serial:read_into(buf, 0, 3, 0) end, "SERIAL_ERROR_ARG")
+    passert_periphery_error("read_into exceeds buffer", function () serial:read_into(buf, 4, 3, 0) end, "SERIAL_ERROR_ARG")
+    passert_periphery_error("buffer index out of range", function () return buf[6] end, "SERIAL_ERROR_ARG")
+    passert_periphery_error("invalid byte value", function () buf[1] = 256 end, "SERIAL_ERROR_ARG")
+    passert_periphery_error("invalid buffer size", function () Serial.Buffer(0) end, "SERIAL_ERROR_ARG")
+
+    -- Test frame round trips
+    local frames = {"", "\x00", "abc\x00\x00def", string.rep("\xc0\xdb\x00", 200), string.rep("x", 300)}
+    for _, framing in ipairs({"cobs", "slip", "u16le", "u32be"}) do
+        print(string.format("Check %s frames", framing))
+        passert_periphery_success("set framing", function () serial:set_framing(framing) end)
+        for i, frame in ipairs(frames) do
+            serial:write_frame(frame)
+        end
+        for i, frame in ipairs(frames) do
+            -- COBS and SLIP do not deliver empty frames
+            if #frame > 0 or (framing ~= "cobs" and framing ~= "slip") then
+                passert("read frame", serial:read_frame(1000) == frame)
+            end
+        end
+        passert("read frame timed out", serial:read_frame(100) == nil)
+    end
+
+    -- Test frames at the capacity of the length header
+    print("Check u8 frames")
+    passert_periphery_error("max frame length exceeds u8 header", function () serial:set_framing("u8", 256) end, "SERIAL_ERROR_ARG")
+    passert_periphery_success("set framing to u8", function () serial:set_framing("u8") end)
+    passert_periphery_error("frame exceeds u8 header", function () serial:write_frame(string.rep("x", 256)) end, "SERIAL_ERROR_ARG")
+    serial:write_frame(string.rep("y", 255))
+    passert("read 255 byte frame", serial:read_frame(1000) == string.rep("y", 255))
+    passert("read frame timed out", serial:read_frame(100) == nil)
+
+    -- Test COBS resynchronization on line noise
+    passert_periphery_success("set framing to cobs", function () serial:set_framing("cobs") end)
+    passert("write noise", serial:write("\x05\x01\x00") == 3)
+    serial:write_frame("hello")
+    passert("read resynchronized frame", serial:read_frame(1000) == "hello")
+    passert_periphery_success("set framing to none", function () serial:set_framing("none") end)
+
     -- Test blocking read with vmin=5 termios timeout
     passert_periphery_success("set vmin to 5", function () serial.vmin = 5 end)
     -- Write 5, read back 5 (vmin)
@@ -0,0 +1,108 @@
+--
+-- lua-periphery by vsergeev
+-- https://github.com/vsergeev/lua-periphery
+-- License: MIT
+--
+
+require('test')
+local periphery = require('periphery')
+local Timer = periphery.Timer
+local Poller = periphery.Poller
+
+--------------------------------------------------------------------------------
+
+function test_arguments()
+    local timer = nil
+
+    ptest()
+
+    -- Invalid interval
+    passert_periphery_error("invalid interval", function () timer = Timer(0) end, "TIMER_ERROR_ARG")
+    passert_periphery_error("invalid interval", function () timer = Timer("foo") end, "TIMER_ERROR_ARG")
+    passert_periphery_error("invalid interval", function () timer = Timer{absolute=true} end, "TIMER_ERROR_ARG")
+    -- Invalid absolute
+    passert_periphery_error("invalid absolute", function () timer = Timer{interval_us=1000, absolute="yes"} end, "TIMER_ERROR_ARG")
+    -- Invalid clock
+    passert_periphery_error("invalid clock", function () timer = Timer{interval_us=1000, clock="foo"} end, "TIMER_ERROR_ARG")
+end
+
+function test_open_config_close()
+    local timer = nil
+
+    ptest()
+
+    passert_periphery_success("open timer", function () timer = Timer(1000) end)
+    passert("fd >= 0", timer.fd >= 0)
+    passert("interval_us is 1000", timer.interval_us == 1000)
+    passert("absolute is false", timer.absolute == false)
+    passert("clock is monotonic", timer.clock == "monotonic")
+    passert("overruns is 0", timer.overruns == 0)
+    passert("running is true", timer.running == true)
+    io.write(string.format("timer: %s\n", timer:__tostring()))
+
+    -- Change interval
+    passert_periphery_success("set interval_us to 2000", function () timer.interval_us = 2000 end)
+    passert("interval_us is 2000", timer.interval_us == 2000)
+    passert_periphery_error("set invalid interval_us", function () timer.interval_us = 0 end, "TIMER_ERROR_ARG")
+    passert_periphery_error("set immutable overruns", function () timer.overruns = 1 end, "TIMER_ERROR_ARG")
+
+    -- Stop and start
+    passert_periphery_success("stop timer", function () timer:stop() end)
+    passert("running is false", timer.running == false)
+    passert_periphery_error("wait on stopped timer", function () timer:wait() end, "TIMER_ERROR_ARG")
+    passert_periphery_success("start timer", function () timer:start() end)
+    passert("running is true", timer.running == true)
+
+    passert_periphery_success("close timer", function () timer:close() end)
+    passert_periphery_error("wait on closed timer", function () timer:wait() end, "TIMER_ERROR_ARG")
+
+    -- Table constructor
+    passert_periphery_success("open timer", function () timer = Timer{interval_us=500, absolute=true, clock="realtime"} end)
+    passert("interval_us is 500", timer.interval_us == 500)
+    passert("absolute is true", timer.absolute == true)
+    passert("clock is realtime", timer.clock == "realtime")
+    passert_periphery_success("close timer", function () timer:close() end)
+end
+
+function test_periodic()
+    local timer = nil
+
+    ptest()
+
+    passert_periphery_success("open timer", function () timer = Timer{interval_us=10000, absolute=true} end)
+
+    -- Periods without overruns
+    print("Check periods without overruns")
+    for i = 1, 10 do
+        passert("no missed expirations", timer:wait() == 0)
+    end
+    passert("overruns is 0", timer.overruns == 0)
+
+    -- Overrun is reported
+    print("Check overrun")
+    timer:wait()
+    periphery.sleep_ms(35)
+    local missed = timer:wait()
+    passert("missed expirations", missed >= 2 and missed <= 4)
+    passert("overruns accumulated", timer.overruns == missed)
+
+    -- Timer in a poller
+    print("Check timer in poller")
+    local poller = Poller({timer})
+    timer:wait()
+    local ready = poller:wait(1000)
+    passert("timer ready", #ready == 1 and ready[1] == timer)
+    passert("wait returns without blocking", timer:wait() == 0)
+    poller:close()
+
+    passert_periphery_success("close timer", function () timer:close() end)
+end
+
+test_arguments()
+pokay("Arguments test passed.")
+test_open_config_close()
+pokay("Open/close test passed.")
+test_periodic()
+pokay("Periodic test passed.")
+
+pokay("All tests passed!")